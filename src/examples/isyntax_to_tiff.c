@@ -145,11 +145,8 @@ void write_page_to_tiff(TIFF *output_tiff, isyntax_t *isyntax, isyntax_cache_t *
     int32_t tile_progress = 0;
     int32_t tiles_in_page = ((height + tile_height - 1) / tile_height) * ((width + tile_width - 1) / tile_width);
 
-    // Allocate enough memory to hold a region up to the size of a full tile, and re-use that
-    // TODO(pvalkema): refactor
-    uint32_t* region_pixels = (uint32_t*)malloc(tile_width * tile_height * sizeof(uint32_t));
-
-    // Allocate enough memory to be able to convert a smaller region to a full tile
+    // Allocate enough memory to hold a full tile, and re-use that (smaller regions at the borders are read into it
+    // with the stride of a full tile)
     uint32_t* full_tile_pixels = (uint32_t*)malloc(tile_width * tile_height * sizeof(uint32_t));
 
 	uint8_t* tile_pixels_rgb = NULL;
@@ -171,21 +168,15 @@ void write_page_to_tiff(TIFF *output_tiff, isyntax_t *isyntax, isyntax_cache_t *
 
             // TODO(pvalkema): make libisyntax_read_region() robust for out-of-bounds reading,
             //  adding white pixels in the out-of-bounds area
-            CHECK_LIBISYNTAX_OK(libisyntax_read_region(isyntax, isyntax_cache, scale, x_coord, y_coord, region_width, region_height,
-                                          region_pixels, LIBISYNTAX_PIXEL_FORMAT_RGBA));
-
-            // In case our actual tile is smaller, we need to convert it to a full tile.
-            uint32_t* final_tile_pixels_rgba = NULL;
+            // In case our actual tile is smaller, the rest of the full tile is white.
             if (region_width != tile_width || region_height != tile_height) {
                 memset(full_tile_pixels, 0xFF, tile_width * tile_height * sizeof(uint32_t));
-                for (int32_t row = 0; row < region_height; ++row) {
-                    memcpy(full_tile_pixels + row * tile_width, region_pixels + row * region_width,
-                           region_width * sizeof(uint32_t));
-                }
-	            final_tile_pixels_rgba = full_tile_pixels;
-            } else {
-	            final_tile_pixels_rgba = region_pixels;
             }
+            CHECK_LIBISYNTAX_OK(libisyntax_read_region_with_stride(isyntax, isyntax_cache, scale, x_coord, y_coord,
+                                                                   region_width, region_height, full_tile_pixels,
+                                                                   tile_width * sizeof(uint32_t),
+                                                                   LIBISYNTAX_PIXEL_FORMAT_RGBA));
+            uint32_t* final_tile_pixels_rgba = full_tile_pixels;
 
 			uint8_t* final_tile_pixels = (uint8_t*)final_tile_pixels_rgba;
 	        if (samples_per_pixel == 3) {
@@ -211,7 +202,6 @@ void write_page_to_tiff(TIFF *output_tiff, isyntax_t *isyntax, isyntax_cache_t *
     }
 
     free(full_tile_pixels);
-    free(region_pixels);
 	if (tile_pixels_rgb) free(tile_pixels_rgb);
 
     // Write the directory for the current level.
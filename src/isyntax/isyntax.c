@@ -52,6 +52,7 @@
 #include "intrinsics.h"
 
 #include "isyntax.h"
+#include "isyntax_kernels.h"
 
 // XML library for parsing the header
 #include "yxml.h"
@@ -76,8 +77,6 @@
 
 #define PER_LEVEL_PADDING 3
 
-#include "isyntax_dwt.c"
-
 static inline isyntax_dicom_tag_header_t isyntax_read_dicom_tag_header(const void* src) {
 	const u8* data = (const u8*)src;
 	isyntax_dicom_tag_header_t result = {};
@@ -1547,89 +1546,62 @@ static bool isyntax_parse_xml_header(isyntax_t* isyntax, char* xml_header, i64 c
 }
 
 
-// Convert between signed magnitude and two's complement
-// https://stackoverflow.com/questions/21837008/how-to-convert-from-sign-magnitude-to-twos-complement
-// N.B. This function is its own inverse (conversion works the other way as well)
-static inline i16 signed_magnitude_to_twos_complement_16(u16 x) {
-	u16 m = -(x >> 15);
-	i16 result = (~m & x) | (((x & (u16)0x8000) - x) & m);
-	return result;
-}
+const isyntax_kernels_t* isyntax_kernels = &isyntax_kernels_baseline;
 
-static inline i32 twos_complement_to_signed_magnitude(u32 x) {
-	u32 m = -(x >> 31);
-	i32 result = (~m & x) | (((x & 0x80000000) - x) & m);
-	return result;
-}
-
-static void signed_magnitude_to_twos_complement_16_block(u16* data, u32 len) {
-    u32 aligned_len = (len / 8) * 8;
-    u32 i = 0;
-#if defined(__SSE2__)
-	// Fast x86 SIMD version
-	for (; i < aligned_len; i += 8) {
-		__m128i x = _mm_loadu_si128((__m128i*)(data + i));
-		__m128i sign_masks = _mm_srai_epi16(x, 15); // 0x0000 if positive, 0xFFFF if negative
-		__m128i maybe_positive = _mm_andnot_si128(sign_masks, x); // (~m & x)
-		__m128i value_if_negative = _mm_sub_epi16(_mm_and_si128(x, _mm_set1_epi16(0x8000)), x); // (x & 0x8000) - x
-		__m128i maybe_negative = _mm_and_si128(sign_masks, value_if_negative);
-		__m128i result = _mm_or_si128(maybe_positive, maybe_negative);
-		_mm_storeu_si128((__m128i*)(data + i), result);
+// Highest SIMD level for which kernels are built that the CPU supports.
+i32 isyntax_get_cpu_simd_level(void) {
+#if ISYNTAX_KERNELS_X86 && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+	    __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx2") &&
+	    __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) {
+		return LIBISYNTAX_SIMD_LEVEL_AVX512;
 	}
-#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
-    // NEON version for ARM processors
-    for (; i < aligned_len; i += 8) {
-        uint16x8_t x = vld1q_u16(data + i);
-        int16x8_t sign_masks = vshrq_n_s16((int16x8_t)x, 15);
-        uint16x8_t maybe_positive = vbicq_u16(x, (uint16x8_t)sign_masks);
-        uint16x8_t value_if_negative = vsubq_u16(vandq_u16(x, vdupq_n_u16(0x8000)), x);
-        uint16x8_t maybe_negative = vandq_u16((uint16x8_t)sign_masks, value_if_negative);
-        uint16x8_t result = vorrq_u16(maybe_positive, maybe_negative);
-        vst1q_u16(data + i, result);
-    }
-#endif
-    // Slow version, for last unaligned elements or in case SIMD isn't available
-	for (; i < len; ++i) {
-		data[i] = signed_magnitude_to_twos_complement_16(data[i]);
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2") &&
+	    __builtin_cpu_supports("popcnt")) {
+		return LIBISYNTAX_SIMD_LEVEL_AVX2;
 	}
-	ASSERT(i == len);
+	if (__builtin_cpu_supports("ssse3")) {
+		return LIBISYNTAX_SIMD_LEVEL_SSSE3;
+	}
+#endif
+	return isyntax_kernels_baseline.simd_level;
 }
 
-// Convert a block of 16-bit signed integers to their absolute value
-// Almost the same as the signed magnitude <-> twos complement conversion, except the sign bit is cleared at the end
-static void signed_magnitude_to_absolute_value_16_block(i16* data, u32 len) {
-    u32 aligned_len = (len / 8) * 8;
-    u32 i = 0;
-#if defined(__SSE2__)
-	// Fast x86 SIMD version
-	for (; i < aligned_len; i += 8) {
-		__m128i x = _mm_loadu_si128((__m128i*)(data + i));
-		__m128i sign_masks = _mm_srai_epi16(x, 15); // 0x0000 if positive, 0xFFFF if negative
-		__m128i maybe_positive = _mm_andnot_si128(sign_masks, x); // (~m & x)
-		__m128i value_if_negative = _mm_sub_epi16(_mm_and_si128(x, _mm_set1_epi16(0x8000)), x); // (x & 0x8000) - x
-		__m128i maybe_negative = _mm_and_si128(sign_masks, value_if_negative);
-		__m128i result = _mm_or_si128(maybe_positive, maybe_negative);
-		result = _mm_and_si128(result, _mm_set1_epi16(0x7FFF)); // x &= 0x7FFF (clear sign bit)
-		_mm_storeu_si128((__m128i*)(data + i), result);
+static const isyntax_kernels_t* isyntax_get_kernels_for_simd_level(i32 simd_level) {
+	if (simd_level == isyntax_kernels_baseline.simd_level) {
+		return &isyntax_kernels_baseline;
+	}
+#if ISYNTAX_KERNELS_X86
+	switch (simd_level) {
+		case LIBISYNTAX_SIMD_LEVEL_SSSE3: return &isyntax_kernels_ssse3;
+		case LIBISYNTAX_SIMD_LEVEL_AVX2: return &isyntax_kernels_avx2;
+		case LIBISYNTAX_SIMD_LEVEL_AVX512: return &isyntax_kernels_avx512;
+		default: break;
 	}
-#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
-    // NEON version for ARM processors
-    for (; i < aligned_len; i += 8) {
-        uint16x8_t x = vld1q_u16((u16*)data + i);
-        int16x8_t sign_masks = vshrq_n_s16((int16x8_t)x, 15);
-        uint16x8_t maybe_positive = vbicq_u16(x, (uint16x8_t)sign_masks);
-        uint16x8_t value_if_negative = vsubq_u16(vandq_u16(x, vdupq_n_u16(0x8000)), x);
-        uint16x8_t maybe_negative = vandq_u16((uint16x8_t)sign_masks, value_if_negative);
-        uint16x8_t result = vorrq_u16(maybe_positive, maybe_negative);
-        result = vbicq_u16(result, vdupq_n_u16(0x8000)); // clear sign bit
-        vst1q_u16((u16*)data + i, result);
-    }
 #endif
-    // Slow version, for last unaligned elements or in case SIMD isn't available
-	for (; i < len; ++i) {
-		data[i] = (i16)(signed_magnitude_to_twos_complement_16((u16)data[i]) & 0x7FFF);
+	return NULL;
+}
+
+// Switch to the kernels for the given SIMD level. Fails if they are not built, or if the CPU does not support them.
+// N.B. not thread-safe with respect to running decodes; meant to be called at initialization.
+bool isyntax_select_simd_level(i32 simd_level) {
+	const isyntax_kernels_t* kernels = isyntax_get_kernels_for_simd_level(simd_level);
+	if (kernels == NULL || simd_level > isyntax_get_cpu_simd_level()) {
+		return false;
 	}
-	ASSERT(i == len);
+	isyntax_kernels = kernels;
+	return true;
+}
+
+static inline i32 twos_complement_to_signed_magnitude(u32 x) {
+	u32 m = -(x >> 31);
+	i32 result = (~m & x) | (((x & 0x80000000) - x) & m);
+	return result;
+}
+
+void isyntax_hulsken_reassemble_bitplanes(u8** bitplanes, i32 block_width, i32 block_height, i16* out) {
+	isyntax_kernels->reassemble_bitplanes(bitplanes, block_width, block_height, out);
 }
 
 
@@ -1660,170 +1632,94 @@ static u32 wavelet_coefficient_to_color_value(icoeff_t coefficient) {
 }
 #endif
 
-static rgba_t ycocg_to_rgb(icoeff_t Y, icoeff_t Co, icoeff_t Cg) {
-    icoeff_t tmp = Y - Cg/2;
-    icoeff_t G = tmp + Cg;
-    icoeff_t B = tmp - Co/2;
-    icoeff_t R = B + Co;
-    return (rgba_t){{{ATMOST(255, R), ATMOST(255, G), ATMOST(255, B), 255}}};
-}
+#define DEBUG_OUTPUT_IDWT_STEPS_AS_PNG 0
 
-static rgba_t ycocg_to_bgr(icoeff_t Y, icoeff_t Co, icoeff_t Cg) {
-    icoeff_t tmp = Y - Cg/2;
-    icoeff_t G = tmp + Cg;
-    icoeff_t B = tmp - Co/2;
-    icoeff_t R = B + Co;
-    return (rgba_t){{{ATMOST(255, B), ATMOST(255, G), ATMOST(255, R), 255}}};
+i32 isyntax_pixel_format_bytes_per_pixel(enum isyntax_pixel_format_t pixel_format) {
+	switch (pixel_format) {
+		case LIBISYNTAX_PIXEL_FORMAT_RGBA:
+		case LIBISYNTAX_PIXEL_FORMAT_BGRA: return 4;
+		case LIBISYNTAX_PIXEL_FORMAT_RGB:
+		case LIBISYNTAX_PIXEL_FORMAT_BGR:
+		case LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR: return 3;
+		case LIBISYNTAX_PIXEL_FORMAT_GRAY8: return 1;
+		case LIBISYNTAX_PIXEL_FORMAT_RGB48:
+		case LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR: return 6;
+		default: return 0;
+	}
 }
 
-static void convert_ycocg_to_bgra_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_bgra) {
-    i32 aligned_width = (width / 8) * 8;
-
-	for (i32 y = 0; y < height; ++y) {
-		u32* dest = out_bgra + (y * width);
-        i32 i = 0;
-#if defined(__SSE2__) && defined(__SSSE3__)
-		// Fast SIMD version (~2x faster on my system)
-		for (; i < aligned_width; i += 8) {
-			// Do the color space conversion
-			__m128i Y_ = _mm_loadu_si128((__m128i*)(Y + i));
-			__m128i Co_ = _mm_loadu_si128((__m128i*)(Co + i));
-			__m128i Cg_ = _mm_loadu_si128((__m128i*)(Cg + i));
-			__m128i tmp = _mm_sub_epi16(Y_, _mm_srai_epi16(Cg_, 1)); // tmp = Y - Cg/2
-			__m128i G = _mm_add_epi16(tmp, Cg_);                     // G = tmp + Cg
-			__m128i B = _mm_sub_epi16(tmp, _mm_srai_epi16(Co_, 1));  // B = tmp - Co/2
-			__m128i R = _mm_add_epi16(B, Co_);                       // R = B + Co
-
-			// Clamp range to 0..255
-			__m128i zero = _mm_set1_epi16(0);
-			R = _mm_packus_epi16(R, zero); // -R-R-R-R -> RRRR----
-			G = _mm_packus_epi16(zero, G); // -G-G-G-G -> ----GGGG
-			B = _mm_packus_epi16(B, zero); // -B-B-B-B -> BBBB----
-
-			__m128i A = _mm_setr_epi32(0, 0, 0xffffffff, 0xffffffff); // ----AAAA
-
-			// Shuffle into the right order -> BGRA
-			__m128i BG = _mm_or_si128(B, G);
-			__m128i RA = _mm_or_si128(R, A);
-
-			__m128i v_perm = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
-			BG = _mm_shuffle_epi8(BG, v_perm); // BGBGBGBG
-			RA = _mm_shuffle_epi8(RA, v_perm); // RARARARA
-			__m128i lo = _mm_unpacklo_epi16(BG, RA); // BGRA
-			__m128i hi = _mm_unpackhi_epi16(BG, RA);
-
-			_mm_storeu_si128((__m128i*)(dest + i), lo);
-			_mm_storeu_si128((__m128i*)(dest + i + 4), hi);
-		}
-#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
-        // Fast SIMD version for ARM NEON
-        for (; i < aligned_width; i += 8) {
-            int16x8_t Y_ = vld1q_s16(Y + i);
-            int16x8_t Co_ = vld1q_s16(Co + i);
-            int16x8_t Cg_ = vld1q_s16(Cg + i);
-            int16x8_t tmp = vsubq_s16(Y_, vshrq_n_s16(Cg_, 1));
-            int16x8_t G = vaddq_s16(tmp, Cg_);
-            int16x8_t B = vsubq_s16(tmp, vshrq_n_s16(Co_, 1));
-            int16x8_t R = vaddq_s16(B, Co_);
-
-            uint8x8x4_t bgra_vec;
-            bgra_vec.val[2] = vqmovun_s16(R);
-            bgra_vec.val[1] = vqmovun_s16(G);
-            bgra_vec.val[0] = vqmovun_s16(B);
-            bgra_vec.val[3] = vdup_n_u8(0xFF);
-
-            vst4_u8((uint8_t*)(dest + i), bgra_vec);
-        }
-#endif
-        // Slow version, for last unaligned elements or in case SIMD isn't available
-		for (; i < width; ++i) {
-			((rgba_t*)dest)[i] = ycocg_to_bgr(Y[i], Co[i], Cg[i]);
-		}
+// The size of a tightly packed row of pixels in bytes (for planar formats: a row within one plane).
+i32 isyntax_pixel_format_packed_stride(enum isyntax_pixel_format_t pixel_format, i32 width) {
+	if (pixel_format == LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR) {
+		return width;
+	} else if (pixel_format == LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR) {
+		return width * sizeof(icoeff_t);
+	}
+	return width * isyntax_pixel_format_bytes_per_pixel(pixel_format);
+}
 
-		Y += stride;
-		Co += stride;
-		Cg += stride;
-	}
-}
-
-static void convert_ycocg_to_rgba_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_rgba) {
-    i32 aligned_width = (width / 8) * 8;
-
-    for (i32 y = 0; y < height; ++y) {
-        u32* dest = out_rgba + (y * width);
-        i32 i = 0;
-#if defined(__SSE2__) && defined(__SSSE3__)
-        // Fast SIMD version (~2x faster on my system)
-		for (; i < aligned_width; i += 8) {
-			// Do the color space conversion
-			__m128i Y_ = _mm_loadu_si128((__m128i*)(Y + i));
-			__m128i Co_ = _mm_loadu_si128((__m128i*)(Co + i));
-			__m128i Cg_ = _mm_loadu_si128((__m128i*)(Cg + i));
-			__m128i tmp = _mm_sub_epi16(Y_, _mm_srai_epi16(Cg_, 1)); // tmp = Y - Cg/2
-			__m128i G = _mm_add_epi16(tmp, Cg_);                     // G = tmp + Cg
-			__m128i B = _mm_sub_epi16(tmp, _mm_srai_epi16(Co_, 1));  // B = tmp - Co/2
-			__m128i R = _mm_add_epi16(B, Co_);                       // R = B + Co
-
-			// Clamp range to 0..255
-			__m128i zero = _mm_set1_epi16(0);
-			R = _mm_packus_epi16(R, zero); // -R-R-R-R -> RRRR----
-			G = _mm_packus_epi16(zero, G); // -G-G-G-G -> ----GGGG
-			B = _mm_packus_epi16(B, zero); // -B-B-B-B -> BBBB----
-
-			__m128i A = _mm_setr_epi32(0, 0, 0xffffffff, 0xffffffff); // ----AAAA
-
-			// Shuffle into the right order -> RGBA
-			__m128i RG = _mm_or_si128(R, G);
-			__m128i BA = _mm_or_si128(B, A);
-
-			__m128i v_perm = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
-			RG = _mm_shuffle_epi8(RG, v_perm); // RGRGRGRG
-			BA = _mm_shuffle_epi8(BA, v_perm); // BABABABA
-			__m128i lo = _mm_unpacklo_epi16(RG, BA); // RGBA
-			__m128i hi = _mm_unpackhi_epi16(RG, BA);
-
-			_mm_storeu_si128((__m128i*)(dest + i), lo);
-			_mm_storeu_si128((__m128i*)(dest + i + 4), hi);
-		}
-#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
-        // Fast SIMD version for ARM NEON
-        for (; i < aligned_width; i += 8) {
-            int16x8_t Y_ = vld1q_s16(Y + i);
-            int16x8_t Co_ = vld1q_s16(Co + i);
-            int16x8_t Cg_ = vld1q_s16(Cg + i);
-            int16x8_t tmp = vsubq_s16(Y_, vshrq_n_s16(Cg_, 1));
-            int16x8_t G = vaddq_s16(tmp, Cg_);
-            int16x8_t B = vsubq_s16(tmp, vshrq_n_s16(Co_, 1));
-            int16x8_t R = vaddq_s16(B, Co_);
-
-            uint8x8x4_t rgba_vec;
-            rgba_vec.val[0] = vqmovun_s16(R);
-            rgba_vec.val[1] = vqmovun_s16(G);
-            rgba_vec.val[2] = vqmovun_s16(B);
-            rgba_vec.val[3] = vdup_n_u8(0xFF);
-
-            vst4_u8((uint8_t*)(dest + i), rgba_vec);
-        }
-#endif
-        // Slow version, for last unaligned elements or in case SIMD isn't available
-        for (; i < width; ++i) {
-            ((rgba_t*)dest)[i] = ycocg_to_rgb(Y[i], Co[i], Cg[i]);
-        }
+i32 isyntax_pixel_format_plane_count(enum isyntax_pixel_format_t pixel_format) {
+	return (pixel_format == LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR || pixel_format == LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR) ? 3 : 1;
+}
 
-        Y += stride;
-        Co += stride;
-        Cg += stride;
-    }
+// The number of color channels (Y, Co, Cg) that are needed to produce pixels in this format. Grayscale only needs Y.
+i32 isyntax_pixel_format_color_count(enum isyntax_pixel_format_t pixel_format) {
+	return (pixel_format == LIBISYNTAX_PIXEL_FORMAT_GRAY8) ? 1 : 3;
 }
 
-#define DEBUG_OUTPUT_IDWT_STEPS_AS_PNG 0
+// Y holds the IDWT output as is: the absolute value of Y is taken during the conversion, in the same pass.
+// (Passing absolute values of Y gives the same result.)
+// Each pixel format has its own kernel, so that the output is written in its final form in a single pass.
+// Rows of the output are out_stride bytes apart (for planar formats, the planes are out_stride * height bytes apart).
+void isyntax_convert_ycocg_to_pixels(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride,
+                                     void* out_pixels, i32 out_stride, enum isyntax_pixel_format_t pixel_format) {
+	switch (pixel_format) {
+		case LIBISYNTAX_PIXEL_FORMAT_BGRA: {
+			isyntax_kernels->convert_ycocg_to_bgra_block(Y, Co, Cg, width, height, stride, (u32*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_RGBA: {
+			isyntax_kernels->convert_ycocg_to_rgba_block(Y, Co, Cg, width, height, stride, (u32*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_RGB: {
+			isyntax_kernels->convert_ycocg_to_rgb_block(Y, Co, Cg, width, height, stride, (u8*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_BGR: {
+			isyntax_kernels->convert_ycocg_to_bgr_block(Y, Co, Cg, width, height, stride, (u8*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_GRAY8: {
+			isyntax_kernels->convert_ycocg_to_gray8_block(Y, width, height, stride, (u8*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR: {
+			isyntax_kernels->convert_ycocg_to_rgb_planar_block(Y, Co, Cg, width, height, stride, (u8*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_RGB48: {
+			isyntax_kernels->convert_ycocg_to_rgb48_block(Y, Co, Cg, width, height, stride, (u16*)out_pixels, out_stride);
+		} break;
+		case LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR: {
+			// No conversion: the planes are copied as they come out of the IDWT.
+			STATIC_ASSERT(sizeof(icoeff_t) == sizeof(i16)); // the format is defined as int16_t
+			icoeff_t* planes[3] = {Y, Co, Cg};
+			size_t plane_stride = (size_t)out_stride * height;
+			for (i32 plane = 0; plane < 3; ++plane) {
+				u8* dest = (u8*)out_pixels + plane * plane_stride;
+				icoeff_t* source = planes[plane];
+				for (i32 y = 0; y < height; ++y) {
+					memcpy(dest, source, width * sizeof(icoeff_t));
+					dest += out_stride;
+					source += stride;
+				}
+			}
+		} break;
+		default: {
+			ASSERT(!"unknown pixel format!");
+		} break;
+	}
+}
 
 void isyntax_idwt(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height, bool output_steps_as_png, const char* png_name) {
+#if ISYNTAX_WANT_DEBUG_OUTPUT_PNG
 	i32 full_width = quadrant_width * 2;
 	i32 full_height= quadrant_height * 2;
-	i32 idwt_stride = full_width;
-
-#if ISYNTAX_WANT_DEBUG_OUTPUT_PNG
 	if (output_steps_as_png) {
 		char filename[512];
 		snprintf(filename, sizeof(filename), "%s_step0.png", png_name);
@@ -1831,19 +1727,7 @@ void isyntax_idwt(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height, bool
 	}
 #endif
 
-	// Horizontal pass
-	opj_dwt_t h = {0};
-	size_t dwt_mem_size = (MAX(quadrant_width, quadrant_height)*2) * PARALLEL_COLS_53 * sizeof(icoeff_t);
-
-	h.mem = (icoeff_t*)alloca(dwt_mem_size); // TODO: need aligned memory?
-	h.sn = quadrant_width; // number of elements in low pass band
-	h.dn = quadrant_width; // number of elements in high pass band
-	h.cas = 1;
-
-	for (i32 y = 0; y < full_height; ++y) {
-		icoeff_t* input_row = idwt + y * idwt_stride;
-		opj_idwt53_h(&h, input_row);
-	}
+	isyntax_kernels->idwt_horizontal_pass(idwt, quadrant_width, quadrant_height);
 
 #if ISYNTAX_WANT_DEBUG_OUTPUT_PNG
 	if (output_steps_as_png) {
@@ -1853,21 +1737,7 @@ void isyntax_idwt(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height, bool
 	}
 #endif
 
-	// Vertical pass
-	opj_dwt_t v = {0};
-	v.mem = h.mem;
-	v.sn = quadrant_height; // number of elements in low pass band
-	v.dn = quadrant_height; // number of elements in high pass band
-	v.cas = 1;
-
-	i32 x;
-	i32 last_x = full_width;
-	for (x = 0; x + PARALLEL_COLS_53 <= last_x; x += PARALLEL_COLS_53) {
-		opj_idwt53_v(&v, idwt + x, idwt_stride, PARALLEL_COLS_53);
-	}
-	if (x < last_x) {
-		opj_idwt53_v(&v, idwt + x, idwt_stride, (last_x - x));
-	}
+	isyntax_kernels->idwt_vertical_pass(idwt, quadrant_width, quadrant_height);
 
 #if ISYNTAX_WANT_DEBUG_OUTPUT_PNG
 	if (output_steps_as_png) {
@@ -1879,22 +1749,22 @@ void isyntax_idwt(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height, bool
 
 }
 
-static inline void get_offsetted_coeff_blocks(icoeff_t** ll_hl_lh_hh, i32 offset, isyntax_tile_channel_t* color_channel, i32 block_stride, icoeff_t* black_dummy_coeff, icoeff_t* white_dummy_coeff) {
+// Same result as isyntax_idwt(), but the output is written to a separate buffer (dest) and the transform is done
+// line by line, so that only a few rows need to stay in cache at a time. The input buffer (idwt) is clobbered.
+void isyntax_idwt_line_based(icoeff_t* idwt, icoeff_t* dest, i32 quadrant_width, i32 quadrant_height) {
+	isyntax_kernels->idwt_line_based(idwt, dest, quadrant_width, quadrant_height);
+}
+
+// Missing coefficient blocks are left NULL.
+static inline void get_offsetted_coeff_blocks(icoeff_t** ll_hl_lh_hh, i32 offset, isyntax_tile_channel_t* color_channel, i32 block_stride) {
 	if (color_channel->coeff_ll) {
 		ll_hl_lh_hh[0] = color_channel->coeff_ll + offset; //ll
-	} else {
-		ll_hl_lh_hh[0] = white_dummy_coeff;
 	}
 	if (color_channel->coeff_h) {
 		ll_hl_lh_hh[1] = color_channel->coeff_h + offset; //hl
 		ll_hl_lh_hh[2] = color_channel->coeff_h + block_stride + offset; //lh
 		ll_hl_lh_hh[3] = color_channel->coeff_h + 2*block_stride + offset; //hh
-	} else {
-		ll_hl_lh_hh[1] = black_dummy_coeff;
-		ll_hl_lh_hh[2] = black_dummy_coeff;
-		ll_hl_lh_hh[3] = black_dummy_coeff;
 	}
-
 }
 
 
@@ -1968,291 +1838,211 @@ bool isyntax_is_parent_tile_missing(isyntax_image_t* wsi, i32 scale, i32 tile_x,
 	}
 }
 
-u32 isyntax_idwt_tile_for_color_channel(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, i32 color, icoeff_t* dest_buffer) {
+// Fill a rectangular region with a constant value. The regions are either a full block wide, or a margin of 4.
+static void fill_coeffs(icoeff_t* dest, i32 dest_stride, i32 width, i32 height, icoeff_t value) {
+#if defined(__SSE2__)
+	__m128i v = _mm_set1_epi16(value);
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	int16x8_t v = vdupq_n_s16(value);
+#endif
+	for (i32 y = 0; y < height; ++y) {
+		i32 x = 0;
+#if defined(__SSE2__)
+		for (; x + 8 <= width; x += 8) {
+			_mm_storeu_si128((__m128i*)(dest + x), v);
+		}
+		if (x + 4 <= width) {
+			_mm_storel_epi64((__m128i*)(dest + x), v);
+			x += 4;
+		}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		for (; x + 8 <= width; x += 8) {
+			vst1q_s16(dest + x, v);
+		}
+		if (x + 4 <= width) {
+			vst1_s16(dest + x, vget_low_s16(v));
+			x += 4;
+		}
+#endif
+		for (; x < width; ++x) {
+			dest[x] = value;
+		}
+		dest += dest_stride;
+	}
+}
+
+// Stitch together the IDWT input for one or more color channels of a tile (each quadrant is padded with margins
+// sampled from the adjacent tiles), and run the IDWT. The lookups of the adjacent tiles are shared between the color
+// channels, and every part of the destination buffers is written (no need to clear them beforehand).
+// Returns the edges for which an adjacent tile did not (yet) have its coefficients available.
+u32 isyntax_idwt_tile_for_color_channels(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                                         i32 first_color, i32 color_count, icoeff_t** dest_buffers) {
+	i32 quadrant_width = isyntax->block_width + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 quadrant_height = isyntax->block_height + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	return isyntax_idwt_tile_window_for_color_channels(isyntax, wsi, scale, tile_x, tile_y, first_color, color_count,
+	                                                   0, 0, quadrant_width, quadrant_height, dest_buffers);
+}
+
+// Same as isyntax_idwt_tile_for_color_channels(), but only for the window [window_x, window_x + window_width) x
+// [window_y, window_y + window_height) of each (padded) quadrant. The output is 2 * window_width by 2 * window_height.
+// Near the edges of the window the output is not valid, in the same way as near the edges of a whole tile.
+u32 isyntax_idwt_tile_window_for_color_channels(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                                                i32 first_color, i32 color_count, i32 window_x, i32 window_y,
+                                                i32 window_width, i32 window_height, icoeff_t** dest_buffers) {
 	isyntax_level_t* level = wsi->levels + scale;
 	ASSERT(tile_x >= 0 && tile_x < level->width_in_tiles);
 	ASSERT(tile_y >= 0 && tile_y < level->height_in_tiles);
+	ASSERT(first_color >= 0 && first_color + color_count <= 3);
 	isyntax_tile_t* tile = level->tiles + tile_y * level->width_in_tiles + tile_x;
-	isyntax_tile_channel_t* channel = tile->color_channels + color;
 
 	u32 adj_tiles = isyntax_get_adjacent_tiles_mask(level, tile_x, tile_y);
 
-//	ASSERT(channel->neighbors_loaded == adj_tiles);
-
 	// Prepare for stitching together the input image, with margins sampled from adjacent tiles for each quadrant
 	i32 pad_l = ISYNTAX_IDWT_PAD_L;
 	i32 pad_r = ISYNTAX_IDWT_PAD_R;
-	i32 pad_l_plus_r = pad_l + pad_r;
-//	ASSERT(sizeof(icoeff_t) * pad_amount == sizeof(u64)); // blit 64 bits == 4 pixels
 	i32 block_width = isyntax->block_width;
 	i32 block_height = isyntax->block_height;
-	i32 quadrant_width = block_width + pad_l_plus_r;
-	i32 quadrant_height = block_height + pad_l_plus_r;
+	ASSERT(window_x >= 0 && window_x + window_width <= block_width + pad_l + pad_r);
+	ASSERT(window_y >= 0 && window_y + window_height <= block_height + pad_l + pad_r);
+	i32 quadrant_width = window_width;
+	i32 quadrant_height = window_height;
 	i32 full_width = 2 * quadrant_width;
-	i32 full_height = 2 * quadrant_height;
-	icoeff_t* idwt = dest_buffer; // allocated/given by the caller ahead of time
-
 	i32 dest_stride = full_width;
-
-	// fill upper left quadrant with white
-	if (color == 0) {
-		for (i32 x = 0; x < quadrant_width; ++x) {
-			idwt[x] = 255;
-		}
-		for (i32 y = 1; y < quadrant_width; ++y) {
-			memcpy(idwt + y * dest_stride, idwt, quadrant_width * sizeof(icoeff_t));
-		}
-	}
-	icoeff_t* h_dummy_coeff = isyntax->black_dummy_coeff;
-	icoeff_t* ll_dummy_coeff = (color == 0) ? isyntax->white_dummy_coeff : isyntax->black_dummy_coeff;
-
-
 	i32 source_stride = block_width;
-	i32 left_margin_source_x = block_width - pad_r;
-	i32 top_margin_source_y = block_height - pad_r;
-	size_t row_copy_size = block_width * sizeof(icoeff_t);
-	size_t pad_l_copy_size = pad_l * sizeof(icoeff_t);
-	size_t pad_r_copy_size = pad_r * sizeof(icoeff_t);
-
 	i32 block_stride = block_width * block_height;
 	i32 quadrant_offsets[4] = {0, quadrant_width, full_width * quadrant_height, full_width * quadrant_height + quadrant_width};
-	icoeff_t* quadrants[4] = {0};
-	for (i32 i = 0; i < 4; ++i) {
-		quadrants[i] = idwt + quadrant_offsets[i];
-	}
 
-	icoeff_t* ll_hl_lh_hh[4] = {0};
+	// Each quadrant is made up of 3x3 regions, one for each adjacent tile:
+	// the last rows/columns of the tiles above/to the left, the whole center tile, and the first rows/columns of
+	// the tiles below/to the right. Indexed by (neighbor offset + 1).
+	i32 source_x[3] = {block_width - pad_r, 0, 0};
+	i32 source_y[3] = {block_height - pad_r, 0, 0};
+	i32 dest_x[3] = {0, pad_l, pad_l + block_width};
+	i32 dest_y[3] = {0, pad_l, pad_l + block_height};
+	i32 region_width[3] = {pad_l, block_width, pad_r};
+	i32 region_height[3] = {pad_l, block_height, pad_r};
+
+	// Clip the regions to the window (regions that end up empty are skipped).
+	for (i32 i = 0; i < 3; ++i) {
+		i32 x0 = MAX(dest_x[i], window_x);
+		i32 x1 = MIN(dest_x[i] + region_width[i], window_x + window_width);
+		source_x[i] += x0 - dest_x[i];
+		dest_x[i] = x0 - window_x;
+		region_width[i] = MAX(0, x1 - x0);
+		i32 y0 = MAX(dest_y[i], window_y);
+		i32 y1 = MIN(dest_y[i] + region_height[i], window_y + window_height);
+		source_y[i] += y0 - dest_y[i];
+		dest_y[i] = y0 - window_y;
+		region_height[i] = MAX(0, y1 - y0);
+	}
 
 	u32 invalid_neighbors_ll = 0;
 	u32 invalid_neighbors_h = 0;
 
-	// Now do the stitching, with margins sampled from adjacent tiles for each quadrant
-	// LL | HL
-	// LH | HH
-
-	// top left corner
-	if (adj_tiles & ISYNTAX_ADJ_TILE_TOP_LEFT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y-1) * level->width_in_tiles + (tile_x-1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y-1, tile_x-1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_TOP_LEFT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_TOP_LEFT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, (top_margin_source_y * source_stride) + left_margin_source_x,
-									   color_channel, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t* source = ll_hl_lh_hh[i];
-				icoeff_t* dest = quadrants[i];
-				for (i32 y = 0; y < pad_l; ++y) {
-					memcpy(dest, source, pad_l_copy_size);
-					source += source_stride;
-					dest += dest_stride;
-				}
-			}
-		}
-	}
-	// top center
-	if (adj_tiles & ISYNTAX_ADJ_TILE_TOP_CENTER) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y-1) * level->width_in_tiles + tile_x;
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y-1, tile_x)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_TOP_CENTER;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_TOP_CENTER;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, (top_margin_source_y * source_stride),
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + pad_l;
-				for (i32 y = 0; y < pad_l; ++y) {
-					memcpy(dest, source, row_copy_size);
-					source += source_stride;
-					dest += dest_stride;
-				}
-			}
-		}
-	}
-	// top right corner
-	if (adj_tiles & ISYNTAX_ADJ_TILE_TOP_RIGHT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y-1) * level->width_in_tiles + (tile_x+1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y-1, tile_x+1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_TOP_RIGHT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_TOP_RIGHT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, (top_margin_source_y * source_stride),
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + pad_l + block_width;
-				for (i32 y = 0; y < pad_l; ++y) {
-					memcpy(dest, source, pad_r_copy_size);
-					source += source_stride;
-					dest += dest_stride;
-				}
-			}
+	// Look up the adjacent tiles only once, they are shared by all color channels. Indexed by (dy+1)*3 + (dx+1).
+	isyntax_tile_t* source_tiles[9] = {0};
+	i32 parent_tile_missing[9];
+	for (i32 dy = -1; dy <= 1; ++dy) {
+		for (i32 dx = -1; dx <= 1; ++dx) {
+			i32 region = (dy + 1) * 3 + (dx + 1);
+			// Bits from 0x100 (top left) down to 1 (bottom right), see isyntax_get_adjacent_tiles_mask()
+			u32 adj_bit = 1u << ((1 - dy) * 3 + (1 - dx));
+			bool is_center = (dx == 0 && dy == 0);
+			if (adj_tiles & adj_bit) {
+				isyntax_tile_t* source_tile = is_center ? tile : level->tiles + (tile_y + dy) * level->width_in_tiles + (tile_x + dx);
+				if (source_tile->exists || is_center) source_tiles[region] = source_tile;
+			}
+			parent_tile_missing[region] = -1; // only looked up if needed
 		}
 	}
-	// center left
-	if (adj_tiles & ISYNTAX_ADJ_TILE_CENTER_LEFT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y) * level->width_in_tiles + (tile_x-1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y, tile_x-1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_CENTER_LEFT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_CENTER_LEFT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, left_margin_source_x,
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + (pad_l * dest_stride);
-				for (i32 y = 0; y < block_height; ++y) {
-					memcpy(dest, source, pad_l_copy_size);
-					dest += dest_stride;
-					source += source_stride;
-				}
-			}
-		}
-	}
-	// center (main tile)
-	if (adj_tiles & ISYNTAX_ADJ_TILE_CENTER) {
-		get_offsetted_coeff_blocks(ll_hl_lh_hh, 0,
-		                           channel, block_stride, h_dummy_coeff, ll_dummy_coeff);
-		for (i32 i = 0; i < 4; ++i) {
-			icoeff_t *source = ll_hl_lh_hh[i];
-			icoeff_t *dest = quadrants[i] + (pad_l * dest_stride) + pad_l;
-			for (i32 y = 0; y < block_height; ++y) {
-				memcpy(dest, source, row_copy_size);
-				dest += dest_stride;
-				source += source_stride;
-			}
-		}
 
-	}
-	// center right
-	if (adj_tiles & ISYNTAX_ADJ_TILE_CENTER_RIGHT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y) * level->width_in_tiles + (tile_x+1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y, tile_x+1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_CENTER_RIGHT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_CENTER_RIGHT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, 0,
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + (pad_l * dest_stride) + pad_l + block_width;
-				for (i32 y = 0; y < block_height; ++y) {
-					memcpy(dest, source, pad_r_copy_size);
-					dest += dest_stride;
-					source += source_stride;
-				}
-			}
-		}
-	}
-	// bottom left corner
-	if (adj_tiles & ISYNTAX_ADJ_TILE_BOTTOM_LEFT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y+1) * level->width_in_tiles + (tile_x-1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y+1, tile_x-1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_BOTTOM_LEFT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_BOTTOM_LEFT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, left_margin_source_x,
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + ((pad_l + block_height) * dest_stride);
-				for (i32 y = 0; y < pad_r; ++y) {
-					memcpy(dest, source, pad_l_copy_size);
-					source += source_stride;
-					dest += dest_stride;
-				}
-			}
-		}
-	}
-	// bottom center
-	if (adj_tiles & ISYNTAX_ADJ_TILE_BOTTOM_CENTER) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y+1) * level->width_in_tiles + tile_x;
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y+1, tile_x)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_BOTTOM_CENTER;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_BOTTOM_CENTER;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, 0,
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + ((pad_l + block_height) * dest_stride) + pad_l;
-				for (i32 y = 0; y < pad_r; ++y) {
-					memcpy(dest, source, row_copy_size);
-					source += source_stride;
-					dest += dest_stride;
+	// The input is stitched together in temporary memory, and transformed into the destination buffer.
+	temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+	icoeff_t* idwt = (icoeff_t*)arena_push_size(temp_memory.arena, 4 * quadrant_width * quadrant_height * sizeof(icoeff_t));
+
+	for (i32 c = 0; c < color_count; ++c) {
+		i32 color = first_color + c;
+
+		// Now do the stitching, with margins sampled from adjacent tiles for each quadrant
+		// LL | HL
+		// LH | HH
+		for (i32 dy = -1; dy <= 1; ++dy) {
+			for (i32 dx = -1; dx <= 1; ++dx) {
+				i32 region = (dy + 1) * 3 + (dx + 1);
+				u32 adj_bit = 1u << ((1 - dy) * 3 + (1 - dx));
+				bool is_center = (dx == 0 && dy == 0);
+				isyntax_tile_t* source_tile = source_tiles[region];
+				i32 source_offset = source_y[dy + 1] * source_stride + source_x[dx + 1];
+				i32 dest_offset = dest_y[dy + 1] * dest_stride + dest_x[dx + 1];
+				i32 width = region_width[dx + 1];
+				i32 height = region_height[dy + 1];
+				if (width == 0 || height == 0) continue;
+
+				icoeff_t* ll_hl_lh_hh[4] = {0};
+				if (source_tile) {
+					isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
+					if (!is_center) {
+						if (!color_channel->coeff_ll) {
+							if (parent_tile_missing[region] < 0) {
+								parent_tile_missing[region] = isyntax_is_parent_tile_missing(wsi, scale, tile_y + dy, tile_x + dx);
+							}
+							if (!parent_tile_missing[region]) invalid_neighbors_ll |= adj_bit;
+						}
+						if (!color_channel->coeff_h) {
+							invalid_neighbors_h |= adj_bit;
+						}
+					}
+					get_offsetted_coeff_blocks(ll_hl_lh_hh, source_offset, color_channel, block_stride);
 				}
-			}
-		}
-	}
-	// bottom right corner
-	if (adj_tiles & ISYNTAX_ADJ_TILE_BOTTOM_RIGHT) {
-		isyntax_tile_t* source_tile = level->tiles + (tile_y+1) * level->width_in_tiles + (tile_x+1);
-		if (source_tile->exists) {
-			isyntax_tile_channel_t* color_channel = source_tile->color_channels + color;
-			if (!color_channel->coeff_ll && !isyntax_is_parent_tile_missing(wsi, scale, tile_y+1, tile_x+1)) {
-				invalid_neighbors_ll |= ISYNTAX_ADJ_TILE_BOTTOM_RIGHT;
-			}
-			if (!color_channel->coeff_h) {
-				invalid_neighbors_h |= ISYNTAX_ADJ_TILE_BOTTOM_RIGHT;
-			}
-			get_offsetted_coeff_blocks(ll_hl_lh_hh, 0,
-									   source_tile->color_channels + color, block_stride, h_dummy_coeff, ll_dummy_coeff);
-			for (i32 i = 0; i < 4; ++i) {
-				icoeff_t *source = ll_hl_lh_hh[i];
-				icoeff_t *dest = quadrants[i] + ((pad_l + block_height) * dest_stride) + pad_l + block_width;
-				for (i32 y = 0; y < pad_r; ++y) {
-					memcpy(dest, source, pad_r_copy_size);
-					source += source_stride;
-					dest += dest_stride;
+				size_t row_copy_size = width * sizeof(icoeff_t);
+				for (i32 i = 0; i < 4; ++i) {
+					icoeff_t* source = ll_hl_lh_hh[i];
+					icoeff_t* dest = idwt + quadrant_offsets[i] + dest_offset;
+					if (!source) {
+						// Missing tile or coefficients: LL is white for the Y channel, everything else zero.
+						fill_coeffs(dest, dest_stride, width, height, (i == 0 && color == 0) ? 255 : 0);
+						continue;
+					}
+					for (i32 y = 0; y < height; ++y) {
+						memcpy(dest, source, row_copy_size);
+						source += source_stride;
+						dest += dest_stride;
+					}
 				}
 			}
 		}
+
+		isyntax_idwt_line_based(idwt, dest_buffers[c], quadrant_width, quadrant_height);
 	}
 
-	bool output_pngs = false;
-	const char* debug_png = "debug_idwt_";
-	/*
-	if (scale == wsi->max_scale && tile_x == 1 && tile_y == 1 && color == 0) {
-		output_pngs = true;
-	}*/
-	isyntax_idwt(idwt, quadrant_width, quadrant_height, output_pngs, debug_png);
+	release_temp_memory(&temp_memory);
 
 	u32 invalid_edges = invalid_neighbors_h | invalid_neighbors_ll;
 	return invalid_edges;
 }
 
+u32 isyntax_idwt_tile_for_color_channel(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, i32 color, icoeff_t* dest_buffer) {
+	return isyntax_idwt_tile_for_color_channels(isyntax, wsi, scale, tile_x, tile_y, color, 1, &dest_buffer);
+}
+
 void isyntax_load_tile(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
                        block_allocator_t* ll_coeff_block_allocator,
                        u32* out_buffer_or_null, enum isyntax_pixel_format_t pixel_format) {
+	isyntax_load_tile_with_children(isyntax, wsi, scale, tile_x, tile_y, ll_coeff_block_allocator,
+	                                ISYNTAX_ALL_CHILDREN, isyntax_pixel_format_color_count(pixel_format),
+	                                out_buffer_or_null, isyntax_pixel_format_packed_stride(pixel_format, isyntax->tile_width),
+	                                0, 0, isyntax->tile_width, isyntax->tile_height, pixel_format);
+}
+
+// Same as isyntax_load_tile(), but only the child tiles selected in child_ll_mask get their LL coefficients written
+// (bit 0 = top left, bit 1 = top right, bit 2 = bottom left, bit 3 = bottom right).
+// If color_count is 1, only the Y channel is transformed (and written to the children): enough for grayscale output.
+// The rows of the output pixels are out_stride bytes apart. Only the part of the tile starting at (out_x, out_y) of
+// size out_width x out_height is written (the planes of planar formats are out_stride * out_height bytes apart).
+void isyntax_load_tile_with_children(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                                     block_allocator_t* ll_coeff_block_allocator, u32 child_ll_mask, i32 color_count,
+                                     void* out_buffer_or_null, i32 out_stride, i32 out_x, i32 out_y,
+                                     i32 out_width, i32 out_height, enum isyntax_pixel_format_t pixel_format) {
 	// printf("@@@ isyntax_load_tile scale=%d tile_x=%d tile_y=%d\n", scale, tile_x, tile_y);
 	isyntax_level_t* level = wsi->levels + scale;
 	ASSERT(tile_x >= 0 && tile_x < level->width_in_tiles);
@@ -2278,113 +2068,61 @@ void isyntax_load_tile(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32
 
 	u32 invalid_edges = 0;
 
-	for (i32 color = 0; color < 3; ++color) {
-		i64 start_idwt = get_clock();
-		// idwt will be allocated in temporary memory (only needed for the duration of this function)
-		size_t idwt_buffer_size = idwt_width * idwt_height * sizeof(icoeff_t);
-		icoeff_t* idwt = arena_push_size(temp_memory.arena, idwt_buffer_size);
-		memset(idwt, 0, idwt_buffer_size);
-		invalid_edges |= isyntax_idwt_tile_for_color_channel(isyntax, wsi, scale, tile_x, tile_y, color, idwt);
-		elapsed_idwt += get_seconds_elapsed(start_idwt, get_clock());
-		ASSERT(idwt);
-		switch(color) {
-			case 0: Y = idwt; break;
-			case 1: Co = idwt; break;
-			case 2: Cg = idwt; break;
-			default: {
-				ASSERT(!"invalid code path");
-			} break;
-		}
-
-		if (scale == 0) {
-			// No children to take care of at level 0.
-			continue;
-		}
-
-		// Distribute result to child tiles if it was not distributed already.
+	// The idwt buffers are allocated in temporary memory (only needed for the duration of this function)
+	i64 start_idwt = get_clock();
+	size_t idwt_buffer_size = idwt_width * idwt_height * sizeof(icoeff_t);
+	ASSERT(color_count == 1 || color_count == 3);
+	icoeff_t* idwt_buffers[3] = {0};
+	for (i32 color = 0; color < color_count; ++color) {
+		idwt_buffers[color] = arena_push_size(temp_memory.arena, idwt_buffer_size);
+	}
+	invalid_edges = isyntax_idwt_tile_for_color_channels(isyntax, wsi, scale, tile_x, tile_y, 0, color_count, idwt_buffers);
+	elapsed_idwt = get_seconds_elapsed(start_idwt, get_clock());
+	Y = idwt_buffers[0];
+	Co = idwt_buffers[1];
+	Cg = idwt_buffers[2];
+
+	if (scale > 0) {
+		// Distribute result to the child tiles (only those selected in child_ll_mask).
 		isyntax_level_t* next_level = wsi->levels + (scale - 1);
 		isyntax_tile_t* child_top_left = next_level->tiles + (tile_y*2) * next_level->width_in_tiles + (tile_x*2);
-		isyntax_tile_t* child_top_right = child_top_left + 1;
-		isyntax_tile_t* child_bottom_left = child_top_left + next_level->width_in_tiles;
-		isyntax_tile_t* child_bottom_right = child_bottom_left + 1;
-
-		// TODO(avirodov): instead of releasing here, skip copy if still allocated.
-		if (child_top_left->color_channels[color].coeff_ll) {
-			block_free(ll_coeff_block_allocator, child_top_left->color_channels[color].coeff_ll);
-		}
-		if (child_top_right->color_channels[color].coeff_ll) {
-			block_free(ll_coeff_block_allocator, child_top_right->color_channels[color].coeff_ll);
-		}
-		if (child_bottom_left->color_channels[color].coeff_ll) {
-			block_free(ll_coeff_block_allocator, child_bottom_left->color_channels[color].coeff_ll);
-		}
-		if (child_bottom_right->color_channels[color].coeff_ll) {
-			block_free(ll_coeff_block_allocator, child_bottom_right->color_channels[color].coeff_ll);
-		}
-
-		// NOTE: malloc() and free() can become a bottleneck, they don't scale well especially across many threads.
-		// We use a custom block allocator to address this.
-		i64 start_malloc = get_clock();
-		child_top_left->color_channels[color].coeff_ll = (icoeff_t*)block_alloc(ll_coeff_block_allocator);
-		child_top_right->color_channels[color].coeff_ll = (icoeff_t*)block_alloc(ll_coeff_block_allocator);
-		child_bottom_left->color_channels[color].coeff_ll = (icoeff_t*)block_alloc(ll_coeff_block_allocator);
-		child_bottom_right->color_channels[color].coeff_ll = (icoeff_t*)block_alloc(ll_coeff_block_allocator);
-		elapsed_malloc += get_seconds_elapsed(start_malloc, get_clock());
-		i32 dest_stride = block_width;
-		// Blit top left child LL block
-		{
-			icoeff_t* dest = child_top_left->color_channels[color].coeff_ll;
-			icoeff_t* source = idwt + (first_valid_pixel * idwt_stride) + first_valid_pixel;
-			for (i32 y = 0; y < block_height; ++y) {
-				memcpy(dest, source, row_copy_size);
-				dest += dest_stride;
-				source += idwt_stride;
-			}
-		}
-		// Blit top right child LL block
-		{
-			icoeff_t* dest = child_top_right->color_channels[color].coeff_ll;
-			icoeff_t* source = idwt + (first_valid_pixel * idwt_stride) + first_valid_pixel + block_width;
-			for (i32 y = 0; y < block_height; ++y) {
-				memcpy(dest, source, row_copy_size);
-				dest += dest_stride;
-				source += idwt_stride;
-			}
-		}
-		// Blit bottom left child LL block
-		{
-			icoeff_t* dest = child_bottom_left->color_channels[color].coeff_ll;
-			icoeff_t* source = idwt + ((first_valid_pixel + block_height) * idwt_stride) + first_valid_pixel;
-			for (i32 y = 0; y < block_height; ++y) {
-				memcpy(dest, source, row_copy_size);
-				dest += dest_stride;
-				source += idwt_stride;
-			}
-		}
-		// Blit bottom right child LL block
-		{
-			icoeff_t* dest = child_bottom_right->color_channels[color].coeff_ll;
-			icoeff_t* source = idwt + ((first_valid_pixel + block_height) * idwt_stride) + first_valid_pixel + block_width;
-			for (i32 y = 0; y < block_height; ++y) {
-				memcpy(dest, source, row_copy_size);
-				dest += dest_stride;
-				source += idwt_stride;
+		isyntax_tile_t* children[4] = {
+			child_top_left, child_top_left + 1,
+			child_top_left + next_level->width_in_tiles, child_top_left + next_level->width_in_tiles + 1,
+		};
+		for (i32 i = 0; i < 4; ++i) {
+			if (!(child_ll_mask & (1u << i))) continue;
+			isyntax_tile_t* child = children[i];
+			i32 source_x = first_valid_pixel + (i & 1) * block_width;
+			i32 source_y = first_valid_pixel + (i >> 1) * block_height;
+			for (i32 color = 0; color < color_count; ++color) {
+				isyntax_tile_channel_t* channel = child->color_channels + color;
+				// LL blocks that are still allocated are simply overwritten.
+				// NOTE: malloc() and free() can become a bottleneck, they don't scale well especially across many threads.
+				// We use a custom block allocator to address this.
+				if (!channel->coeff_ll) {
+					i64 start_malloc = get_clock();
+					channel->coeff_ll = (icoeff_t*)block_alloc(ll_coeff_block_allocator);
+					elapsed_malloc += get_seconds_elapsed(start_malloc, get_clock());
+				}
+				icoeff_t* dest = channel->coeff_ll;
+				icoeff_t* source = idwt_buffers[color] + (source_y * idwt_stride) + source_x;
+				for (i32 y = 0; y < block_height; ++y) {
+					memcpy(dest, source, row_copy_size);
+					dest += block_width;
+					source += idwt_stride;
+				}
 			}
+			// Report that the child now has its LL blocks available.
+			child->has_ll = true;
+			child->ll_is_y_only = (color_count == 1);
 		}
 
-		// After the last color channel, we can report that the children now have their LL blocks available.
-		if (color == 2) {
-			child_top_left->has_ll = true;
-			child_top_right->has_ll = true;
-			child_bottom_left->has_ll = true;
-			child_bottom_right->has_ll = true;
-
-			if (invalid_edges != 0) {
-				console_print_error("load: scale=%d x=%d y=%d  idwt time =%g  invalid edges=%x\n", scale, tile_x, tile_y, elapsed_idwt, invalid_edges);
-				// early out
-				release_temp_memory(&temp_memory);
-				return;
-			}
+		if (invalid_edges != 0) {
+			console_print_error("load: scale=%d x=%d y=%d  idwt time =%g  invalid edges=%x\n", scale, tile_x, tile_y, elapsed_idwt, invalid_edges);
+			// early out
+			release_temp_memory(&temp_memory);
+			return;
 		}
 	}
 
@@ -2394,31 +2132,20 @@ void isyntax_load_tile(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32
 		return;
 	}
 
-	// For the Y (luminance) color channel, we actually need the absolute value of the Y-channel wavelet coefficient.
-	// (This doesn't hold for Co and Cg, those are are used directly as signed integers)
-    signed_magnitude_to_absolute_value_16_block(Y, idwt_width * idwt_height);
-
 	// Reconstruct RGB image from separate color channels while cutting off margins
+	// (this also takes the absolute value of the Y channel, see isyntax_convert_ycocg_to_pixels())
 	i64 start = get_clock();
-	i32 tile_width = block_width * 2;
-	i32 tile_height = block_height * 2;
-
-	i32 valid_offset = (first_valid_pixel * idwt_stride) + first_valid_pixel;
-    switch (pixel_format) {
-        case LIBISYNTAX_PIXEL_FORMAT_BGRA:
-            convert_ycocg_to_bgra_block(Y + valid_offset, Co + valid_offset, Cg + valid_offset, tile_width, tile_height,
-                                        idwt_stride, out_buffer_or_null);
-            break;
-
-        case LIBISYNTAX_PIXEL_FORMAT_RGBA:
-            convert_ycocg_to_rgba_block(Y + valid_offset, Co + valid_offset, Cg + valid_offset, tile_width, tile_height,
-                                        idwt_stride, out_buffer_or_null);
-            break;
-
-        default:
-            ASSERT(!"unknown pixel format!");
-            break;
-    }
+	ASSERT(out_x >= 0 && out_y >= 0 && out_x + out_width <= block_width * 2 && out_y + out_height <= block_height * 2);
+
+	i32 valid_offset = ((first_valid_pixel + out_y) * idwt_stride) + first_valid_pixel + out_x;
+	if (color_count == 1) {
+		ASSERT(pixel_format == LIBISYNTAX_PIXEL_FORMAT_GRAY8);
+		isyntax_convert_ycocg_to_pixels(Y + valid_offset, NULL, NULL, out_width, out_height,
+		                                idwt_stride, out_buffer_or_null, out_stride, pixel_format);
+	} else {
+		isyntax_convert_ycocg_to_pixels(Y + valid_offset, Co + valid_offset, Cg + valid_offset, out_width, out_height,
+		                                idwt_stride, out_buffer_or_null, out_stride, pixel_format);
+	}
 	isyntax->total_rgb_transform_time += get_seconds_elapsed(start, get_clock());
 
 	//		float elapsed_rgb = get_seconds_elapsed(start, get_clock());
@@ -2431,6 +2158,61 @@ void isyntax_load_tile(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32
 	release_temp_memory(&temp_memory); // free Y, Co and Cg
 }
 
+// Transforms only the part of a tile that is needed for the pixels [x, x + width) x [y, y + height) of the tile, and
+// writes those pixels. The LL coefficients of the child tiles are not written, so this is only useful at level 0,
+// or when the children already have them. The output planes (for planar formats) are out_stride * height bytes apart.
+void isyntax_load_tile_window(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                              i32 color_count, i32 x, i32 y, i32 width, i32 height,
+                              void* out_buffer, i32 out_stride, enum isyntax_pixel_format_t pixel_format) {
+	isyntax_level_t* level = wsi->levels + scale;
+	ASSERT(tile_x >= 0 && tile_x < level->width_in_tiles);
+	ASSERT(tile_y >= 0 && tile_y < level->height_in_tiles);
+	ASSERT(x >= 0 && y >= 0 && x + width <= isyntax->tile_width && y + height <= isyntax->tile_height);
+	ASSERT(color_count == 1 || color_count == 3);
+	isyntax_tile_t* tile = level->tiles + tile_y * level->width_in_tiles + tile_x;
+	i32 first_valid_pixel = ISYNTAX_IDWT_FIRST_VALID_PIXEL;
+	i32 pad_l_plus_r = ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 quadrant_width = isyntax->block_width + pad_l_plus_r;
+	i32 quadrant_height = isyntax->block_height + pad_l_plus_r;
+
+	// A window of quadrant coefficients starting at q gives valid output from 2 * q + first_valid_pixel, up to
+	// end_margin pixels before its end (the same as for a whole tile).
+	i32 end_margin = 2 * pad_l_plus_r - first_valid_pixel;
+	i32 window_x = x / 2;
+	i32 window_y = y / 2;
+	i32 window_width = MIN(quadrant_width, (first_valid_pixel + x + width + end_margin + 1) / 2) - window_x;
+	i32 window_height = MIN(quadrant_height, (first_valid_pixel + y + height + end_margin + 1) / 2) - window_y;
+
+	temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+	i32 idwt_stride = 2 * window_width;
+	size_t idwt_buffer_size = (size_t)idwt_stride * 2 * window_height * sizeof(icoeff_t);
+	icoeff_t* idwt_buffers[3] = {0};
+	for (i32 color = 0; color < color_count; ++color) {
+		idwt_buffers[color] = arena_push_size(temp_memory.arena, idwt_buffer_size);
+	}
+	u32 invalid_edges = isyntax_idwt_tile_window_for_color_channels(isyntax, wsi, scale, tile_x, tile_y, 0, color_count,
+	                                                                window_x, window_y, window_width, window_height,
+	                                                                idwt_buffers);
+	if (invalid_edges == 0) {
+		tile->is_loaded = true;
+	}
+
+	i64 start = get_clock();
+	i32 valid_offset = (first_valid_pixel + y - 2 * window_y) * idwt_stride + (first_valid_pixel + x - 2 * window_x);
+	if (color_count == 1) {
+		ASSERT(pixel_format == LIBISYNTAX_PIXEL_FORMAT_GRAY8);
+		isyntax_convert_ycocg_to_pixels(idwt_buffers[0] + valid_offset, NULL, NULL, width, height,
+		                                idwt_stride, out_buffer, out_stride, pixel_format);
+	} else {
+		isyntax_convert_ycocg_to_pixels(idwt_buffers[0] + valid_offset, idwt_buffers[1] + valid_offset,
+		                                idwt_buffers[2] + valid_offset, width, height,
+		                                idwt_stride, out_buffer, out_stride, pixel_format);
+	}
+	isyntax->total_rgb_transform_time += get_seconds_elapsed(start, get_clock());
+
+	release_temp_memory(&temp_memory);
+}
+
 
 // Example codeblock order for a 'chunk' in the file:
 // x        y       color   scale   coeff   offset      size    header_template_id
@@ -2484,72 +2266,634 @@ static inline u64 bitstream_lsb_read_advance(u8* buffer, i32* bits_read, i32 bit
 
 // partly adapted from stb_image.h
 #define HUFFMAN_FAST_BITS 11   // optimal value may depend on various factors, CPU cache etc.
+#define HUFFMAN_MAX_CODE_SIZE 16
+#define HUFFMAN_SLOW_TABLE_SIZE 2048
 
 // Lookup table for (1 << n) - 1
 static const u16 size_bitmasks[17]={0,1,3,7,15,31,63,127,255,511,1023,2047,4095,8191,16383,32767,65535};
 
+// Entries in the 'fast' lookup table, indexed by the next HUFFMAN_FAST_BITS bits in the stream:
+//   0                                     : no code starts with these bits
+//   symbol | (code_size << 8)             : code of at most HUFFMAN_FAST_BITS bits
+//   LONG_CODE | offset | (extra_bits << 11) : longer code, look up slow[offset + next extra_bits bits]
+#define HUFFMAN_FAST_LONG_CODE 0x8000
+
+// Entries in the 'multi' lookup table decode several short literal symbols with a single lookup:
+//   bits 0-23  : up to 3 symbols (the first symbol in the lowest byte)
+//   bits 24-25 : number of symbols; 0 means the next symbol needs the regular path (zero run or long code)
+//   bits 26-30 : total number of bits used by the symbols
+// Escaped zero run symbols (the zero run symbol followed by a counter of 0) count as ordinary literals.
+#define HUFFMAN_MULTI_MAX_SYMBOLS 3
+#define HUFFMAN_MULTI_COUNT_SHIFT 24
+#define HUFFMAN_MULTI_SIZE_SHIFT 26
+// Building the multi-symbol table costs about as much as decoding a few thousand symbols. Short messages (typically
+// codeblocks that are nearly all zeroes) are faster to decode without it.
+#define HUFFMAN_MULTI_MIN_MESSAGE_BITS 8192
+
 typedef struct huffman_t {
+	u32 multi[1 << HUFFMAN_FAST_BITS];
 	u16 fast[1 << HUFFMAN_FAST_BITS];
+	u16 slow[HUFFMAN_SLOW_TABLE_SIZE]; // second level tables for long codes; entries are symbol | (code_size << 8)
 	u16 code[256];
 	u8  size[256];
-	u16 nonfast_symbols[256];
-	u16 nonfast_code[256+7]; // extra safety bytes for SIMD vector operations
-	u16 nonfast_size[256];
-	u16 nonfast_size_masks[256+7]; // extra safety bytes for SIMD vector operations
+	i32 long_code_count;
+	u8  long_code_symbols[256];
 } huffman_t;
 
 void save_code_in_huffman_fast_lookup_table(huffman_t* h, u32 code, u32 code_width, u8 symbol) {
 	ASSERT(code_width <= HUFFMAN_FAST_BITS);
 	i32 duplicate_bits = HUFFMAN_FAST_BITS - code_width;
+	u16 entry = symbol | (MAX(code_width, 1) << 8); // a lone root node still takes up one bit in the message
 	for (u32 i = 0; i < (1 << duplicate_bits); ++i) {
 		u32 address = (i << code_width) | code;
-		h->fast[address] = symbol;
+		h->fast[address] = entry;
 	}
 }
 
-//static u32 max_code_size;
-//static u32 symbol_counts[256];
-//static u64 fast_count;
-//static u64 nonfast_count;
+// Codes longer than HUFFMAN_FAST_BITS are resolved with a second lookup, in a small table shared by all long codes
+// that start with the same HUFFMAN_FAST_BITS bits.
+static bool huffman_build_long_code_tables(huffman_t* h) {
+	u32 fast_mask = (1 << HUFFMAN_FAST_BITS) - 1;
+	i32 slow_used = 1;
+	h->slow[0] = 0; // reserved: 'no match'
+	for (i32 i = 0; i < h->long_code_count; ++i) {
+		u32 prefix = h->code[h->long_code_symbols[i]] & fast_mask;
+		if (h->fast[prefix] & HUFFMAN_FAST_LONG_CODE) {
+			continue; // already done
+		}
+		i32 max_code_size = 0;
+		for (i32 j = i; j < h->long_code_count; ++j) {
+			u8 symbol = h->long_code_symbols[j];
+			if ((h->code[symbol] & fast_mask) == prefix) {
+				max_code_size = MAX(max_code_size, h->size[symbol]);
+			}
+		}
+		i32 extra_bits = max_code_size - HUFFMAN_FAST_BITS;
+		i32 table_size = 1 << extra_bits;
+		if (slow_used + table_size > HUFFMAN_SLOW_TABLE_SIZE) {
+			return false;
+		}
+		u16* table = h->slow + slow_used;
+		memset(table, 0, table_size * sizeof(u16));
+		for (i32 j = i; j < h->long_code_count; ++j) {
+			u8 symbol = h->long_code_symbols[j];
+			if ((h->code[symbol] & fast_mask) == prefix) {
+				u32 suffix = h->code[symbol] >> HUFFMAN_FAST_BITS;
+				i32 suffix_bits = h->size[symbol] - HUFFMAN_FAST_BITS;
+				u16 entry = symbol | (h->size[symbol] << 8);
+				for (u32 k = 0; k < (1u << (extra_bits - suffix_bits)); ++k) {
+					table[suffix | (k << suffix_bits)] = entry;
+				}
+			}
+		}
+		h->fast[prefix] = HUFFMAN_FAST_LONG_CODE | slow_used | (extra_bits << 11);
+		slow_used += table_size;
+	}
+	return true;
+}
 
-/*
-static void dump_block(u8* compressed, size_t compressed_size) {
-#if 1 && DO_DEBUG
-	FILE* fp = fopen("dumped_codeblock.dat", "wb");
-	fwrite(compressed, compressed_size, 1, fp);
-	fclose(fp);
-#endif
+// Chain together as many literal symbols from the 'fast' table as will fit in HUFFMAN_FAST_BITS bits.
+static void huffman_build_multi_symbol_table(huffman_t* h, u8 zerorun_symbol, u32 zero_counter_size) {
+	for (u32 i = 0; i < (1 << HUFFMAN_FAST_BITS); ++i) {
+		u32 symbols = 0;
+		u32 count = 0;
+		u32 bits_used = 0;
+		while (count < HUFFMAN_MULTI_MAX_SYMBOLS) {
+			u32 bits_left = HUFFMAN_FAST_BITS - bits_used;
+			u32 remaining = i >> bits_used;
+			u16 entry = h->fast[remaining];
+			if (entry == 0 || (entry & HUFFMAN_FAST_LONG_CODE)) break;
+			u32 size = entry >> 8;
+			if (size > bits_left) break; // not all bits of the code are known
+			u8 symbol = entry & 0xFF;
+			if (symbol == zerorun_symbol) {
+				// Only the escaped zero run symbol is a literal; real zero runs need the regular path.
+				if (size + zero_counter_size > bits_left) break;
+				u32 counter = (remaining >> size) & ((1u << zero_counter_size) - 1);
+				if (counter != 0) break;
+				size += zero_counter_size;
+			}
+			symbols |= (u32)symbol << (8 * count);
+			++count;
+			bits_used += size;
+		}
+		h->multi[i] = symbols | (count << HUFFMAN_MULTI_COUNT_SHIFT) | (bits_used << HUFFMAN_MULTI_SIZE_SHIFT);
+	}
 }
-*/
 
-/*
-void isyntax_test_decompress_block(const char* filename) {
-#if 1 && DO_DEBUG
-	mem_t* file = platform_read_entire_file(filename);
-	if (file) {
-		i32 block_width = 128;
-		i32 block_height = 128;
-		i32 coefficient = 1;
-		i32 coeff_count = (coefficient == 1) ? 3 : 1;
-		size_t coeff_buffer_size = coeff_count * block_width * block_height * sizeof(i16);
-		i16* coeff_buffer = calloc(1, coeff_buffer_size);
-		isyntax_hulsken_decompress(file->data, file->len, 128, 128, coefficient, 2, coeff_buffer);
-
-		char out_filename[256] = {};
-		snprintf(out_filename, sizeof(out_filename), "%s.raw", filename);
-		FILE* fp = fopen(out_filename, "wb");
-		fwrite(coeff_buffer, coeff_buffer_size, 1, fp);
-		fclose(fp);
-
-		free(coeff_buffer);
-		free(file);
+// Read the serialized Huffman tree (in pre-order: a 0 bit for an internal node, a 1 bit followed by the 8-bit symbol
+// for a leaf) and build the lookup tables, except the multi-symbol table.
+static bool huffman_read_tree(huffman_t* huffman, u8* compressed, i32* bits_read_ptr, i32 block_size_in_bits) {
+	memset(huffman->fast, 0, sizeof(huffman->fast));
+	memset(huffman->code, 0, sizeof(huffman->code));
+	memset(huffman->size, 0, sizeof(huffman->size));
+	huffman->long_code_count = 0;
+	i32 bits_read = *bits_read_ptr;
+	i32 code_size = 0;
+	u32 code = 0;
+	do {
+		if (bits_read >= block_size_in_bits) {
+			console_print_error("Error: isyntax_hulsken_decompress(): invalid codeblock, Huffman table extends out of bounds (compressed_size=%d)\n", block_size_in_bits / 8);
+			ASSERT(!"out of bounds");
+			return false;
+		}
+		// Read a chunk of bits large enough to 'always' have the whole Huffman code, followed by the 8-bit symbol.
+		// A blob of 57-64 bits is more than sufficient for a Huffman code of at most 16 bits.
+		// The bitstream is organized least significant bit first (treat as one giant little-endian integer).
+		// To read bits in the stream, look at the lowest bit positions. To advance the stream, shift right.
+		i32 bits_to_advance = 1;
+		u64 blob = bitstream_lsb_read(compressed, bits_read); // gives back between 57 and 64 bits.
+
+		// 'Descend' into the tree until we hit a leaf node.
+		bool is_leaf = blob & 1;
+		// TODO: intrinsic?
+		while (!is_leaf) {
+			++bits_to_advance;
+			blob >>= 1;
+			is_leaf = (blob & 1);
+			++code_size;
+		}
+		blob >>= 1;
+
+		if (code_size > HUFFMAN_MAX_CODE_SIZE) {
+			console_print_error("Error: isyntax_hulsken_decompress(): invalid codeblock, Huffman code too long (%d bits)\n", code_size);
+			ASSERT(!"Huffman code too long");
+			return false;
+		}
+
+		// Read 8-bit Huffman symbol
+		u8 symbol = (u8)(blob);
+		huffman->code[symbol] = code;
+		huffman->size[symbol] = code_size;
+
+		if (code_size <= HUFFMAN_FAST_BITS) {
+			// We can accelerate decoding of small Huffman codes by storing them in a lookup table.
+			save_code_in_huffman_fast_lookup_table(huffman, code, code_size, symbol);
+		} else {
+			// Longer codes get a second level lookup table, built after the whole tree is known.
+			huffman->long_code_symbols[huffman->long_code_count++] = symbol;
+		}
+
+		bits_to_advance += 8;
+		bits_read += bits_to_advance;
+
+		// traverse back up the tree: find last zero -> flip to one
+		if (code_size == 0) {
+			break; // already done; this happens if there is only a root node, no leaves
+		}
+		u32 code_high_bit = (1 << (code_size - 1));
+		bool found_zero = (~code) & code_high_bit;
+		while (!found_zero) {
+			--code_size;
+			if (code_size == 0) break;
+			code &= code_high_bit - 1;
+			code_high_bit >>= 1;
+			found_zero = (~code) & code_high_bit;
+		}
+		code |= code_high_bit;
+	} while(code_size > 0);
+
+	if (!huffman_build_long_code_tables(huffman)) {
+		console_print_error("Error: isyntax_hulsken_decompress(): invalid codeblock, too many long Huffman codes\n");
+		ASSERT(!"invalid Huffman table");
+		return false;
 	}
+	*bits_read_ptr = bits_read;
+	return true;
+}
+
+// Many codeblocks are compressed with exactly the same Huffman tree. Each thread keeps the tables of the last few
+// trees it has seen, so that for a tree that is identical bit for bit the tables don't need to be built again.
+#define HUFFMAN_TABLE_CACHE_SIZE 4
+#define HUFFMAN_TREE_MAX_WORDS 40 // a tree with 256 leaves takes up 256 * 9 + 255 = 2559 bits
+
+typedef struct huffman_table_cache_entry_t {
+	huffman_t huffman;
+	u64 tree_bits[HUFFMAN_TREE_MAX_WORDS];
+	u64 hash;
+	i32 tree_size_in_bits;
+	u8 zerorun_symbol;
+	u8 zero_counter_size;
+	bool is_valid;
+	bool has_multi_symbol_table;
+	u32 last_used;
+} huffman_table_cache_entry_t;
+
+typedef struct huffman_table_cache_t {
+	huffman_table_cache_entry_t entries[HUFFMAN_TABLE_CACHE_SIZE];
+	u32 use_counter;
+} huffman_table_cache_t;
+
+static bool huffman_table_cache_enabled = true;
+
+void isyntax_hulsken_set_huffman_table_cache_enabled(bool enabled) {
+	huffman_table_cache_enabled = enabled;
+}
+
+// Find where the serialized tree ends, without building anything: each run of 0 bits opens that many internal nodes,
+// each leaf (a 1 bit plus the symbol) closes one. Returns -1 if the tree is malformed.
+static i32 huffman_tree_size_in_bits(u8* compressed, i32 tree_start, i32 block_size_in_bits) {
+	i32 pos = tree_start;
+	i32 open_nodes = 1;
+	while (open_nodes > 0) {
+		if (pos >= block_size_in_bits) return -1;
+		u64 blob = bitstream_lsb_read(compressed, pos);
+		if (blob == 0) return -1;
+		i32 internal_nodes = (i32)bit_scan_forward_64(blob);
+		if (internal_nodes > HUFFMAN_MAX_CODE_SIZE) return -1;
+		open_nodes += internal_nodes - 1;
+		pos += internal_nodes + 9;
+	}
+	if (pos > block_size_in_bits) return -1;
+	return pos - tree_start;
+}
+
+// Get the Huffman tables for the tree at 'bits_read', either from the cache or by building them (in 'scratch' if the
+// tree can't be cached). Advances 'bits_read' past the tree.
+static huffman_t* huffman_get_tables(u8* compressed, i32* bits_read, i32 block_size_in_bits, u8 zerorun_symbol,
+                                     u8 zero_counter_size, huffman_t* scratch, bool* use_multi_symbol_table, bool* reused) {
+	*reused = false;
+	i32 tree_start = *bits_read;
+	i32 tree_size_in_bits = -1;
+	huffman_table_cache_t* cache = NULL;
+	if (huffman_table_cache_enabled) {
+		tree_size_in_bits = huffman_tree_size_in_bits(compressed, tree_start, block_size_in_bits);
+		// The cache belongs to the thread memory, so that it is freed together with it (see destroy_thread_memory()).
+		thread_memory_t* thread_memory = threadlocal_thread_memory;
+		cache = (huffman_table_cache_t*)thread_memory->huffman_table_cache;
+		if (!cache && tree_size_in_bits > 0) {
+			cache = (huffman_table_cache_t*)calloc(1, sizeof(huffman_table_cache_t));
+			thread_memory->huffman_table_cache = cache;
+		}
+	}
+	i32 word_count = (tree_size_in_bits + 63) / 64;
+	if (!cache || tree_size_in_bits <= 0 || word_count > HUFFMAN_TREE_MAX_WORDS) {
+		if (!huffman_read_tree(scratch, compressed, bits_read, block_size_in_bits)) return NULL;
+		*use_multi_symbol_table = (block_size_in_bits - *bits_read >= HUFFMAN_MULTI_MIN_MESSAGE_BITS);
+		if (*use_multi_symbol_table) {
+			huffman_build_multi_symbol_table(scratch, zerorun_symbol, zero_counter_size);
+		}
+		return scratch;
+	}
+
+	u64 tree_bits[HUFFMAN_TREE_MAX_WORDS];
+	u64 hash = (u64)tree_size_in_bits ^ ((u64)zerorun_symbol << 32) ^ ((u64)zero_counter_size << 40);
+	for (i32 i = 0; i < word_count; ++i) {
+		i32 pos = tree_start + i * 64;
+		i32 bits_left = tree_size_in_bits - i * 64;
+		// Only read the upper half if the tree extends into it, so that we never read past the end of the codeblock.
+		u64 word = bitstream_lsb_read(compressed, pos) & 0xFFFFFFFF;
+		if (bits_left > 32) word |= bitstream_lsb_read(compressed, pos + 32) << 32;
+		if (bits_left < 64) word &= (1ull << bits_left) - 1;
+		tree_bits[i] = word;
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+		hash ^= hash >> 29;
+	}
+
+	*bits_read = tree_start + tree_size_in_bits;
+	*use_multi_symbol_table = (block_size_in_bits - *bits_read >= HUFFMAN_MULTI_MIN_MESSAGE_BITS);
+	huffman_table_cache_entry_t* entry = NULL;
+	huffman_table_cache_entry_t* victim = cache->entries;
+	for (i32 i = 0; i < HUFFMAN_TABLE_CACHE_SIZE; ++i) {
+		huffman_table_cache_entry_t* e = cache->entries + i;
+		if (e->is_valid && e->hash == hash && e->tree_size_in_bits == tree_size_in_bits &&
+		    e->zerorun_symbol == zerorun_symbol && e->zero_counter_size == zero_counter_size &&
+		    memcmp(e->tree_bits, tree_bits, word_count * sizeof(u64)) == 0) {
+			entry = e;
+			break;
+		}
+		if (!e->is_valid || (victim->is_valid && e->last_used < victim->last_used)) {
+			victim = e;
+		}
+	}
+	if (entry) {
+		*reused = true;
+	} else {
+		// Not seen recently: build the tables in place of the least recently used entry.
+		entry = victim;
+		entry->is_valid = false;
+		i32 tree_end = tree_start;
+		if (!huffman_read_tree(&entry->huffman, compressed, &tree_end, block_size_in_bits)) return NULL;
+		ASSERT(tree_end == *bits_read);
+		if (tree_end != *bits_read) {
+			// Should not happen: the quick walk over the tree disagrees with the full parse.
+			*bits_read = tree_end;
+			*use_multi_symbol_table = false;
+			return &entry->huffman;
+		}
+		memcpy(entry->tree_bits, tree_bits, word_count * sizeof(u64));
+		entry->hash = hash;
+		entry->tree_size_in_bits = tree_size_in_bits;
+		entry->zerorun_symbol = zerorun_symbol;
+		entry->zero_counter_size = zero_counter_size;
+		entry->has_multi_symbol_table = false;
+		entry->is_valid = true;
+	}
+	if (*use_multi_symbol_table && !entry->has_multi_symbol_table) {
+		huffman_build_multi_symbol_table(&entry->huffman, zerorun_symbol, zero_counter_size);
+		entry->has_multi_symbol_table = true;
+	}
+	entry->last_used = ++cache->use_counter;
+	return &entry->huffman;
+}
+
+typedef struct hulsken_message_decoder_t {
+	u8* compressed;
+	i32 block_size_in_bits;
+	i32 bits_read;
+	u8* decompressed_buffer;
+	i32 decompressed_length;
+	i64 serialized_length;
+	huffman_t* huffman;
+	i32 compressor_version;
+	i32 zerorun_symbol;
+	u32 zerorun_code;
+	u32 zerorun_code_size;
+	u32 zerorun_code_mask;
+	u32 zero_counter_size;
+	u32 zero_counter_mask;
+	i32 zero_run_bytes;
+	bool use_multi_symbol_table;
+	bool finished;
+	bool error;
+} hulsken_message_decoder_t;
+
+// Zero runs are frequent, and most of them are short: write them with (overlapping) wide stores, instead of memset().
+static inline void hulsken_write_zeroes(u8* dest, i32 count) {
+	if (count >= 16) {
+#if defined(__AVX2__)
+		if (count >= 32) {
+			__m256i zero = _mm256_setzero_si256();
+			for (i32 i = 0; i < count - 32; i += 32) {
+				_mm256_storeu_si256((__m256i*)(dest + i), zero);
+			}
+			_mm256_storeu_si256((__m256i*)(dest + count - 32), zero);
+			return;
+		}
+#endif
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for (i32 i = 0; i < count - 16; i += 16) {
+			_mm_storeu_si128((__m128i*)(dest + i), zero);
+		}
+		_mm_storeu_si128((__m128i*)(dest + count - 16), zero);
+#else
+		memset(dest, 0, count);
 #endif
+	} else if (count >= 8) {
+		// Fixed size memset() compiles to a single (unaligned) store.
+		memset(dest, 0, 8);
+		memset(dest + count - 8, 0, 8);
+	} else if (count >= 4) {
+		memset(dest, 0, 4);
+		memset(dest + count - 4, 0, 4);
+	} else {
+		for (i32 i = 0; i < count; ++i) dest[i] = 0;
+	}
 }
- */
+
+// Decode a single Huffman symbol from the message, including any zero run it starts.
+static inline void hulsken_decode_symbol(hulsken_message_decoder_t* d) {
+	u64 blob = bitstream_lsb_read(d->compressed, d->bits_read);
+	u16 entry = d->huffman->fast[blob & ((1 << HUFFMAN_FAST_BITS) - 1)];
+	if (entry & HUFFMAN_FAST_LONG_CODE) {
+		u32 offset = entry & 0x7FF;
+		u32 extra_bits = (entry >> 11) & 0xF;
+		entry = d->huffman->slow[offset + ((blob >> HUFFMAN_FAST_BITS) & size_bitmasks[extra_bits])];
+	}
+	i32 symbol = entry & 0xFF;
+	i32 code_size = entry >> 8;
+	if (code_size == 0) {
+		d->error = true;
+		return;
+	}
+
+	blob >>= code_size;
+	d->bits_read += code_size;
+
+	// Handle run-length encoding of zeroes
+	if (symbol == d->zerorun_symbol) {
+		u32 numzeroes = blob & d->zero_counter_mask;
+		d->bits_read += d->zero_counter_size;
+		// A 'zero run' with length of zero means that this is not a zero run after all, but rather
+		// the 'escaped' zero run symbol itself which should be outputted.
+		if (numzeroes > 0) {
+			u32 actual_numzeroes = (d->compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
+			if (d->decompressed_length + actual_numzeroes >= d->serialized_length || d->bits_read >= d->block_size_in_bits) {
+				// Reached the end, terminate
+				i32 bytes_to_write = MIN(d->serialized_length - d->decompressed_length, actual_numzeroes);
+				hulsken_write_zeroes(d->decompressed_buffer + d->decompressed_length, bytes_to_write);
+				d->zero_run_bytes += bytes_to_write;
+				d->decompressed_length += actual_numzeroes;
+				d->finished = true;
+				return;
+			}
+			// If the next Huffman symbol is also the zero run symbol, then their counters actually refer to the same zero run.
+			// Basically, each extra zero run symbol expands the 'zero counter' bit depth, i.e.:
+			//   n zero symbols -> depth becomes n * counter_bits
+			for(;;) {
+				// Peek ahead in the bitstream, grab any additional zero run symbols, and recalculate numzeroes.
+				blob = bitstream_lsb_read(d->compressed, d->bits_read);
+				u32 next_code = (blob & d->zerorun_code_mask);
+				if (next_code == d->zerorun_code) {
+					// The zero run continues
+					blob >>= d->zerorun_code_size;
+					u32 counter_extra_bits = blob & d->zero_counter_mask;
+					numzeroes <<= d->zero_counter_size;
+					numzeroes |= (counter_extra_bits);
+					d->bits_read += d->zerorun_code_size + d->zero_counter_size;
+					actual_numzeroes = (d->compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
+					if (d->decompressed_length + actual_numzeroes >= d->serialized_length || d->bits_read >= d->block_size_in_bits) {
+						break; // Reached the end, terminate
+					}
+				} else {
+					actual_numzeroes = (d->compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
+					break; // no next zero run symbol, the zero run is finished
+				}
+			}
+
+			i32 bytes_to_write = MIN(d->serialized_length - d->decompressed_length, actual_numzeroes);
+			ASSERT(bytes_to_write > 0);
+			hulsken_write_zeroes(d->decompressed_buffer + d->decompressed_length, bytes_to_write);
+			d->zero_run_bytes += bytes_to_write;
+			d->decompressed_length += actual_numzeroes;
+		} else {
+			// This is not a 'zero run' after all, but an escaped symbol. So output the symbol.
+			d->decompressed_buffer[d->decompressed_length++] = symbol;
+		}
+	} else {
+		d->decompressed_buffer[d->decompressed_length++] = symbol;
+	}
+}
+
+// Decode up to 3 literal symbols with a single lookup in the multi-symbol table.
+// Returns false if the next symbol needs hulsken_decode_symbol() instead (zero run or long code).
+static inline bool hulsken_decode_multi(u32* multi_table, u8* compressed, u8* decompressed_buffer, i32* bits_read, i32* decompressed_length) {
+	u64 blob = bitstream_lsb_read(compressed, *bits_read);
+	u32 entry = multi_table[blob & ((1 << HUFFMAN_FAST_BITS) - 1)];
+	u32 count = (entry >> HUFFMAN_MULTI_COUNT_SHIFT) & 3;
+	if (count == 0) {
+		return false;
+	}
+	u8* dest = decompressed_buffer + *decompressed_length;
+	dest[0] = (u8)entry;
+	dest[1] = (u8)(entry >> 8);
+	dest[2] = (u8)(entry >> 16);
+	*decompressed_length += count;
+	*bits_read += (entry >> HUFFMAN_MULTI_SIZE_SHIFT) & 31;
+	return true;
+}
+
+// Fall back to hulsken_decode_symbol() for a single symbol; returns false if decoding should stop.
+static inline bool hulsken_decode_symbol_with_state(hulsken_message_decoder_t* d, i32* bits_read, i32* decompressed_length) {
+	d->bits_read = *bits_read;
+	d->decompressed_length = *decompressed_length;
+	hulsken_decode_symbol(d);
+	*bits_read = d->bits_read;
+	*decompressed_length = d->decompressed_length;
+	return !(d->finished || d->error);
+}
+
+// Decode until the output reaches decode_end, the message ends, or an error occurs.
+static void hulsken_decode_until(hulsken_message_decoder_t* d, i64 decode_end) {
+	if (d->use_multi_symbol_table && !d->finished && !d->error) {
+		// Multi-symbol lookups are only safe away from the end of the message and the output.
+		// Keep the hot state in local variables: stores to the output buffer may otherwise alias the decoder struct.
+		u32* multi_table = d->huffman->multi;
+		u8* compressed = d->compressed;
+		u8* decompressed_buffer = d->decompressed_buffer;
+		i32 bits_limit = d->block_size_in_bits - HUFFMAN_FAST_BITS;
+		i64 length_limit = decode_end - HUFFMAN_MULTI_MAX_SYMBOLS;
+		i32 bits_read = d->bits_read;
+		i32 decompressed_length = d->decompressed_length;
+		while (bits_read <= bits_limit && decompressed_length <= length_limit) {
+			if (!hulsken_decode_multi(multi_table, compressed, decompressed_buffer, &bits_read, &decompressed_length)) {
+				if (!hulsken_decode_symbol_with_state(d, &bits_read, &decompressed_length)) break;
+			}
+		}
+		d->bits_read = bits_read;
+		d->decompressed_length = decompressed_length;
+	}
+	// Decode the remainder one symbol at a time.
+	while (!d->finished && !d->error) {
+		if (d->decompressed_length >= decode_end || d->bits_read >= d->block_size_in_bits) {
+			break; // done
+		}
+		hulsken_decode_symbol(d);
+	}
+}
+
+// Decode two independent parts of the message side by side. Each part is a serial chain of table lookups;
+// alternating between two chains lets the CPU overlap their latencies.
+static void hulsken_decode_until_interleaved(hulsken_message_decoder_t* a, i64 end_a, hulsken_message_decoder_t* b, i64 end_b) {
+	if (a->use_multi_symbol_table && !a->finished && !a->error && !b->finished && !b->error) {
+		u32* multi_table = a->huffman->multi;
+		u8* compressed = a->compressed;
+		u8* decompressed_buffer = a->decompressed_buffer;
+		i32 bits_limit = a->block_size_in_bits - HUFFMAN_FAST_BITS;
+		i64 length_limit_a = end_a - HUFFMAN_MULTI_MAX_SYMBOLS;
+		i64 length_limit_b = end_b - HUFFMAN_MULTI_MAX_SYMBOLS;
+		i32 bits_read_a = a->bits_read;
+		i32 bits_read_b = b->bits_read;
+		i32 decompressed_length_a = a->decompressed_length;
+		i32 decompressed_length_b = b->decompressed_length;
+		while (bits_read_a <= bits_limit && decompressed_length_a <= length_limit_a &&
+		       bits_read_b <= bits_limit && decompressed_length_b <= length_limit_b) {
+			if (!hulsken_decode_multi(multi_table, compressed, decompressed_buffer, &bits_read_a, &decompressed_length_a)) {
+				if (!hulsken_decode_symbol_with_state(a, &bits_read_a, &decompressed_length_a)) break;
+			}
+			if (!hulsken_decode_multi(multi_table, compressed, decompressed_buffer, &bits_read_b, &decompressed_length_b)) {
+				if (!hulsken_decode_symbol_with_state(b, &bits_read_b, &decompressed_length_b)) break;
+			}
+		}
+		a->bits_read = bits_read_a;
+		a->decompressed_length = decompressed_length_a;
+		b->bits_read = bits_read_b;
+		b->decompressed_length = decompressed_length_b;
+	}
+	hulsken_decode_until(a, end_a);
+	hulsken_decode_until(b, end_b);
+}
+
+// Compressor v2 stores the bitplanes grouped by bit position (sign, msb ... lsb), and the seektable points to the
+// start of each group except the first. This allows decoding the groups independently of each other.
+// The seektable is not trusted blindly: each group must end exactly where the next one starts, both in the message
+// and in the output, which guarantees the same result as sequential decoding. If this does not hold, the decoder is
+// left in the state after the first group, and decoding continues sequentially from there.
+static void hulsken_decode_bitplane_groups(hulsken_message_decoder_t* d, const u32* bitplane_offsets,
+                                           const i32* group_starts, i32 group_count, i64 decode_end) {
+	i32 message_start = d->bits_read;
+	hulsken_decode_until(d, group_starts[1]);
+	if (d->error || d->finished || d->decompressed_length != group_starts[1]) {
+		return;
+	}
+	// The offsets are relative to the start of the Huffman message (or else, to the start of the codeblock).
+	i64 offset_base;
+	if (message_start + (i64)bitplane_offsets[0] == d->bits_read) {
+		offset_base = message_start;
+	} else if ((i64)bitplane_offsets[0] == d->bits_read) {
+		offset_base = 0;
+	} else {
+		return;
+	}
+
+	hulsken_message_decoder_t groups[16];
+	i64 group_ends[16];
+	for (i32 g = 1; g < group_count; ++g) {
+		i64 start_bit = offset_base + bitplane_offsets[g-1];
+		if (start_bit >= d->block_size_in_bits) {
+			return;
+		}
+		groups[g] = *d;
+		groups[g].zero_run_bytes = 0;
+		groups[g].bits_read = (i32)start_bit;
+		groups[g].decompressed_length = group_starts[g];
+		group_ends[g] = (g + 1 < group_count) ? group_starts[g+1] : decode_end;
+	}
+	for (i32 g = 1; g < group_count; g += 2) {
+		if (g + 1 < group_count) {
+			hulsken_decode_until_interleaved(&groups[g], group_ends[g], &groups[g+1], group_ends[g+1]);
+		} else {
+			hulsken_decode_until(&groups[g], group_ends[g]);
+		}
+	}
+	for (i32 g = 1; g < group_count - 1; ++g) {
+		hulsken_message_decoder_t* group = groups + g;
+		if (group->error || group->finished || group->decompressed_length != group_ends[g] ||
+		    group->bits_read != (i32)(offset_base + bitplane_offsets[g])) {
+			return;
+		}
+	}
+	hulsken_message_decoder_t* last_group = groups + (group_count - 1);
+	if (last_group->error) {
+		return; // let the sequential decoder run into (and report) the same error
+	}
+	i32 zero_run_bytes = d->zero_run_bytes;
+	for (i32 g = 1; g < group_count; ++g) {
+		zero_run_bytes += groups[g].zero_run_bytes;
+	}
+	*d = *last_group;
+	d->zero_run_bytes = zero_run_bytes;
+}
+
+//static u32 max_code_size;
+//static u32 symbol_counts[256];
+//static u64 fast_count;
+//static u64 nonfast_count;
 
 bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 block_width, i32 block_height,
 								i32 coefficient, i32 compressor_version, i16* out_buffer) {
+	return isyntax_hulsken_decompress_truncated(compressed, compressed_size, block_width, block_height, coefficient,
+	                                            compressor_version, 0, out_buffer, NULL);
+}
+
+// Decode only the sign and the 'max_magnitude_bitplanes' most significant magnitude bitplanes of H coefficients
+// (0 means: decode everything). The less significant bits are left at zero, so the result is an approximation.
+// Only compressor version 2 stores the bitplanes most significant first; v1 codeblocks are always decoded in full.
+// If 'stats_or_null' is given, it receives statistics about the codeblock (such as how much of it was zeroes).
+bool isyntax_hulsken_decompress_truncated(u8* compressed, size_t compressed_size, i32 block_width, i32 block_height,
+                                          i32 coefficient, i32 compressor_version, i32 max_magnitude_bitplanes,
+                                          i16* out_buffer, isyntax_codeblock_stats_t* stats_or_null) {
 	ASSERT(compressor_version == 1 || compressor_version == 2);
 
 	// Read the header information stored in the codeblock.
@@ -2573,9 +2917,16 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 	i32 coeff_bit_depth = 16; // fixed value for iSyntax
 	size_t coeff_buffer_size = coeff_count * block_width * block_height * sizeof(i16);
 
+	if (stats_or_null) {
+		memset(stats_or_null, 0, sizeof(*stats_or_null));
+	}
+
 	// Early out if dummy/empty block
 	if (compressed_size <= 8) {
 		memset(out_buffer, 0, coeff_buffer_size);
+		if (stats_or_null) {
+			stats_or_null->zero_density = 1.0f;
+		}
 		return true;
 	}
 
@@ -2612,7 +2963,6 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 
 	// Check that the serialized length is sane
 	if (serialized_length > 2 * coeff_buffer_size) {
-//		dump_block(compressed, compressed_size);
 		console_print_error("Error: isyntax_hulsken_decompress(): invalid codeblock, serialized_length too large (%lld)\n", serialized_length);
 		ASSERT(!"serialized_length too large");
 		memset(out_buffer, 0, coeff_buffer_size);
@@ -2626,6 +2976,9 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 	bits_read += 8;
 
 	u32 bitplane_offsets[16] = {0};
+	i32 bitplane_group_starts[16] = {0};
+	i32 bitplane_group_count = 0;
+	i64 decode_end = serialized_length; // may be less, if we stop decoding after the most significant bitplanes
 	if (compressor_version >= 2) {
 		// Read bitplane seektable: a pointer is stored for a bit if it's represented in at least one of the bitmasks
 		u32 bitmasks_aggregate = 0;
@@ -2640,231 +2993,87 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 			bitplane_offsets[i] = blob & bitplane_ptr_mask;
 			bits_read += bitplane_ptr_bits;
 		}
-	}
-
-	// Read Huffman table
-	huffman_t huffman = {0};
-	memset(huffman.fast, 0x80, sizeof(huffman.fast));
-	memset(huffman.nonfast_size_masks, 0xFF, sizeof(huffman.nonfast_size_masks));
-	u32 fast_mask = (1 << HUFFMAN_FAST_BITS) - 1;
-	{
-		i32 code_size = 0;
-		u32 code = 0;
-		i32 nonfast_symbol_index = 0;
-		do {
-			if (bits_read >= block_size_in_bits) {
-//				dump_block(compressed, compressed_size);
-				console_print_error("Error: isyntax_hulsken_decompress(): invalid codeblock, Huffman table extends out of bounds (compressed_size=%zu)\n", compressed_size);
-				ASSERT(!"out of bounds");
-				memset(out_buffer, 0, coeff_buffer_size);
-				release_temp_memory(&temp_memory);
-				return false;
+		// Where each group of bitplanes (with the same bit position) starts in the decompressed data
+		i32 bitplanes_before = 0;
+		for (i32 bit = 0; bit < 16; ++bit) {
+			if (bitmasks_aggregate & (1 << bit)) {
+				bitplane_group_starts[bitplane_group_count++] = bitplanes_before * (block_width * block_height / 8);
+				for (i32 i = 0; i < coeff_count; ++i) {
+					bitplanes_before += (bitmasks[i] >> bit) & 1;
+				}
 			}
-			// Read a chunk of bits large enough to 'always' have the whole Huffman code, followed by the 8-bit symbol.
-			// A blob of 57-64 bits is more than sufficient for a Huffman code of at most 16 bits.
-			// The bitstream is organized least significant bit first (treat as one giant little-endian integer).
-			// To read bits in the stream, look at the lowest bit positions. To advance the stream, shift right.
-			i32 bits_to_advance = 1;
-			u64 blob = bitstream_lsb_read(compressed, bits_read); // gives back between 57 and 64 bits.
-
-			// 'Descend' into the tree until we hit a leaf node.
-			bool is_leaf = blob & 1;
-			// TODO: intrinsic?
-			while (!is_leaf) {
-				++bits_to_advance;
-				blob >>= 1;
-				is_leaf = (blob & 1);
-				++code_size;
+		}
+		if (max_magnitude_bitplanes > 0 && coefficient == 1) {
+			// Keep the sign bitplanes (bit 0, stored first) and the requested number of magnitude bitplanes.
+			i32 kept_group_count = max_magnitude_bitplanes + (bitmasks_aggregate & 1);
+			if (kept_group_count < bitplane_group_count) {
+				bitplane_group_count = kept_group_count;
+				decode_end = bitplane_group_starts[kept_group_count];
+				if (stats_or_null) {
+					stats_or_null->is_truncated = true;
+				}
 			}
-			blob >>= 1;
-
-			// Read 8-bit Huffman symbol
-			u8 symbol = (u8)(blob);
-			huffman.code[symbol] = code;
-			huffman.size[symbol] = code_size;
+		}
+	}
 
-			if (code_size <= HUFFMAN_FAST_BITS) {
-				// We can accelerate decoding of small Huffman codes by storing them in a lookup table.
-				// However, for the longer codes this becomes inefficient so in those cases we need another method.
-				save_code_in_huffman_fast_lookup_table(&huffman, code, code_size, symbol);
-//				++fast_count;
-			} else {
-				// Prepare the slow method for decoding Huffman codes that are too large to fit in the fast lookup table.
-				// (Slow method = iterating over possible symbols and checking if they match)
-				// Value being >= 256 in the 'fast' lookup table is the hint that we need the slow method.
-				u32 prefix = code & fast_mask;
-				u16 old_fast_data = huffman.fast[prefix];
-				u8 old_lowest_symbol_index = old_fast_data & 0xFF;
-				u8 new_lowest_symbol_index = MIN(old_lowest_symbol_index, nonfast_symbol_index);
-				huffman.fast[prefix] = 256 + new_lowest_symbol_index;
-				huffman.nonfast_symbols[nonfast_symbol_index] = symbol;
-				huffman.nonfast_code[nonfast_symbol_index] = code;
-				huffman.nonfast_size[nonfast_symbol_index] = code_size;
-				huffman.nonfast_size_masks[nonfast_symbol_index] = size_bitmasks[code_size];
-				++nonfast_symbol_index;
-//				++nonfast_count;
-			}
-			/*if (code_size > max_code_size) {
-				max_code_size = code_size;
-//			    console_print("found the biggest code size: %d\n", code_size);
-			}*/
-//			symbol_counts[symbol]++;
-
-			bits_to_advance += 8;
-			bits_read += bits_to_advance;
-
-			// traverse back up the tree: find last zero -> flip to one
-			if (code_size == 0) {
-				break; // already done; this happens if there is only a root node, no leaves
-			}
-			u32 code_high_bit = (1 << (code_size - 1));
-			bool found_zero = (~code) & code_high_bit;
-			while (!found_zero) {
-				--code_size;
-				if (code_size == 0) break;
-				code &= code_high_bit - 1;
-				code_high_bit >>= 1;
-				found_zero = (~code) & code_high_bit;
-			}
-			code |= code_high_bit;
-		} while(code_size > 0);
+	// Read Huffman table (or reuse it, if this thread has recently seen the same tree)
+	huffman_t scratch_huffman;
+	bool use_multi_symbol_table = false;
+	bool huffman_table_reused = false;
+	huffman_t* huffman = huffman_get_tables(compressed, &bits_read, block_size_in_bits, zerorun_symbol, zero_counter_size,
+	                                       &scratch_huffman, &use_multi_symbol_table, &huffman_table_reused);
+	if (!huffman) {
+		memset(out_buffer, 0, coeff_buffer_size);
+		release_temp_memory(&temp_memory);
+		return false;
 	}
 
 	// Decode the message
 	u8* decompressed_buffer = (u8*)arena_push_size(temp_memory.arena, serialized_length);
 
-	u32 zerorun_code = huffman.code[zerorun_symbol];
-	u32 zerorun_code_size = huffman.size[zerorun_symbol];
-	if (zerorun_code_size == 0) zerorun_code_size = 1; // handle special case of the 'empty' Huffman tree (root node is leaf node)
-	u32 zerorun_code_mask = (1 << zerorun_code_size) - 1;
-
-	u32 zero_counter_mask = (1 << zero_counter_size) - 1;
-	i32 decompressed_length = 0;
-	while (bits_read < block_size_in_bits) {
-		if (decompressed_length >= serialized_length || bits_read >= block_size_in_bits) {
-			break; // done
-		}
-		i32 symbol = 0;
-		i32 code_size = 1;
-		u64 blob = bitstream_lsb_read(compressed, bits_read);
-		u32 fast_index = blob & fast_mask;
-		u16 c = huffman.fast[fast_index];
-		if (c <= 255) {
-			// Lookup the symbol directly.
-			symbol = c;
-			code_size = huffman.size[symbol];
-		} else {
-			bool match = false;
-			u8 lowest_possible_symbol_index = c & 0xFF;
-
-#if  !((defined(__SSE2__) && defined(__AVX__)))
-			for (i32 i = lowest_possible_symbol_index; i < 256; ++i) {
-				u8 test_size = huffman.nonfast_size[i];
-				u16 test_code = huffman.nonfast_code[i];
-				if ((blob & size_bitmasks[test_size]) == test_code) {
-					// match
-					code_size = test_size;
-					symbol = huffman.nonfast_symbols[i];
-					match = true;
-					break;
-				}
-			}
-#else
-			// SIMD version using SSE2, very slightly faster than the version above
-			// (Need to compile with AVX enabled, otherwise unaligned loads will make it slower)
-			// NOTE: Probably not a bottleneck, the loop below (nearly) always finishes after one iteration.
-			for (i32 i = lowest_possible_symbol_index; i < 256; i += 8) {
-				__m128i size_mask = _mm_loadu_si128((__m128i*)(huffman.nonfast_size_masks + i));
-				__m128i code = _mm_loadu_si128((__m128i*)(huffman.nonfast_code + i));
-				__m128i test = _mm_set1_epi16((u16)blob);
-				test = _mm_and_si128(test, size_mask);
-				__m128i hit = _mm_cmpeq_epi16(test, code);
-				u32 hit_mask = _mm_movemask_epi8(hit);
-				if (hit_mask) {
-					u32 first_bit = bit_scan_forward(hit_mask);
-					i32 symbol_index = i + first_bit / 2;
-					symbol = huffman.nonfast_symbols[symbol_index];
-					code_size = huffman.nonfast_size[symbol_index];
-					match = true;
-//					if (symbol_index - i > 1) console_print_verbose("diff=%d, i=%d, symbol_index=%d\n", symbol_index - i, i, symbol_index);
-					break;
-				}
-			}
-			DUMMY_STATEMENT;
-#endif
-			if (!match) {
-//				dump_block(compressed, compressed_size);
-				console_print_error("Error: isyntax_hulsken_decompress(): error decoding Huffman message (unknown symbol)\n");
-				ASSERT(!"unknown symbol");
-				memset(out_buffer, 0, coeff_buffer_size);
-				release_temp_memory(&temp_memory);
-				return false;
-			}
-		}
-
-		if (code_size == 0) code_size = 1; // handle special case of the 'empty' Huffman tree (root node is leaf node)
-
-		blob >>= code_size;
-		bits_read += code_size;
-
-		// Handle run-length encoding of zeroes
-		if (symbol == zerorun_symbol) {
-			u32 numzeroes = blob & zero_counter_mask;
-			bits_read += zero_counter_size;
-			// A 'zero run' with length of zero means that this is not a zero run after all, but rather
-			// the 'escaped' zero run symbol itself which should be outputted.
-			if (numzeroes > 0) {
-				u32 actual_numzeroes = (compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
-				if (decompressed_length + actual_numzeroes >= serialized_length || bits_read >= block_size_in_bits) {
-					// Reached the end, terminate
-					memset(decompressed_buffer + decompressed_length, 0, MIN(serialized_length - decompressed_length, actual_numzeroes));
-					decompressed_length += actual_numzeroes;
-					break;
-				}
-				// If the next Huffman symbol is also the zero run symbol, then their counters actually refer to the same zero run.
-				// Basically, each extra zero run symbol expands the 'zero counter' bit depth, i.e.:
-				//   n zero symbols -> depth becomes n * counter_bits
-				u32 total_zero_counter_size = zero_counter_size;
-				for(;;) {
-					// Peek ahead in the bitstream, grab any additional zero run symbols, and recalculate numzeroes.
-					blob = bitstream_lsb_read(compressed, bits_read);
-					u32 next_code = (blob & zerorun_code_mask);
-					if (next_code == zerorun_code) {
-						// The zero run continues
-						blob >>= zerorun_code_size;
-						u32 counter_extra_bits = blob & zero_counter_mask;
-						numzeroes <<= zero_counter_size;
-						numzeroes |= (counter_extra_bits);
-						total_zero_counter_size += zero_counter_size;
-						bits_read += zerorun_code_size + zero_counter_size;
-						actual_numzeroes = (compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
-						if (decompressed_length + actual_numzeroes >= serialized_length || bits_read >= block_size_in_bits) {
-							break; // Reached the end, terminate
-						}
-					} else {
-						actual_numzeroes = (compressor_version == 2) ? numzeroes + 1 : numzeroes; // v2 stores actual count minus one
-						break; // no next zero run symbol, the zero run is finished
-					}
-				}
+	hulsken_message_decoder_t decoder = {0};
+	decoder.compressed = compressed;
+	decoder.block_size_in_bits = block_size_in_bits;
+	decoder.bits_read = bits_read;
+	decoder.decompressed_buffer = decompressed_buffer;
+	decoder.serialized_length = serialized_length;
+	decoder.huffman = huffman;
+	decoder.compressor_version = compressor_version;
+	decoder.zerorun_symbol = zerorun_symbol;
+	decoder.zerorun_code = huffman->code[zerorun_symbol];
+	decoder.zerorun_code_size = huffman->size[zerorun_symbol];
+	if (decoder.zerorun_code_size == 0) decoder.zerorun_code_size = 1; // handle special case of the 'empty' Huffman tree (root node is leaf node)
+	decoder.zerorun_code_mask = (1 << decoder.zerorun_code_size) - 1;
+	decoder.zero_counter_size = zero_counter_size;
+	decoder.zero_counter_mask = (1 << zero_counter_size) - 1;
+	decoder.use_multi_symbol_table = use_multi_symbol_table;
+
+	if (compressor_version == 2 && bitplane_group_count > 1) {
+		hulsken_decode_bitplane_groups(&decoder, bitplane_offsets, bitplane_group_starts, bitplane_group_count, decode_end);
+	}
+	hulsken_decode_until(&decoder, decode_end);
+	if (decoder.error) {
+		console_print_error("Error: isyntax_hulsken_decompress(): error decoding Huffman message (unknown symbol)\n");
+		ASSERT(!"unknown symbol");
+		memset(out_buffer, 0, coeff_buffer_size);
+		release_temp_memory(&temp_memory);
+		return false;
+	}
+	i32 decompressed_length = decoder.decompressed_length;
 
-				i32 bytes_to_write = MIN(serialized_length - decompressed_length, actual_numzeroes);
-				ASSERT(bytes_to_write > 0);
-				memset(decompressed_buffer + decompressed_length, 0, bytes_to_write);
-				decompressed_length += actual_numzeroes;
-			} else {
-				// This is not a 'zero run' after all, but an escaped symbol. So output the symbol.
-				decompressed_buffer[decompressed_length++] = symbol;
-			}
-		} else {
-			decompressed_buffer[decompressed_length++] = symbol;
+	if (stats_or_null) {
+		stats_or_null->serialized_length = (i32)MIN(decompressed_length, serialized_length);
+		stats_or_null->zero_run_bytes = decoder.zero_run_bytes;
+		stats_or_null->huffman_table_reused = huffman_table_reused;
+		if (stats_or_null->serialized_length > 0) {
+			stats_or_null->zero_density = (float)decoder.zero_run_bytes / (float)stats_or_null->serialized_length;
 		}
-
 	}
 
-	if (serialized_length != decompressed_length) {
-//		dump_block(compressed, compressed_size);
+	bool is_truncated = (decode_end < serialized_length);
+	if (is_truncated ? (decompressed_length < decode_end) : (decompressed_length != serialized_length)) {
 		console_print("iSyntax: decompressed size mismatch (size=%zu): expected %lld observed %d\n",
-				 compressed_size, serialized_length, decompressed_length);
+				 compressed_size, decode_end, decompressed_length);
 		ASSERT(!"size mismatch");
 	}
 
@@ -2906,12 +3115,8 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 		}
 	}
 
-	// unpack bitplanes
-	i32 compressed_bitplane_index = 0;
-	arena_align(temp_memory.arena, 32);
-	u16* coeff_buffer = (u16*)arena_push_size(temp_memory.arena, coeff_buffer_size);
-	memset(coeff_buffer, 0, coeff_buffer_size);
-	memset(out_buffer, 0, coeff_buffer_size);
+	// Find out which coefficient and bit each bitplane belongs to
+	u8* bitplanes_per_coeff[3][16] = {0};
 
 	{
 		u32 running_bit_index = 0;
@@ -2919,6 +3124,9 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 		u32 bitmasks_copy[3];
 		memcpy(bitmasks_copy, bitmasks, sizeof(bitmasks));
 		for (i32 bitplane_index = 0; bitplane_index < total_mask_bits; ++bitplane_index) {
+			if (bitplane_index * bytes_per_bitplane >= decode_end) {
+				break; // the remaining (less significant) bitplanes were not decoded
+			}
 			u8* bitplane = decompressed_buffer + (bitplane_index * bytes_per_bitplane);
 
 			// horribly complicated 'for loop'-style iteration, needed because v1 and v2 store bitplanes in a different order
@@ -2963,44 +3171,14 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 			}
 			// Now we figured out which coeff and bit number this bitplane belongs to
 
-			u16* current_coeff_buffer = coeff_buffer + (running_coeff_index * (block_width * block_height));
-			u16* current_out_buffer = (u16*)out_buffer + (running_coeff_index * (block_width * block_height));
-
-			// Do the bitplane unpacking
-			for (i32 i = 0; i < block_width * block_height; i += 8) {
-				i32 j = i/8;
-				// The order bitplanes are stored in depends on the compressor version
-				i32 shift_amount;
-				if (compressor_version == 1) {
-					shift_amount = (running_bit_index == 0) ? 15 : running_bit_index - 1; // bitplanes are stored sign, lsb ... msb
-				} else {
-					shift_amount = 15 - running_bit_index; // bitplanes are stored sign, msb ... lsb
-				}
-				u8 b = bitplane[j];
-				if (b == 0) continue;
-#if !defined(__SSE2__)
-				// Non-SIMD version
-					current_coeff_buffer[i+0] |= ((b >> 0) & 1) << shift_amount;
-					current_coeff_buffer[i+1] |= ((b >> 1) & 1) << shift_amount;
-					current_coeff_buffer[i+2] |= ((b >> 2) & 1) << shift_amount;
-					current_coeff_buffer[i+3] |= ((b >> 3) & 1) << shift_amount;
-					current_coeff_buffer[i+4] |= ((b >> 4) & 1) << shift_amount;
-					current_coeff_buffer[i+5] |= ((b >> 5) & 1) << shift_amount;
-					current_coeff_buffer[i+6] |= ((b >> 6) & 1) << shift_amount;
-					current_coeff_buffer[i+7] |= ((b >> 7) & 1) << shift_amount;
-#else
-				// This SIMD implementation is ~20% faster compared to the simple version above.
-				// Can it be made faster?
-				__m128i* dst = (__m128i*) (current_coeff_buffer+i);
-				uint64_t t = bswap_64(((0x8040201008040201ULL*b) & 0x8080808080808080ULL) >> 7);
-				__m128i v_t = _mm_set_epi64x(0, t);
-				__m128i array_of_bools = _mm_unpacklo_epi8(v_t, _mm_setzero_si128());
-				__m128i masks = _mm_slli_epi16(array_of_bools, shift_amount);
-				__m128i result = _mm_or_si128(*dst, masks);
-				*dst = result;
-#endif
-				DUMMY_STATEMENT;
+			// The order bitplanes are stored in depends on the compressor version
+			i32 shift_amount;
+			if (compressor_version == 1) {
+				shift_amount = (running_bit_index == 0) ? 15 : running_bit_index - 1; // bitplanes are stored sign, lsb ... msb
+			} else {
+				shift_amount = 15 - running_bit_index; // bitplanes are stored sign, msb ... lsb
 			}
+			bitplanes_per_coeff[running_coeff_index][shift_amount] = bitplane;
 
 			// finish iterating: basically, this is the '++i' part of the 'for loop' that got complicated because
 			// the v1 and v2 compressors store bitplanes in a different order
@@ -3011,36 +3189,20 @@ bool isyntax_hulsken_decompress(u8* compressed, size_t compressed_size, i32 bloc
 		}
 	}
 
-	// Reshuffle 4x2 snake-order and convert signed magnitude to twos complement
-	for (i32 coeff_index = 0; coeff_index < coeff_count; ++coeff_index) {
-		u16 bitmask = bitmasks[coeff_index];
-		u16* current_coeff_buffer = coeff_buffer + (coeff_index * (block_width * block_height));
-		u16* current_out_buffer = (u16*)out_buffer + (coeff_index * (block_width * block_height));
-		if (bitmask > 0) {
-			// Reshuffle snake-order
-			i32 area_stride_x = block_width / 4;
-			for (i32 area4x4_index = 0; area4x4_index < ((block_width * block_height) / 16); ++area4x4_index) {
-				i32 area_base_index = area4x4_index * 16;
-				i32 area_x = (area4x4_index % area_stride_x) * 4;
-				i32 area_y = (area4x4_index / area_stride_x) * 4;
-
-				u64 area_y0 = *(u64*)&current_coeff_buffer[area_base_index];
-				u64 area_y1 = *(u64*)&current_coeff_buffer[area_base_index+4];
-				u64 area_y2 = *(u64*)&current_coeff_buffer[area_base_index+8];
-				u64 area_y3 = *(u64*)&current_coeff_buffer[area_base_index+12];
-
-				*(u64*)(current_out_buffer + (area_y + 0) * block_width + area_x) = area_y0;
-				*(u64*)(current_out_buffer + (area_y + 1) * block_width + area_x) = area_y1;
-				*(u64*)(current_out_buffer + (area_y + 2) * block_width + area_x) = area_y2;
-				*(u64*)(current_out_buffer + (area_y + 3) * block_width + area_x) = area_y3;
-			}
-
-			// Convert signed magnitude to twos complement (ex. 0x8002 becomes -2)
-			signed_magnitude_to_twos_complement_16_block(current_out_buffer, block_width * block_height);
+	// Unpack the bitplanes, reshuffle 4x4 snake-order and convert signed magnitude to twos complement
+	// (this writes every coefficient, so only coefficients without any bitplanes need to be cleared).
+	// NOTE: iterate over the coefficients in the output buffer; in v1, coeff_count may have been changed above.
+	i32 out_coeff_count = (coefficient == 1) ? 3 : 1;
+	for (i32 coeff_index = 0; coeff_index < out_coeff_count; ++coeff_index) {
+		i16* current_out_buffer = out_buffer + (coeff_index * (block_width * block_height));
+		if (bitmasks[coeff_index] > 0) {
+			isyntax_kernels->reassemble_bitplanes(bitplanes_per_coeff[coeff_index], block_width, block_height, current_out_buffer);
+		} else {
+			memset(current_out_buffer, 0, block_width * block_height * sizeof(i16));
 		}
 	}
 
-	release_temp_memory(&temp_memory); // frees coeff_buffer and decompressed_buffer
+	release_temp_memory(&temp_memory); // frees decompressed_buffer
 	return true;
 }
 
@@ -61,6 +61,13 @@ typedef i32 icoeff_t;
 #define ISYNTAX_ADJ_TILE_BOTTOM_CENTER 2
 #define ISYNTAX_ADJ_TILE_BOTTOM_RIGHT 1
 
+// Child tiles (at the next lower scale) for which the IDWT of a tile produces the LL coefficients
+#define ISYNTAX_CHILD_TOP_LEFT 1
+#define ISYNTAX_CHILD_TOP_RIGHT 2
+#define ISYNTAX_CHILD_BOTTOM_LEFT 4
+#define ISYNTAX_CHILD_BOTTOM_RIGHT 8
+#define ISYNTAX_ALL_CHILDREN 0xF
+
 
 enum isyntax_image_type_enum {
 	ISYNTAX_IMAGE_TYPE_NONE = 0,
@@ -231,6 +238,15 @@ typedef struct isyntax_codeblock_t {
 	u64 block_id;
 } isyntax_codeblock_t;
 
+// Statistics about a decoded codeblock, see isyntax_hulsken_decompress_truncated().
+typedef struct isyntax_codeblock_stats_t {
+	i32 serialized_length; // size of the decoded bitplanes, in bytes
+	i32 zero_run_bytes; // how many of those bytes were produced by zero runs
+	float zero_density; // zero_run_bytes / serialized_length (1.0 for empty codeblocks)
+	bool huffman_table_reused; // the Huffman tables were taken from the per-thread cache instead of being built
+	bool is_truncated; // some magnitude bitplanes were left out (see max_magnitude_bitplanes)
+} isyntax_codeblock_stats_t;
+
 typedef struct isyntax_data_chunk_t {
 	i64 offset;
 	u32 size;
@@ -256,6 +272,13 @@ typedef struct isyntax_tile_t {
 	bool exists;
 	bool has_ll;
 	bool has_h;
+	// If nonzero, the coefficients are approximate: they were decoded (or computed from coefficients decoded) with
+	// only this many magnitude bitplanes for the H coefficients. See isyntax_hulsken_decompress_truncated().
+	u8 ll_bitplane_limit;
+	u8 h_bitplane_limit;
+	// If set, the coefficients are only present for the Y color channel (loaded for a grayscale read).
+	bool ll_is_y_only;
+	bool h_is_y_only;
 	bool is_submitted_for_h_coeff_decompression;
 	bool is_submitted_for_loading;
 	bool is_loaded;
@@ -264,7 +287,7 @@ typedef struct isyntax_tile_t {
     // TODO(avirodov): need to rethink this, maybe an external struct that points to isyntax_tile_t. The benefit
     //   is that the cache is usually smaller than the number of tiles. The con is that I'll need to manage list memory
     //   (probably another allocator for small objects - list nodes).
-    bool cache_marked;
+    u32 cache_marked; // id of the read that has reserved the tile (0 if none), see isyntax_tile_read_multiple()
     struct isyntax_tile_t* cache_next;
     struct isyntax_tile_t* cache_prev;
 
@@ -425,15 +448,35 @@ typedef struct isyntax_t {
 
 // function prototypes
 bool isyntax_hulsken_decompress(u8 *compressed, size_t compressed_size, i32 block_width, i32 block_height, i32 coefficient, i32 compressor_version, i16* out_buffer);
+bool isyntax_hulsken_decompress_truncated(u8* compressed, size_t compressed_size, i32 block_width, i32 block_height, i32 coefficient, i32 compressor_version, i32 max_magnitude_bitplanes, i16* out_buffer, isyntax_codeblock_stats_t* stats_or_null);
+void isyntax_hulsken_reassemble_bitplanes(u8** bitplanes, i32 block_width, i32 block_height, i16* out);
+void isyntax_hulsken_set_huffman_table_cache_enabled(bool enabled);
+void isyntax_hulsken_reassemble_bitplanes_scalar(u8** bitplanes, i32 block_width, i32 block_height, i16* out);
 void isyntax_set_thread_pool(isyntax_t* isyntax, thread_pool_t* thread_pool);
 bool isyntax_open(isyntax_t* isyntax, const char* filename, enum libisyntax_open_flags_t flags);
 void isyntax_destroy(isyntax_t* isyntax);
+i32 isyntax_pixel_format_bytes_per_pixel(enum isyntax_pixel_format_t pixel_format);
+i32 isyntax_pixel_format_packed_stride(enum isyntax_pixel_format_t pixel_format, i32 width);
+i32 isyntax_pixel_format_color_count(enum isyntax_pixel_format_t pixel_format);
+i32 isyntax_pixel_format_plane_count(enum isyntax_pixel_format_t pixel_format);
+void isyntax_convert_ycocg_to_pixels(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, void* out_pixels, i32 out_stride, enum isyntax_pixel_format_t pixel_format);
 void isyntax_idwt(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height, bool output_steps_as_png, const char* png_name);
+void isyntax_idwt_line_based(icoeff_t* idwt, icoeff_t* dest, i32 quadrant_width, i32 quadrant_height);
 void isyntax_load_tile(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, block_allocator_t* ll_coeff_block_allocator,
                        u32* out_buffer_or_null, enum isyntax_pixel_format_t pixel_format);
+void isyntax_load_tile_with_children(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                                     block_allocator_t* ll_coeff_block_allocator, u32 child_ll_mask, i32 color_count,
+                                     void* out_buffer_or_null, i32 out_stride, i32 out_x, i32 out_y,
+                                     i32 out_width, i32 out_height, enum isyntax_pixel_format_t pixel_format);
+void isyntax_load_tile_window(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y,
+                              i32 color_count, i32 x, i32 y, i32 width, i32 height,
+                              void* out_buffer, i32 out_stride, enum isyntax_pixel_format_t pixel_format);
 u32 isyntax_get_adjacent_tiles_mask(isyntax_level_t* level, i32 tile_x, i32 tile_y);
 u32 isyntax_get_adjacent_tiles_mask_only_existing(isyntax_level_t* level, i32 tile_x, i32 tile_y);
 u32 isyntax_idwt_tile_for_color_channel(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, i32 color, icoeff_t* dest_buffer);
+u32 isyntax_idwt_tile_for_color_channels(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, i32 first_color, i32 color_count, icoeff_t** dest_buffers);
+u32 isyntax_idwt_tile_window_for_color_channels(isyntax_t* isyntax, isyntax_image_t* wsi, i32 scale, i32 tile_x, i32 tile_y, i32 first_color, i32 color_count,
+                                                i32 window_x, i32 window_y, i32 window_width, i32 window_height, icoeff_t** dest_buffers);
 void isyntax_decompress_codeblock_in_chunk(isyntax_codeblock_t* codeblock, i32 block_width, i32 block_height, u8* chunk, u64 chunk_base_offset, i32 compressor_version, i16* out_buffer);
 i32 isyntax_get_chunk_codeblocks_per_color_for_level(i32 level, bool has_ll);
 u8* isyntax_get_associated_image_pixels(isyntax_t* isyntax, isyntax_image_t* image, enum isyntax_pixel_format_t pixel_format);
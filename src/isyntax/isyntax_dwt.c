@@ -63,6 +63,13 @@
 #endif
 #endif
 
+/** The horizontal pass uses AVX-512 registers where available (see opj_idwt53_h_cas1_even_AVX512()) */
+#if (DWT_COEFF_BITS==16 && defined(__AVX512BW__)) || (DWT_COEFF_BITS!=16 && defined(__AVX512F__))
+#define OPJ_IDWT53_H_AVX512 1
+#else
+#define OPJ_IDWT53_H_AVX512 0
+#endif
+
 /** Number of columns that we can process in parallel in the vertical pass */
 #define PARALLEL_COLS_53     (2*VREG_INT_COUNT)
 
@@ -154,31 +161,50 @@ static void  opj_idwt53_h_cas1(icoeff_t* tmp, const i32 sn, const i32 len, icoef
 	memcpy(tiledp, tmp, (u32)len * sizeof(icoeff_t));
 }
 
-/* <summary>                            */
-/* Inverse 5-3 wavelet transform in 1-D for one row. */
-/* </summary>                           */
-/* Performs interleave, inverse wavelet transform and copy back to buffer */
-static void opj_idwt53_h(const opj_dwt_t *dwt, icoeff_t* tiledp) {
-	const i32 sn = dwt->sn;
-	const i32 len = sn + dwt->dn;
-	if (dwt->cas == 0) { /* Left-most sample is on even coordinate */
-		if (len > 1) {
-			opj_idwt53_h_cas0(dwt->mem, sn, len, tiledp);
-		} else {
-			/* Unmodified value */
+/* Horizontal inverse 5x3 wavelet transform: helpers for the case where the */
+/* left-most sample is on an odd coordinate, and the row has as many low as */
+/* high pass samples (this is how all rows are laid out in isyntax). */
+/* Per position j in the low/high pass bands: */
+/*   d[j]       = in_odd[j] - ((in_even[j] + in_even[j+1] + 2) >> 2), with in_even[sn] = in_even[sn-1] */
+/*   out[2j + 1] = d[j] */
+/*   out[2j]     = in_even[j] + ((d[j] + d[j-1]) >> 1), with d[-1] = d[0] */
+static inline icoeff_t opj_idwt53_h_cas1_d(const icoeff_t* in_even, const icoeff_t* in_odd, i32 sn, i32 j) {
+	if (j == sn - 1) {
+		return in_odd[j] - ((in_even[j] + 1) >> 1);
+	}
+	return in_odd[j] - ((in_even[j] + in_even[j + 1] + 2) >> 2);
+}
+
+static void opj_idwt53_h_cas1_even_range(icoeff_t* tmp, const icoeff_t* in_even, const icoeff_t* in_odd, i32 sn,
+                                         i32 j_begin, i32 j_end) {
+	for (i32 j = j_begin; j < j_end; ++j) {
+		icoeff_t d = opj_idwt53_h_cas1_d(in_even, in_odd, sn, j);
+		icoeff_t d_prev = (j == 0) ? d : opj_idwt53_h_cas1_d(in_even, in_odd, sn, j - 1);
+		tmp[2 * j] = in_even[j] + ((d + d_prev) >> 1);
+		tmp[2 * j + 1] = d;
+	}
+}
+
+/* Vertical lifting steps applied to whole rows at once, for the line-based 2-D transform (top-most pixel on odd */
+/* coordinate). Same arithmetic as opj_idwt3_v_cas1(), for the columns x_begin <= x < x_end: */
+/*   d_out = in_odd - ((s + s_next + 2) >> 2) */
+/*   s_out = s + ((d + d_prev) >> 1), or s + d for the first row (d_prev == NULL) */
+static void opj_idwt53_v_cas1_row_d_range(icoeff_t* d_out, const icoeff_t* in_odd, const icoeff_t* s,
+                                          const icoeff_t* s_next, i32 x_begin, i32 x_end) {
+	for (i32 x = x_begin; x < x_end; ++x) {
+		d_out[x] = in_odd[x] - ((s[x] + s_next[x] + 2) >> 2);
+	}
+}
+
+static void opj_idwt53_v_cas1_row_s_range(icoeff_t* s_out, const icoeff_t* s, const icoeff_t* d,
+                                          const icoeff_t* d_prev, i32 x_begin, i32 x_end) {
+	if (d_prev == NULL) {
+		for (i32 x = x_begin; x < x_end; ++x) {
+			s_out[x] = s[x] + d[x];
 		}
-	} else { /* Left-most sample is on odd coordinate */
-		if (len == 1) {
-			tiledp[0] /= 2;
-		} else if (len == 2) {
-			icoeff_t* out = dwt->mem;
-			const icoeff_t* in_even = &tiledp[sn];
-			const icoeff_t* in_odd = &tiledp[0];
-			out[1] = in_odd[0] - ((in_even[0] + 1) >> 1);
-			out[0] = in_even[0] + out[1];
-			memcpy(tiledp, dwt->mem, (u32)len * sizeof(icoeff_t));
-		} else if (len > 2) {
-			opj_idwt53_h_cas1(dwt->mem, sn, len, tiledp);
+	} else {
+		for (i32 x = x_begin; x < x_end; ++x) {
+			s_out[x] = s[x] + ((d[x] + d_prev[x]) >> 1);
 		}
 	}
 }
@@ -423,6 +449,87 @@ static void opj_idwt53_v_cas1_mcols_SSE2_OR_AVX2(icoeff_t* tmp, const i32 sn, co
 	opj_idwt53_v_final_memcpy(tiledp_col, tmp, len, stride);
 }
 
+#if __AVX2__
+/* unpacklo/hi work within 128-bit lanes; fix up the lane order afterwards */
+#if (DWT_COEFF_BITS==16)
+#define UNPACKLO(x,y) _mm256_unpacklo_epi16((x),(y))
+#define UNPACKHI(x,y) _mm256_unpackhi_epi16((x),(y))
+#else
+#define UNPACKLO(x,y) _mm256_unpacklo_epi32((x),(y))
+#define UNPACKHI(x,y) _mm256_unpackhi_epi32((x),(y))
+#endif
+#define INTERLEAVE_LO(x,y) _mm256_permute2x128_si256(UNPACKLO(x,y), UNPACKHI(x,y), 0x20)
+#define INTERLEAVE_HI(x,y) _mm256_permute2x128_si256(UNPACKLO(x,y), UNPACKHI(x,y), 0x31)
+#else
+#if (DWT_COEFF_BITS==16)
+#define INTERLEAVE_LO(x,y) _mm_unpacklo_epi16((x),(y))
+#define INTERLEAVE_HI(x,y) _mm_unpackhi_epi16((x),(y))
+#else
+#define INTERLEAVE_LO(x,y) _mm_unpacklo_epi32((x),(y))
+#define INTERLEAVE_HI(x,y) _mm_unpackhi_epi32((x),(y))
+#endif
+#endif
+
+#if !OPJ_IDWT53_H_AVX512
+/** Horizontal inverse 5x3 wavelet transform for one row, when left-most
+ * pixel is on odd coordinate and sn == dn. Vectorized along the row:
+ * the neighbouring samples needed by the lifting steps are picked up with
+ * unaligned loads, so no transposes are needed. */
+static void opj_idwt53_h_cas1_even_SSE2_OR_AVX2(icoeff_t* tmp, const i32 sn, icoeff_t* tiledp) {
+	const icoeff_t* in_even = &tiledp[sn];
+	const icoeff_t* in_odd = &tiledp[0];
+	const VREG two = LOAD_CST(2);
+
+	/* The first and last positions need the mirrored boundary values, leave them to the scalar code. */
+	i32 j = 1;
+	for (; j + VREG_INT_COUNT <= sn - 1; j += VREG_INT_COUNT) {
+		VREG s_prev = LOADU(in_even + j - 1);
+		VREG s = LOADU(in_even + j);
+		VREG s_next = LOADU(in_even + j + 1);
+		VREG d_prev = SUB(LOADU(in_odd + j - 1), SAR(ADD3(s_prev, s, two), 2));
+		VREG d = SUB(LOADU(in_odd + j), SAR(ADD3(s, s_next, two), 2));
+		VREG e = ADD(s, SAR(ADD(d, d_prev), 1));
+		STOREU(tmp + 2 * j, INTERLEAVE_LO(e, d));
+		STOREU(tmp + 2 * j + VREG_INT_COUNT, INTERLEAVE_HI(e, d));
+	}
+	opj_idwt53_h_cas1_even_range(tmp, in_even, in_odd, sn, 0, 1);
+	opj_idwt53_h_cas1_even_range(tmp, in_even, in_odd, sn, j, sn);
+	memcpy(tiledp, tmp, (u32)(2 * sn) * sizeof(icoeff_t));
+}
+#endif /* !OPJ_IDWT53_H_AVX512 */
+
+/** Vertical lifting steps for whole rows (see opj_idwt53_v_cas1_row_d_range()), */
+/* with the same 16-bit arithmetic as opj_idwt53_v_cas1_mcols_SSE2_OR_AVX2() */
+static void opj_idwt53_v_cas1_row_d_SSE2_OR_AVX2(icoeff_t* d_out, const icoeff_t* in_odd, const icoeff_t* s,
+                                                 const icoeff_t* s_next, i32 width) {
+	const VREG two = LOAD_CST(2);
+	i32 x = 0;
+	for (; x + VREG_INT_COUNT <= width; x += VREG_INT_COUNT) {
+		STOREU(d_out + x, SUB(LOADU(in_odd + x), SAR(ADD3(LOADU(s + x), LOADU(s_next + x), two), 2)));
+	}
+	opj_idwt53_v_cas1_row_d_range(d_out, in_odd, s, s_next, x, width);
+}
+
+static void opj_idwt53_v_cas1_row_s_SSE2_OR_AVX2(icoeff_t* s_out, const icoeff_t* s, const icoeff_t* d,
+                                                 const icoeff_t* d_prev, i32 width) {
+	i32 x = 0;
+	if (d_prev == NULL) {
+		for (; x + VREG_INT_COUNT <= width; x += VREG_INT_COUNT) {
+			STOREU(s_out + x, ADD(LOADU(s + x), LOADU(d + x)));
+		}
+	} else {
+		for (; x + VREG_INT_COUNT <= width; x += VREG_INT_COUNT) {
+			STOREU(s_out + x, ADD(LOADU(s + x), SAR(ADD(LOADU(d + x), LOADU(d_prev + x)), 1)));
+		}
+	}
+	opj_idwt53_v_cas1_row_s_range(s_out, s, d, d_prev, x, width);
+}
+
+#undef UNPACKLO
+#undef UNPACKHI
+#undef INTERLEAVE_LO
+#undef INTERLEAVE_HI
+
 #undef VREG
 #undef LOAD_CST
 #undef LOADU
@@ -436,6 +543,70 @@ static void opj_idwt53_v_cas1_mcols_SSE2_OR_AVX2(icoeff_t* tmp, const i32 sn, co
 
 #endif /* (defined(__SSE2__) || defined(__AVX2__)) && !defined(STANDARD_SLOW_VERSION) */
 
+#if OPJ_IDWT53_H_AVX512
+#if (DWT_COEFF_BITS==16)
+#define VREG512_INT_COUNT 32
+#define ADD512(x,y) _mm512_add_epi16((x),(y))
+#define SUB512(x,y) _mm512_sub_epi16((x),(y))
+#define SAR512(x,y) _mm512_srai_epi16((x),(y))
+#define SET1_512(x) _mm512_set1_epi16(x)
+#define PERMUTEX2VAR512(x,idx,y) _mm512_permutex2var_epi16((x),(idx),(y))
+#else
+#define VREG512_INT_COUNT 16
+#define ADD512(x,y) _mm512_add_epi32((x),(y))
+#define SUB512(x,y) _mm512_sub_epi32((x),(y))
+#define SAR512(x,y) _mm512_srai_epi32((x),(y))
+#define SET1_512(x) _mm512_set1_epi32(x)
+#define PERMUTEX2VAR512(x,idx,y) _mm512_permutex2var_epi32((x),(idx),(y))
+#endif
+
+/** Same as opj_idwt53_h_cas1_even_SSE2_OR_AVX2(), with AVX-512 registers.
+ * The even/odd outputs are interleaved with a two-source permute, which
+ * (unlike unpacklo/hi) is not confined to 128-bit lanes. */
+static void opj_idwt53_h_cas1_even_AVX512(icoeff_t* tmp, const i32 sn, icoeff_t* tiledp) {
+	const icoeff_t* in_even = &tiledp[sn];
+	const icoeff_t* in_odd = &tiledp[0];
+	const __m512i two = SET1_512(2);
+
+	/* Output element i comes from e[i / 2] (even i) or d[i / 2] (odd i); indices of the second source start at VREG512_INT_COUNT */
+	static const icoeff_t interleave_indices[2 * VREG512_INT_COUNT] = {
+#if (DWT_COEFF_BITS==16)
+		0, 32, 1, 33, 2, 34, 3, 35, 4, 36, 5, 37, 6, 38, 7, 39,
+		8, 40, 9, 41, 10, 42, 11, 43, 12, 44, 13, 45, 14, 46, 15, 47,
+		16, 48, 17, 49, 18, 50, 19, 51, 20, 52, 21, 53, 22, 54, 23, 55,
+		24, 56, 25, 57, 26, 58, 27, 59, 28, 60, 29, 61, 30, 62, 31, 63,
+#else
+		0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23,
+		8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31,
+#endif
+	};
+	const __m512i interleave_lo = _mm512_loadu_si512(interleave_indices);
+	const __m512i interleave_hi = _mm512_loadu_si512(interleave_indices + VREG512_INT_COUNT);
+
+	i32 j = 1;
+	for (; j + VREG512_INT_COUNT <= sn - 1; j += VREG512_INT_COUNT) {
+		__m512i s_prev = _mm512_loadu_si512(in_even + j - 1);
+		__m512i s = _mm512_loadu_si512(in_even + j);
+		__m512i s_next = _mm512_loadu_si512(in_even + j + 1);
+		__m512i d_prev = SUB512(_mm512_loadu_si512(in_odd + j - 1), SAR512(ADD512(ADD512(s_prev, s), two), 2));
+		__m512i d = SUB512(_mm512_loadu_si512(in_odd + j), SAR512(ADD512(ADD512(s, s_next), two), 2));
+		__m512i e = ADD512(s, SAR512(ADD512(d, d_prev), 1));
+		_mm512_storeu_si512(tmp + 2 * j, PERMUTEX2VAR512(e, interleave_lo, d));
+		_mm512_storeu_si512(tmp + 2 * j + VREG512_INT_COUNT, PERMUTEX2VAR512(e, interleave_hi, d));
+	}
+	opj_idwt53_h_cas1_even_range(tmp, in_even, in_odd, sn, 0, 1);
+	opj_idwt53_h_cas1_even_range(tmp, in_even, in_odd, sn, j, sn);
+	memcpy(tiledp, tmp, (u32)(2 * sn) * sizeof(icoeff_t));
+}
+
+#undef VREG512_INT_COUNT
+#undef ADD512
+#undef SUB512
+#undef SAR512
+#undef SET1_512
+#undef PERMUTEX2VAR512
+#endif
+
 /** Vertical inverse 5x3 wavelet transform for one column, when top-most
  * pixel is on even coordinate */
 static void opj_idwt3_v_cas0(icoeff_t* tmp, const i32 sn, const i32 len, icoeff_t* tiledp_col, const size_t stride) {
@@ -521,6 +692,46 @@ static void opj_idwt3_v_cas1(icoeff_t* tmp, const i32 sn, const i32 len, icoeff_
 	}
 }
 
+/* <summary>                            */
+/* Inverse 5-3 wavelet transform in 1-D for one row. */
+/* </summary>                           */
+/* Performs interleave, inverse wavelet transform and copy back to buffer */
+static void opj_idwt53_h(const opj_dwt_t *dwt, icoeff_t* tiledp) {
+	const i32 sn = dwt->sn;
+	const i32 len = sn + dwt->dn;
+	if (dwt->cas == 0) { /* Left-most sample is on even coordinate */
+		if (len > 1) {
+			opj_idwt53_h_cas0(dwt->mem, sn, len, tiledp);
+		} else {
+			/* Unmodified value */
+		}
+	} else { /* Left-most sample is on odd coordinate */
+		if (len == 1) {
+			tiledp[0] /= 2;
+		} else if (len == 2) {
+			icoeff_t* out = dwt->mem;
+			const icoeff_t* in_even = &tiledp[sn];
+			const icoeff_t* in_odd = &tiledp[0];
+			out[1] = in_odd[0] - ((in_even[0] + 1) >> 1);
+			out[0] = in_even[0] + out[1];
+			memcpy(tiledp, dwt->mem, (u32)len * sizeof(icoeff_t));
+		} else if (len > 2) {
+#if OPJ_IDWT53_H_AVX512
+			if (sn == dwt->dn) {
+				opj_idwt53_h_cas1_even_AVX512(dwt->mem, sn, tiledp);
+				return;
+			}
+#elif (defined(__SSE2__) || defined(__AVX2__))
+			if (sn == dwt->dn) {
+				opj_idwt53_h_cas1_even_SSE2_OR_AVX2(dwt->mem, sn, tiledp);
+				return;
+			}
+#endif
+			opj_idwt53_h_cas1(dwt->mem, sn, len, tiledp);
+		}
+	}
+}
+
 /* <summary>                            */
 /* Inverse vertical 5-3 wavelet transform in 1-D for several columns. */
 /* </summary>                           */
@@ -591,4 +802,39 @@ static void opj_idwt53_v(const opj_dwt_t *dwt, icoeff_t* tiledp_col, size_t stri
 		}
 	}
 }
-// End of openjp2 code.
\ No newline at end of file
+// End of openjp2 code.
+/* <summary>                            */
+/* Inverse 5-3 wavelet transform in 2-D, processed line by line. */
+/* </summary>                           */
+/* Each pair of output rows only depends on the next row of both the low and the high pass band, so the horizontal */
+/* and the vertical lifting can be interleaved: every input row is transformed horizontally (in place) right before */
+/* it is first needed, and the vertical lifting writes the output rows to dest, which must not overlap tiledp. */
+/* This keeps the working set down to a few rows, instead of streaming the whole buffer twice. */
+/* Only for sn == dn with the top-most / left-most pixel on odd coordinates (which is what iSyntax uses). */
+static void opj_idwt53_2d_cas1_lines(const opj_dwt_t* h, icoeff_t* tiledp, icoeff_t* dest, i32 sn, size_t stride) {
+	const i32 width = h->sn + h->dn;
+	ASSERT(h->cas == 1);
+	ASSERT(sn >= 2);
+	icoeff_t* in_even = tiledp + (size_t)sn * stride;
+	icoeff_t* in_odd = tiledp;
+
+	opj_idwt53_h(h, in_even);
+	for (i32 j = 0; j < sn; ++j) {
+		icoeff_t* s = in_even + (size_t)j * stride;
+		icoeff_t* s_next = s;
+		if (j + 1 < sn) {
+			s_next = s + stride;
+			opj_idwt53_h(h, s_next);
+		}
+		opj_idwt53_h(h, in_odd + (size_t)j * stride);
+		icoeff_t* d = dest + (size_t)(2 * j + 1) * stride;
+		icoeff_t* d_prev = (j == 0) ? NULL : d - 2 * stride;
+#if (defined(__SSE2__) || defined(__AVX2__))
+		opj_idwt53_v_cas1_row_d_SSE2_OR_AVX2(d, in_odd + (size_t)j * stride, s, s_next, width);
+		opj_idwt53_v_cas1_row_s_SSE2_OR_AVX2(d - stride, s, d, d_prev, width);
+#else
+		opj_idwt53_v_cas1_row_d_range(d, in_odd + (size_t)j * stride, s, s_next, 0, width);
+		opj_idwt53_v_cas1_row_s_range(d - stride, s, d, d_prev, 0, width);
+#endif
+	}
+}
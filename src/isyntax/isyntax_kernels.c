@@ -0,0 +1,1084 @@
+/*
+  BSD 2-Clause License
+
+  Copyright (c) 2019-2026, Pieter Valkema
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+  SIMD kernels for the decoding stages that dominate tile loading: bitplane reassembly, the inverse wavelet
+  transform and the YCoCg color conversion.
+
+  This file is not compiled on its own. It is included by the isyntax_kernels_*.c files, which are each compiled
+  for a different instruction set level (see CMakeLists.txt / meson.build). Everything in here is static, except
+  the table of function pointers at the bottom, which is named by ISYNTAX_KERNELS_TABLE.
+*/
+
+#ifndef ISYNTAX_KERNELS_TABLE
+#error "isyntax_kernels.c should be included from one of the isyntax_kernels_*.c files"
+#endif
+
+#include "common.h"
+#include "intrinsics.h"
+
+#include "isyntax.h"
+#include "isyntax_kernels.h"
+
+#include "isyntax_dwt.c"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_AVX512
+#elif defined(__AVX2__)
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_AVX2
+#elif defined(__SSSE3__)
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_SSSE3
+#elif defined(__SSE2__)
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_NEON
+#else
+#define ISYNTAX_KERNELS_SIMD_LEVEL LIBISYNTAX_SIMD_LEVEL_SCALAR
+#endif
+
+// Reassemble coefficients from their bitplanes.
+// bitplanes[bit] points to the bitplane that holds this bit of each coefficient (bit 15 is the sign bit), or is NULL if
+// the bitplane is not present. Bit k of bitplane byte j belongs to coefficient 8*j+k, and the coefficients are stored
+// in 4x4 'snake' order. The output is written in raster order, converted to two's complement.
+
+static inline void store_snake_area_4x4(i16* out, i32 block_width, i32 area_index, const u16* values) {
+	i32 area_stride_x = block_width / 4;
+	i32 area_x = (area_index % area_stride_x) * 4;
+	i32 area_y = (area_index / area_stride_x) * 4;
+	i16* dest = out + area_y * block_width + area_x;
+	for (i32 y = 0; y < 4; ++y) {
+		for (i32 x = 0; x < 4; ++x) {
+			dest[y * block_width + x] = signed_magnitude_to_twos_complement_16(values[y * 4 + x]);
+		}
+	}
+}
+
+static void reassemble_bitplanes_scalar(u8** bitplanes, i32 block_width, i32 first_area, i32 end_area, i16* out) {
+	u8* present_bitplanes[16];
+	u16 present_bits[16];
+	i32 present_count = 0;
+	for (i32 bit = 0; bit < 16; ++bit) {
+		if (bitplanes[bit]) {
+			present_bitplanes[present_count] = bitplanes[bit];
+			present_bits[present_count] = (u16)(1 << bit);
+			++present_count;
+		}
+	}
+	for (i32 area_index = first_area; area_index < end_area; ++area_index) {
+		u16 values[16] = {0};
+		for (i32 i = 0; i < present_count; ++i) {
+			u8* bitplane = present_bitplanes[i];
+			u32 bits = bitplane[area_index * 2] | (bitplane[area_index * 2 + 1] << 8);
+			while (bits) {
+				values[bit_scan_forward(bits)] |= present_bits[i];
+				bits &= bits - 1;
+			}
+		}
+		store_snake_area_4x4(out, block_width, area_index, values);
+	}
+}
+
+#if ISYNTAX_KERNELS_IS_BASELINE
+void isyntax_hulsken_reassemble_bitplanes_scalar(u8** bitplanes, i32 block_width, i32 block_height, i16* out) {
+	reassemble_bitplanes_scalar(bitplanes, block_width, 0, (block_width * block_height) / 16, out);
+}
+#endif
+
+#if defined(__SSE2__)
+
+static inline __m128i signed_magnitude_to_twos_complement_16_sse2(__m128i x) {
+	__m128i sign_masks = _mm_srai_epi16(x, 15); // 0x0000 if positive, 0xFFFF if negative
+	__m128i maybe_positive = _mm_andnot_si128(sign_masks, x); // (~m & x)
+	__m128i value_if_negative = _mm_sub_epi16(_mm_and_si128(x, _mm_set1_epi16((i16)0x8000)), x); // (x & 0x8000) - x
+	__m128i maybe_negative = _mm_and_si128(sign_masks, value_if_negative);
+	return _mm_or_si128(maybe_positive, maybe_negative);
+}
+
+// Convert 16 coefficients (one 4x4 area in snake order) and store them in raster order.
+static inline void store_snake_area_4x4_sse2(i16* out, i32 block_width, i32 area_index, const u16* values) {
+	i32 area_stride_x = block_width / 4;
+	i32 area_x = (area_index % area_stride_x) * 4;
+	i32 area_y = (area_index / area_stride_x) * 4;
+	i16* dest = out + area_y * block_width + area_x;
+	__m128i rows01 = signed_magnitude_to_twos_complement_16_sse2(_mm_loadu_si128((__m128i*)values));
+	__m128i rows23 = signed_magnitude_to_twos_complement_16_sse2(_mm_loadu_si128((__m128i*)(values + 8)));
+	_mm_storel_epi64((__m128i*)(dest), rows01);
+	_mm_storel_epi64((__m128i*)(dest + block_width), _mm_unpackhi_epi64(rows01, rows01));
+	_mm_storel_epi64((__m128i*)(dest + 2 * block_width), rows23);
+	_mm_storel_epi64((__m128i*)(dest + 3 * block_width), _mm_unpackhi_epi64(rows23, rows23));
+}
+
+static inline void store_zero_area_4x4(i16* out, i32 block_width, i32 area_index) {
+	i32 area_stride_x = block_width / 4;
+	i32 area_x = (area_index % area_stride_x) * 4;
+	i32 area_y = (area_index / area_stride_x) * 4;
+	i16* dest = out + area_y * block_width + area_x;
+	for (i32 y = 0; y < 4; ++y) {
+		_mm_storel_epi64((__m128i*)(dest + y * block_width), _mm_setzero_si128());
+	}
+}
+
+// For nearly empty chunks (typical for background), only assemble the few coefficients that are not zero.
+// 'nonzero_bits' has a bit set for each coefficient in the chunk that has a bit set in any of the bitplanes.
+static void reassemble_sparse_chunk(u8** bitplanes, i32 block_width, i32 first_coeff, i32 chunk_size,
+                                    const u64* nonzero_bits, i16* out) {
+	for (i32 area = 0; area < chunk_size / 16; ++area) {
+		store_zero_area_4x4(out, block_width, first_coeff / 16 + area);
+	}
+	i32 area_stride_x = block_width / 4;
+	for (i32 word = 0; word < chunk_size / 64; ++word) {
+		u64 bits = nonzero_bits[word];
+		while (bits) {
+			i32 coeff_index = first_coeff + word * 64 + (i32)bit_scan_forward_64(bits);
+			bits &= bits - 1;
+			u16 value = 0;
+			for (i32 bit = 0; bit < 16; ++bit) {
+				if (bitplanes[bit]) {
+					value |= (u16)(((bitplanes[bit][coeff_index / 8] >> (coeff_index % 8)) & 1) << bit);
+				}
+			}
+			i32 area_index = coeff_index / 16;
+			i32 x = (area_index % area_stride_x) * 4 + (coeff_index % 4);
+			i32 y = (area_index / area_stride_x) * 4 + (coeff_index % 16) / 4;
+			out[y * block_width + x] = signed_magnitude_to_twos_complement_16(value);
+		}
+	}
+}
+
+// Below this many nonzero coefficients per chunk, reassemble_sparse_chunk() is faster than the full bit-transpose.
+#define REASSEMBLE_SPARSE_CHUNK_THRESHOLD 8
+
+#endif // defined(__SSE2__)
+
+static void reassemble_bitplanes(u8** bitplanes, i32 block_width, i32 block_height, i16* out) {
+	i32 coeff_count = block_width * block_height;
+	i32 i = 0;
+#if defined(__SSE2__)
+	// Bit-transpose: with the bitplanes as the rows of a matrix of bytes (one row per bit position), a 16x16 byte
+	// transpose gathers for each plane byte j the bytes of all bit positions in one register. Shifting bit k of each
+	// byte into the top position and taking the byte movemask then yields all 16 bits of coefficient 8*j+k at once.
+	u16 values[256];
+#if defined(__AVX2__)
+	// Two independent 16x16 transposes, one in each 128-bit lane: 256 coefficients at a time.
+	for (; i + 256 <= coeff_count; i += 256) {
+		__m256i rows[16];
+		__m256i any = _mm256_setzero_si256();
+		for (i32 bit = 0; bit < 16; ++bit) {
+			if (bitplanes[bit]) {
+				rows[bit] = _mm256_loadu_si256((__m256i*)(bitplanes[bit] + i / 8));
+				any = _mm256_or_si256(any, rows[bit]);
+			} else {
+				rows[bit] = _mm256_setzero_si256();
+			}
+		}
+		u64 nonzero_bits[4];
+		_mm256_storeu_si256((__m256i*)nonzero_bits, any);
+		i32 nonzero_count = popcount_64(nonzero_bits[0]) + popcount_64(nonzero_bits[1]) +
+		                    popcount_64(nonzero_bits[2]) + popcount_64(nonzero_bits[3]);
+		if (nonzero_count <= REASSEMBLE_SPARSE_CHUNK_THRESHOLD) {
+			reassemble_sparse_chunk(bitplanes, block_width, i, 256, nonzero_bits, out);
+			continue;
+		}
+		// Four rounds of interleaving rows i and i+8 transpose the 16x16 matrix (in each lane).
+		for (i32 round = 0; round < 4; ++round) {
+			__m256i interleaved[16];
+			for (i32 r = 0; r < 8; ++r) {
+				interleaved[2 * r] = _mm256_unpacklo_epi8(rows[r], rows[r + 8]);
+				interleaved[2 * r + 1] = _mm256_unpackhi_epi8(rows[r], rows[r + 8]);
+			}
+			memcpy(rows, interleaved, sizeof(rows));
+		}
+		for (i32 j = 0; j < 16; ++j) {
+			__m256i column = rows[j];
+			for (i32 k = 7; k >= 0; --k) {
+				u32 mask = (u32)_mm256_movemask_epi8(column);
+				values[j * 8 + k] = (u16)mask;
+				values[128 + j * 8 + k] = (u16)(mask >> 16);
+				column = _mm256_add_epi8(column, column); // next lower bit into the top position
+			}
+		}
+		for (i32 area = 0; area < 16; ++area) {
+			store_snake_area_4x4_sse2(out, block_width, i / 16 + area, values + area * 16);
+		}
+	}
+#endif // defined(__AVX2__)
+	for (; i + 128 <= coeff_count; i += 128) {
+		__m128i rows[16];
+		__m128i any = _mm_setzero_si128();
+		for (i32 bit = 0; bit < 16; ++bit) {
+			if (bitplanes[bit]) {
+				rows[bit] = _mm_loadu_si128((__m128i*)(bitplanes[bit] + i / 8));
+				any = _mm_or_si128(any, rows[bit]);
+			} else {
+				rows[bit] = _mm_setzero_si128();
+			}
+		}
+		u64 nonzero_bits[2];
+		_mm_storeu_si128((__m128i*)nonzero_bits, any);
+		if (popcount_64(nonzero_bits[0]) + popcount_64(nonzero_bits[1]) <= REASSEMBLE_SPARSE_CHUNK_THRESHOLD) {
+			reassemble_sparse_chunk(bitplanes, block_width, i, 128, nonzero_bits, out);
+			continue;
+		}
+		for (i32 round = 0; round < 4; ++round) {
+			__m128i interleaved[16];
+			for (i32 r = 0; r < 8; ++r) {
+				interleaved[2 * r] = _mm_unpacklo_epi8(rows[r], rows[r + 8]);
+				interleaved[2 * r + 1] = _mm_unpackhi_epi8(rows[r], rows[r + 8]);
+			}
+			memcpy(rows, interleaved, sizeof(rows));
+		}
+		for (i32 j = 0; j < 16; ++j) {
+			__m128i column = rows[j];
+			for (i32 k = 7; k >= 0; --k) {
+				values[j * 8 + k] = (u16)_mm_movemask_epi8(column);
+				column = _mm_add_epi8(column, column);
+			}
+		}
+		for (i32 area = 0; area < 8; ++area) {
+			store_snake_area_4x4_sse2(out, block_width, i / 16 + area, values + area * 16);
+		}
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	// NEON has no movemask; instead, accumulate each coefficient's bits directly in 16-bit lanes.
+	// Per bitplane, 8 coefficients are expanded from one byte by testing it against the bit weights.
+	static const u16 bit_weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+	uint16x8_t weights = vld1q_u16(bit_weights);
+	for (; i + 16 <= coeff_count; i += 16) {
+		uint16x8_t acc_lo = vdupq_n_u16(0);
+		uint16x8_t acc_hi = vdupq_n_u16(0);
+		for (i32 bit = 0; bit < 16; ++bit) {
+			u8* bitplane = bitplanes[bit];
+			if (bitplane) {
+				uint16x8_t bit_value = vdupq_n_u16((u16)(1 << bit));
+				uint16x8_t lo = vtstq_u16(vdupq_n_u16(bitplane[i / 8]), weights);
+				uint16x8_t hi = vtstq_u16(vdupq_n_u16(bitplane[i / 8 + 1]), weights);
+				acc_lo = vorrq_u16(acc_lo, vandq_u16(lo, bit_value));
+				acc_hi = vorrq_u16(acc_hi, vandq_u16(hi, bit_value));
+			}
+		}
+		uint16x8_t rows[2] = {acc_lo, acc_hi};
+		for (i32 r = 0; r < 2; ++r) {
+			uint16x8_t x = rows[r];
+			int16x8_t sign_masks = vshrq_n_s16((int16x8_t)x, 15);
+			uint16x8_t maybe_positive = vbicq_u16(x, (uint16x8_t)sign_masks);
+			uint16x8_t value_if_negative = vsubq_u16(vandq_u16(x, vdupq_n_u16(0x8000)), x);
+			uint16x8_t maybe_negative = vandq_u16((uint16x8_t)sign_masks, value_if_negative);
+			rows[r] = vorrq_u16(maybe_positive, maybe_negative);
+		}
+		i32 area_index = i / 16;
+		i32 area_stride_x = block_width / 4;
+		i32 area_x = (area_index % area_stride_x) * 4;
+		i32 area_y = (area_index / area_stride_x) * 4;
+		u16* dest = (u16*)out + area_y * block_width + area_x;
+		vst1_u16(dest, vget_low_u16(rows[0]));
+		vst1_u16(dest + block_width, vget_high_u16(rows[0]));
+		vst1_u16(dest + 2 * block_width, vget_low_u16(rows[1]));
+		vst1_u16(dest + 3 * block_width, vget_high_u16(rows[1]));
+	}
+#endif
+	// Remaining areas (small blocks only)
+	reassemble_bitplanes_scalar(bitplanes, block_width, i / 16, coeff_count / 16, out);
+}
+
+// For the Y (luminance) channel, the absolute value of the wavelet coefficient is used (Co and Cg are used directly
+// as signed integers). Same as signed magnitude -> two's complement conversion with the sign bit cleared afterwards.
+static inline icoeff_t ycocg_luminance(icoeff_t Y) {
+	return (icoeff_t)(signed_magnitude_to_twos_complement_16((u16)Y) & 0x7FFF);
+}
+
+static rgba_t ycocg_to_rgb(icoeff_t Y, icoeff_t Co, icoeff_t Cg) {
+    icoeff_t tmp = ycocg_luminance(Y) - (Cg >> 1);
+    icoeff_t G = tmp + Cg;
+    icoeff_t B = tmp - (Co >> 1);
+    icoeff_t R = B + Co;
+    return (rgba_t){{{CLAMP(R, 0, 255), CLAMP(G, 0, 255), CLAMP(B, 0, 255), 255}}};
+}
+
+static rgba_t ycocg_to_bgr(icoeff_t Y, icoeff_t Co, icoeff_t Cg) {
+    icoeff_t tmp = ycocg_luminance(Y) - (Cg >> 1);
+    icoeff_t G = tmp + Cg;
+    icoeff_t B = tmp - (Co >> 1);
+    icoeff_t R = B + Co;
+    return (rgba_t){{{CLAMP(B, 0, 255), CLAMP(G, 0, 255), CLAMP(R, 0, 255), 255}}};
+}
+
+// SIMD versions of the above. The *_rgb16 helpers return R, G and B as 16-bit values that still need to be clamped
+// (packus does that); the *_rgb8 helpers return them clamped and packed to bytes, in pixel order.
+
+#if defined(__SSE2__)
+FORCE_INLINE __m128i ycocg_luminance_sse2(__m128i Y) {
+#if defined(__SSSE3__)
+	Y = _mm_abs_epi16(Y);
+#else
+	Y = _mm_max_epi16(Y, _mm_sub_epi16(_mm_setzero_si128(), Y));
+#endif
+	return _mm_and_si128(Y, _mm_set1_epi16(0x7FFF));
+}
+
+// 8 pixels
+FORCE_INLINE void ycocg_to_rgb16_sse2(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m128i* R, __m128i* G, __m128i* B) {
+	__m128i Y_ = ycocg_luminance_sse2(_mm_loadu_si128((__m128i*)Y));
+	__m128i Co_ = _mm_loadu_si128((__m128i*)Co);
+	__m128i Cg_ = _mm_loadu_si128((__m128i*)Cg);
+	__m128i tmp = _mm_sub_epi16(Y_, _mm_srai_epi16(Cg_, 1)); // tmp = Y - Cg/2
+	*G = _mm_add_epi16(tmp, Cg_);                           // G = tmp + Cg
+	*B = _mm_sub_epi16(tmp, _mm_srai_epi16(Co_, 1));         // B = tmp - Co/2
+	*R = _mm_add_epi16(*B, Co_);                            // R = B + Co
+}
+
+// 16 pixels
+FORCE_INLINE void ycocg_to_rgb8_sse2(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m128i* R, __m128i* G, __m128i* B) {
+	__m128i R0, G0, B0, R1, G1, B1;
+	ycocg_to_rgb16_sse2(Y, Co, Cg, &R0, &G0, &B0);
+	ycocg_to_rgb16_sse2(Y + 8, Co + 8, Cg + 8, &R1, &G1, &B1);
+	*R = _mm_packus_epi16(R0, R1);
+	*G = _mm_packus_epi16(G0, G1);
+	*B = _mm_packus_epi16(B0, B1);
+}
+#endif
+
+#if defined(__SSSE3__)
+// Interleave 16 pixels worth of separate R, G and B bytes into 48 bytes of packed RGB.
+FORCE_INLINE void interleave_rgb24_ssse3(__m128i R, __m128i G, __m128i B, __m128i* out) {
+	__m128i r0 = _mm_shuffle_epi8(R, _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5));
+	__m128i g0 = _mm_shuffle_epi8(G, _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1));
+	__m128i b0 = _mm_shuffle_epi8(B, _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1));
+	__m128i r1 = _mm_shuffle_epi8(R, _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1));
+	__m128i g1 = _mm_shuffle_epi8(G, _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10));
+	__m128i b1 = _mm_shuffle_epi8(B, _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1));
+	__m128i r2 = _mm_shuffle_epi8(R, _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1));
+	__m128i g2 = _mm_shuffle_epi8(G, _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1));
+	__m128i b2 = _mm_shuffle_epi8(B, _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15));
+	out[0] = _mm_or_si128(_mm_or_si128(r0, g0), b0);
+	out[1] = _mm_or_si128(_mm_or_si128(r1, g1), b1);
+	out[2] = _mm_or_si128(_mm_or_si128(r2, g2), b2);
+}
+#endif
+
+#if defined(__AVX2__)
+FORCE_INLINE __m256i ycocg_luminance_avx2(__m256i Y) {
+	return _mm256_and_si256(_mm256_abs_epi16(Y), _mm256_set1_epi16(0x7FFF));
+}
+
+// 16 pixels
+FORCE_INLINE void ycocg_to_rgb16_avx2(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m256i* R, __m256i* G, __m256i* B) {
+	__m256i Y_ = ycocg_luminance_avx2(_mm256_loadu_si256((__m256i*)Y));
+	__m256i Co_ = _mm256_loadu_si256((__m256i*)Co);
+	__m256i Cg_ = _mm256_loadu_si256((__m256i*)Cg);
+	__m256i tmp = _mm256_sub_epi16(Y_, _mm256_srai_epi16(Cg_, 1));
+	*G = _mm256_add_epi16(tmp, Cg_);
+	*B = _mm256_sub_epi16(tmp, _mm256_srai_epi16(Co_, 1));
+	*R = _mm256_add_epi16(*B, Co_);
+}
+
+// Pack two vectors of 16-bit values to bytes, keeping the pixel order (packus works within 128-bit lanes).
+FORCE_INLINE __m256i pack_u8_avx2(__m256i a, __m256i b) {
+	return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// 32 pixels
+FORCE_INLINE void ycocg_to_rgb8_avx2(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m256i* R, __m256i* G, __m256i* B) {
+	__m256i R0, G0, B0, R1, G1, B1;
+	ycocg_to_rgb16_avx2(Y, Co, Cg, &R0, &G0, &B0);
+	ycocg_to_rgb16_avx2(Y + 16, Co + 16, Cg + 16, &R1, &G1, &B1);
+	*R = pack_u8_avx2(R0, R1);
+	*G = pack_u8_avx2(G0, G1);
+	*B = pack_u8_avx2(B0, B1);
+}
+#endif
+
+#if defined(__AVX512BW__)
+FORCE_INLINE __m512i ycocg_luminance_avx512(__m512i Y) {
+	return _mm512_and_si512(_mm512_abs_epi16(Y), _mm512_set1_epi16(0x7FFF));
+}
+
+// 32 pixels
+FORCE_INLINE void ycocg_to_rgb16_avx512(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m512i* R, __m512i* G, __m512i* B) {
+	__m512i Y_ = ycocg_luminance_avx512(_mm512_loadu_si512((void*)Y));
+	__m512i Co_ = _mm512_loadu_si512((void*)Co);
+	__m512i Cg_ = _mm512_loadu_si512((void*)Cg);
+	__m512i tmp = _mm512_sub_epi16(Y_, _mm512_srai_epi16(Cg_, 1));
+	*G = _mm512_add_epi16(tmp, Cg_);
+	*B = _mm512_sub_epi16(tmp, _mm512_srai_epi16(Co_, 1));
+	*R = _mm512_add_epi16(*B, Co_);
+}
+
+FORCE_INLINE __m512i pack_u8_avx512(__m512i a, __m512i b) {
+	return _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7), _mm512_packus_epi16(a, b));
+}
+
+// 64 pixels
+FORCE_INLINE void ycocg_to_rgb8_avx512(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, __m512i* R, __m512i* G, __m512i* B) {
+	__m512i R0, G0, B0, R1, G1, B1;
+	ycocg_to_rgb16_avx512(Y, Co, Cg, &R0, &G0, &B0);
+	ycocg_to_rgb16_avx512(Y + 32, Co + 32, Cg + 32, &R1, &G1, &B1);
+	*R = pack_u8_avx512(R0, R1);
+	*G = pack_u8_avx512(G0, G1);
+	*B = pack_u8_avx512(B0, B1);
+}
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+// 8 pixels
+FORCE_INLINE void ycocg_to_rgb8_neon(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, uint8x8_t* R, uint8x8_t* G, uint8x8_t* B) {
+	int16x8_t Y_ = vandq_s16(vabsq_s16(vld1q_s16(Y)), vdupq_n_s16(0x7FFF));
+	int16x8_t Co_ = vld1q_s16(Co);
+	int16x8_t Cg_ = vld1q_s16(Cg);
+	int16x8_t tmp = vsubq_s16(Y_, vshrq_n_s16(Cg_, 1));
+	int16x8_t B_ = vsubq_s16(tmp, vshrq_n_s16(Co_, 1));
+	*R = vqmovun_s16(vaddq_s16(B_, Co_));
+	*G = vqmovun_s16(vaddq_s16(tmp, Cg_));
+	*B = vqmovun_s16(B_);
+}
+#endif
+
+// Convert one pass over the valid region: absolute value of Y, color transform, clamp to 0..255 and interleave.
+// In each SIMD path, the first and third bytes of each pixel are packed together (B and R for BGRA, R and B for RGBA),
+// then interleaved bytewise with G and A, and finally interleaved 16-bit wise into 32-bit pixels.
+FORCE_INLINE void convert_ycocg_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride,
+                                      u32* out, i32 out_stride, bool bgra) {
+	for (i32 y = 0; y < height; ++y) {
+		u32* dest = (u32*)((u8*)out + (size_t)y * out_stride);
+		i32 i = 0;
+#if defined(__AVX512BW__)
+		{
+			__m512i alpha = _mm512_set1_epi16(255);
+			// The interleaving works within 128-bit lanes, this puts the 4-pixel groups back in order.
+			__m512i order_lo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+			__m512i order_hi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+			for (; i + 32 <= width; i += 32) {
+				__m512i R, G, B;
+				ycocg_to_rgb16_avx512(Y + i, Co + i, Cg + i, &R, &G, &B);
+				__m512i first_third = bgra ? _mm512_packus_epi16(B, R) : _mm512_packus_epi16(R, B);
+				__m512i GA = _mm512_packus_epi16(G, alpha);
+				__m512i first_G = _mm512_unpacklo_epi8(first_third, GA);
+				__m512i third_A = _mm512_unpackhi_epi8(first_third, GA);
+				__m512i lo = _mm512_unpacklo_epi16(first_G, third_A);
+				__m512i hi = _mm512_unpackhi_epi16(first_G, third_A);
+				_mm512_storeu_si512((void*)(dest + i), _mm512_permutex2var_epi64(lo, order_lo, hi));
+				_mm512_storeu_si512((void*)(dest + i + 16), _mm512_permutex2var_epi64(lo, order_hi, hi));
+			}
+		}
+#endif
+#if defined(__AVX2__)
+		{
+			__m256i alpha = _mm256_set1_epi16(255);
+			for (; i + 16 <= width; i += 16) {
+				__m256i R, G, B;
+				ycocg_to_rgb16_avx2(Y + i, Co + i, Cg + i, &R, &G, &B);
+				__m256i first_third = bgra ? _mm256_packus_epi16(B, R) : _mm256_packus_epi16(R, B);
+				__m256i GA = _mm256_packus_epi16(G, alpha);
+				__m256i first_G = _mm256_unpacklo_epi8(first_third, GA);
+				__m256i third_A = _mm256_unpackhi_epi8(first_third, GA);
+				__m256i lo = _mm256_unpacklo_epi16(first_G, third_A); // pixels 0-3 | 8-11
+				__m256i hi = _mm256_unpackhi_epi16(first_G, third_A); // pixels 4-7 | 12-15
+				_mm256_storeu_si256((__m256i*)(dest + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+				_mm256_storeu_si256((__m256i*)(dest + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+			}
+		}
+#endif
+#if defined(__SSE2__)
+		{
+			__m128i alpha = _mm_set1_epi16(255);
+			for (; i + 8 <= width; i += 8) {
+				__m128i R, G, B;
+				ycocg_to_rgb16_sse2(Y + i, Co + i, Cg + i, &R, &G, &B);
+				__m128i first_third = bgra ? _mm_packus_epi16(B, R) : _mm_packus_epi16(R, B);
+				__m128i GA = _mm_packus_epi16(G, alpha);
+				__m128i first_G = _mm_unpacklo_epi8(first_third, GA);
+				__m128i third_A = _mm_unpackhi_epi8(first_third, GA);
+				_mm_storeu_si128((__m128i*)(dest + i), _mm_unpacklo_epi16(first_G, third_A));
+				_mm_storeu_si128((__m128i*)(dest + i + 4), _mm_unpackhi_epi16(first_G, third_A));
+			}
+		}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		for (; i + 8 <= width; i += 8) {
+			uint8x8_t R, G, B;
+			ycocg_to_rgb8_neon(Y + i, Co + i, Cg + i, &R, &G, &B);
+			uint8x8x4_t pixels;
+			pixels.val[0] = bgra ? B : R;
+			pixels.val[1] = G;
+			pixels.val[2] = bgra ? R : B;
+			pixels.val[3] = vdup_n_u8(0xFF);
+			vst4_u8((uint8_t*)(dest + i), pixels);
+		}
+#endif
+		// Slow version, for last unaligned elements or in case SIMD isn't available
+		for (; i < width; ++i) {
+			((rgba_t*)dest)[i] = bgra ? ycocg_to_bgr(Y[i], Co[i], Cg[i]) : ycocg_to_rgb(Y[i], Co[i], Cg[i]);
+		}
+
+		Y += stride;
+		Co += stride;
+		Cg += stride;
+	}
+}
+
+static void convert_ycocg_to_bgra_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_bgra, i32 out_stride) {
+	convert_ycocg_block(Y, Co, Cg, width, height, stride, out_bgra, out_stride, true);
+}
+
+static void convert_ycocg_to_rgba_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_rgba, i32 out_stride) {
+	convert_ycocg_block(Y, Co, Cg, width, height, stride, out_rgba, out_stride, false);
+}
+
+// Packed 3-channel output, with either 8 bits per channel (RGB/BGR) or 16 bits per channel (RGB48). 16-bit values
+// are scaled to the full range (v * 257), which is the same as repeating the byte.
+FORCE_INLINE void convert_ycocg_block_packed(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride,
+                                             u8* out, i32 out_stride, bool bgr, bool wide) {
+	for (i32 y = 0; y < height; ++y) {
+		u8* dest = out + (size_t)y * out_stride;
+		i32 i = 0;
+#if defined(__AVX2__)
+		for (; i + 32 <= width; i += 32) {
+			__m256i R, G, B;
+			ycocg_to_rgb8_avx2(Y + i, Co + i, Cg + i, &R, &G, &B);
+			if (bgr) {
+				__m256i tmp = R; R = B; B = tmp;
+			}
+			// Interleave within each 128-bit lane (pixels 0-15 | 16-31), then put the 16-byte parts in order.
+			__m128i lo[3], hi[3];
+			interleave_rgb24_ssse3(_mm256_castsi256_si128(R), _mm256_castsi256_si128(G), _mm256_castsi256_si128(B), lo);
+			interleave_rgb24_ssse3(_mm256_extracti128_si256(R, 1), _mm256_extracti128_si256(G, 1),
+			                       _mm256_extracti128_si256(B, 1), hi);
+			__m128i parts[6] = {lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]};
+			if (wide) {
+				u16* dest16 = (u16*)dest + i * 3;
+				for (i32 k = 0; k < 6; ++k) {
+					__m256i v = _mm256_cvtepu8_epi16(parts[k]);
+					_mm256_storeu_si256((__m256i*)(dest16 + k * 16), _mm256_or_si256(v, _mm256_slli_epi16(v, 8)));
+				}
+			} else {
+				for (i32 k = 0; k < 6; ++k) {
+					_mm_storeu_si128((__m128i*)(dest + i * 3 + k * 16), parts[k]);
+				}
+			}
+		}
+#endif
+#if defined(__SSSE3__)
+		for (; i + 16 <= width; i += 16) {
+			__m128i R, G, B;
+			ycocg_to_rgb8_sse2(Y + i, Co + i, Cg + i, &R, &G, &B);
+			__m128i parts[3];
+			interleave_rgb24_ssse3(bgr ? B : R, G, bgr ? R : B, parts);
+			if (wide) {
+				u16* dest16 = (u16*)dest + i * 3;
+				for (i32 k = 0; k < 3; ++k) {
+					_mm_storeu_si128((__m128i*)(dest16 + k * 16), _mm_unpacklo_epi8(parts[k], parts[k]));
+					_mm_storeu_si128((__m128i*)(dest16 + k * 16 + 8), _mm_unpackhi_epi8(parts[k], parts[k]));
+				}
+			} else {
+				_mm_storeu_si128((__m128i*)(dest + i * 3), parts[0]);
+				_mm_storeu_si128((__m128i*)(dest + i * 3 + 16), parts[1]);
+				_mm_storeu_si128((__m128i*)(dest + i * 3 + 32), parts[2]);
+			}
+		}
+#elif defined(__SSE2__)
+		// Build 32-bit pixels as for RGBA, then store them with overlapping writes: the alpha byte (or word) of each
+		// write is overwritten by the next one. This writes a little past the last pixel, so that one is left to the
+		// scalar loop.
+		for (; i + 8 < width; i += 8) {
+			__m128i R, G, B;
+			ycocg_to_rgb16_sse2(Y + i, Co + i, Cg + i, &R, &G, &B);
+			__m128i first_third = bgr ? _mm_packus_epi16(B, R) : _mm_packus_epi16(R, B);
+			__m128i G0 = _mm_packus_epi16(G, _mm_setzero_si128());
+			__m128i first_G = _mm_unpacklo_epi8(first_third, G0);
+			__m128i third_0 = _mm_unpackhi_epi8(first_third, G0);
+			__m128i pixels[2] = {_mm_unpacklo_epi16(first_G, third_0), _mm_unpackhi_epi16(first_G, third_0)};
+			for (i32 k = 0; k < 2; ++k) {
+				if (wide) {
+					u16* dest16 = (u16*)dest + (i + k * 4) * 3;
+					__m128i lo = _mm_unpacklo_epi8(pixels[k], pixels[k]);
+					__m128i hi = _mm_unpackhi_epi8(pixels[k], pixels[k]);
+					_mm_storel_epi64((__m128i*)(dest16), lo);
+					_mm_storel_epi64((__m128i*)(dest16 + 3), _mm_unpackhi_epi64(lo, lo));
+					_mm_storel_epi64((__m128i*)(dest16 + 6), hi);
+					_mm_storel_epi64((__m128i*)(dest16 + 9), _mm_unpackhi_epi64(hi, hi));
+				} else {
+					// Squeeze two pixels into the low 6 bytes of each 64-bit half.
+					__m128i even = _mm_and_si128(pixels[k], _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF));
+					__m128i odd = _mm_and_si128(pixels[k], _mm_set_epi32(0xFFFFFF, 0, 0xFFFFFF, 0));
+					__m128i packed = _mm_or_si128(even, _mm_srli_epi64(odd, 8));
+					_mm_storel_epi64((__m128i*)(dest + (i + k * 4) * 3), packed);
+					_mm_storel_epi64((__m128i*)(dest + (i + k * 4) * 3 + 6), _mm_unpackhi_epi64(packed, packed));
+				}
+			}
+		}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		for (; i + 8 <= width; i += 8) {
+			uint8x8_t R, G, B;
+			ycocg_to_rgb8_neon(Y + i, Co + i, Cg + i, &R, &G, &B);
+			if (wide) {
+				uint16x8x3_t pixels;
+				pixels.val[0] = vmovl_u8(bgr ? B : R);
+				pixels.val[1] = vmovl_u8(G);
+				pixels.val[2] = vmovl_u8(bgr ? R : B);
+				for (i32 k = 0; k < 3; ++k) {
+					pixels.val[k] = vorrq_u16(pixels.val[k], vshlq_n_u16(pixels.val[k], 8));
+				}
+				vst3q_u16((u16*)dest + i * 3, pixels);
+			} else {
+				uint8x8x3_t pixels;
+				pixels.val[0] = bgr ? B : R;
+				pixels.val[1] = G;
+				pixels.val[2] = bgr ? R : B;
+				vst3_u8(dest + i * 3, pixels);
+			}
+		}
+#endif
+		for (; i < width; ++i) {
+			rgba_t pixel = bgr ? ycocg_to_bgr(Y[i], Co[i], Cg[i]) : ycocg_to_rgb(Y[i], Co[i], Cg[i]);
+			for (i32 c = 0; c < 3; ++c) {
+				if (wide) {
+					((u16*)dest)[i * 3 + c] = pixel.values[c] * 257;
+				} else {
+					dest[i * 3 + c] = pixel.values[c];
+				}
+			}
+		}
+
+		Y += stride;
+		Co += stride;
+		Cg += stride;
+	}
+}
+
+static void convert_ycocg_to_rgb_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u8* out_rgb, i32 out_stride) {
+	convert_ycocg_block_packed(Y, Co, Cg, width, height, stride, out_rgb, out_stride, false, false);
+}
+
+static void convert_ycocg_to_bgr_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u8* out_bgr, i32 out_stride) {
+	convert_ycocg_block_packed(Y, Co, Cg, width, height, stride, out_bgr, out_stride, true, false);
+}
+
+static void convert_ycocg_to_rgb48_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u16* out_rgb48, i32 out_stride) {
+	convert_ycocg_block_packed(Y, Co, Cg, width, height, stride, (u8*)out_rgb48, out_stride, false, true);
+}
+
+// Planar output: a plane of R, followed by a plane of G and a plane of B (each out_stride * height bytes).
+static void convert_ycocg_to_rgb_planar_block(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride,
+                                              u8* out_planes, i32 out_stride) {
+	size_t plane_size = (size_t)out_stride * height;
+	for (i32 y = 0; y < height; ++y) {
+		u8* dest_R = out_planes + (size_t)y * out_stride;
+		u8* dest_G = dest_R + plane_size;
+		u8* dest_B = dest_G + plane_size;
+		i32 i = 0;
+#if defined(__AVX512BW__)
+		for (; i + 64 <= width; i += 64) {
+			__m512i R, G, B;
+			ycocg_to_rgb8_avx512(Y + i, Co + i, Cg + i, &R, &G, &B);
+			_mm512_storeu_si512((void*)(dest_R + i), R);
+			_mm512_storeu_si512((void*)(dest_G + i), G);
+			_mm512_storeu_si512((void*)(dest_B + i), B);
+		}
+#endif
+#if defined(__AVX2__)
+		for (; i + 32 <= width; i += 32) {
+			__m256i R, G, B;
+			ycocg_to_rgb8_avx2(Y + i, Co + i, Cg + i, &R, &G, &B);
+			_mm256_storeu_si256((__m256i*)(dest_R + i), R);
+			_mm256_storeu_si256((__m256i*)(dest_G + i), G);
+			_mm256_storeu_si256((__m256i*)(dest_B + i), B);
+		}
+#endif
+#if defined(__SSE2__)
+		for (; i + 16 <= width; i += 16) {
+			__m128i R, G, B;
+			ycocg_to_rgb8_sse2(Y + i, Co + i, Cg + i, &R, &G, &B);
+			_mm_storeu_si128((__m128i*)(dest_R + i), R);
+			_mm_storeu_si128((__m128i*)(dest_G + i), G);
+			_mm_storeu_si128((__m128i*)(dest_B + i), B);
+		}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		for (; i + 8 <= width; i += 8) {
+			uint8x8_t R, G, B;
+			ycocg_to_rgb8_neon(Y + i, Co + i, Cg + i, &R, &G, &B);
+			vst1_u8(dest_R + i, R);
+			vst1_u8(dest_G + i, G);
+			vst1_u8(dest_B + i, B);
+		}
+#endif
+		for (; i < width; ++i) {
+			rgba_t pixel = ycocg_to_rgb(Y[i], Co[i], Cg[i]);
+			dest_R[i] = pixel.r;
+			dest_G[i] = pixel.g;
+			dest_B[i] = pixel.b;
+		}
+
+		Y += stride;
+		Co += stride;
+		Cg += stride;
+	}
+}
+
+// Grayscale output is the Y (luminance) channel itself, clamped to 0..255. Co and Cg are not needed.
+static void convert_ycocg_to_gray8_block(icoeff_t* Y, i32 width, i32 height, i32 stride, u8* out_gray, i32 out_stride) {
+	for (i32 y = 0; y < height; ++y) {
+		u8* dest = out_gray + (size_t)y * out_stride;
+		i32 i = 0;
+#if defined(__AVX512BW__)
+		for (; i + 64 <= width; i += 64) {
+			__m512i Y0 = ycocg_luminance_avx512(_mm512_loadu_si512((void*)(Y + i)));
+			__m512i Y1 = ycocg_luminance_avx512(_mm512_loadu_si512((void*)(Y + i + 32)));
+			_mm512_storeu_si512((void*)(dest + i), pack_u8_avx512(Y0, Y1));
+		}
+#endif
+#if defined(__AVX2__)
+		for (; i + 32 <= width; i += 32) {
+			__m256i Y0 = ycocg_luminance_avx2(_mm256_loadu_si256((__m256i*)(Y + i)));
+			__m256i Y1 = ycocg_luminance_avx2(_mm256_loadu_si256((__m256i*)(Y + i + 16)));
+			_mm256_storeu_si256((__m256i*)(dest + i), pack_u8_avx2(Y0, Y1));
+		}
+#endif
+#if defined(__SSE2__)
+		for (; i + 16 <= width; i += 16) {
+			__m128i Y0 = ycocg_luminance_sse2(_mm_loadu_si128((__m128i*)(Y + i)));
+			__m128i Y1 = ycocg_luminance_sse2(_mm_loadu_si128((__m128i*)(Y + i + 8)));
+			_mm_storeu_si128((__m128i*)(dest + i), _mm_packus_epi16(Y0, Y1));
+		}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		for (; i + 8 <= width; i += 8) {
+			vst1_u8(dest + i, vqmovun_s16(vandq_s16(vabsq_s16(vld1q_s16(Y + i)), vdupq_n_s16(0x7FFF))));
+		}
+#endif
+		for (; i < width; ++i) {
+			dest[i] = ATMOST(255, ycocg_luminance(Y[i]));
+		}
+
+		Y += stride;
+	}
+}
+
+static void idwt_horizontal_pass(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height) {
+	i32 full_width = quadrant_width * 2;
+	i32 full_height= quadrant_height * 2;
+	i32 idwt_stride = full_width;
+
+	opj_dwt_t h = {0};
+	size_t dwt_mem_size = (MAX(quadrant_width, quadrant_height)*2) * PARALLEL_COLS_53 * sizeof(icoeff_t);
+
+	h.mem = (icoeff_t*)alloca(dwt_mem_size); // TODO: need aligned memory?
+	h.sn = quadrant_width; // number of elements in low pass band
+	h.dn = quadrant_width; // number of elements in high pass band
+	h.cas = 1;
+
+	for (i32 y = 0; y < full_height; ++y) {
+		icoeff_t* input_row = idwt + y * idwt_stride;
+		opj_idwt53_h(&h, input_row);
+	}
+}
+
+static void idwt_vertical_pass(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height) {
+	i32 full_width = quadrant_width * 2;
+	i32 idwt_stride = full_width;
+
+	opj_dwt_t v = {0};
+	size_t dwt_mem_size = (MAX(quadrant_width, quadrant_height)*2) * PARALLEL_COLS_53 * sizeof(icoeff_t);
+
+	v.mem = (icoeff_t*)alloca(dwt_mem_size);
+	v.sn = quadrant_height; // number of elements in low pass band
+	v.dn = quadrant_height; // number of elements in high pass band
+	v.cas = 1;
+
+	i32 x;
+	i32 last_x = full_width;
+	for (x = 0; x + PARALLEL_COLS_53 <= last_x; x += PARALLEL_COLS_53) {
+		opj_idwt53_v(&v, idwt + x, idwt_stride, PARALLEL_COLS_53);
+	}
+	if (x < last_x) {
+		opj_idwt53_v(&v, idwt + x, idwt_stride, (last_x - x));
+	}
+}
+
+static void idwt_line_based(icoeff_t* idwt, icoeff_t* dest, i32 quadrant_width, i32 quadrant_height) {
+	opj_dwt_t h = {0};
+	h.mem = (icoeff_t*)alloca(quadrant_width * 2 * sizeof(icoeff_t));
+	h.sn = quadrant_width; // number of elements in low pass band
+	h.dn = quadrant_width; // number of elements in high pass band
+	h.cas = 1;
+	opj_idwt53_2d_cas1_lines(&h, idwt, dest, quadrant_height, quadrant_width * 2);
+}
+
+// Resampling (used by libisyntax_read_region_scaled()). Each output sample is the weighted sum of tap_count input
+// samples, with weights in RESAMPLE_WEIGHT_BITS fixed point. The horizontal pass produces 8-bit values with
+// RESAMPLE_INTERMEDIATE_BITS extra bits of precision, the vertical pass rounds them back to 8 bits.
+
+static inline u32 load_u32_unaligned(const u8* src) {
+	u32 result;
+	memcpy(&result, src, sizeof(result));
+	return result;
+}
+
+// Output pixel x is computed from the source pixels starting at starts[x], with weights[x * tap_count ...].
+// For 3 and 4 channels, 4 bytes are read per source pixel, so the source row must be readable 1 byte past its end.
+// For 3 channels, one extra value is also written at the end of the destination row.
+// For 1 channel, the SIMD versions need an even tap_count; they compute several output pixels at once, from pairs of
+// source pixels. With AVX2, each pair is read as 4 bytes, so the source row must be readable 2 bytes past its end.
+static void resample_horizontal_row(const u8* src, i16* dest, i32 dest_width, i32 channels, const i32* starts,
+                                    const i16* weights, i32 tap_count) {
+	const i32 shift = RESAMPLE_WEIGHT_BITS - RESAMPLE_INTERMEDIATE_BITS;
+	i32 x = 0;
+#if defined(__SSE2__)
+	if (channels == 3 || channels == 4) {
+		__m128i zero = _mm_setzero_si128();
+		for (i32 x = 0; x < dest_width; ++x) {
+			const u8* s = src + starts[x] * channels;
+			const i16* w = weights + x * tap_count;
+			__m128i acc = _mm_set1_epi32(1 << (shift - 1));
+			i32 k = 0;
+			for (; k + 2 <= tap_count; k += 2) {
+				__m128i p0 = _mm_cvtsi32_si128((i32)load_u32_unaligned(s + k * channels));
+				__m128i p1 = _mm_cvtsi32_si128((i32)load_u32_unaligned(s + (k + 1) * channels));
+				// Channel values of both pixels side by side, so that madd multiplies each with its own weight.
+				__m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero);
+				__m128i w01 = _mm_set1_epi32((i32)((u16)w[k] | ((u32)(u16)w[k + 1] << 16)));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(p, w01));
+			}
+			if (k < tap_count) {
+				__m128i p = _mm_unpacklo_epi8(_mm_cvtsi32_si128((i32)load_u32_unaligned(s + k * channels)), zero);
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(p, zero), _mm_set1_epi32((u16)w[k])));
+			}
+			acc = _mm_srai_epi32(acc, shift);
+			_mm_storel_epi64((__m128i*)(dest + x * channels), _mm_packs_epi32(acc, acc));
+		}
+		return;
+	}
+	if (channels == 1 && (tap_count & 1) == 0) {
+		// The two source pixels of a pair side by side, so that madd multiplies each with its own weight and adds them.
+#if defined(__AVX2__)
+		__m256i byte_mask = _mm256_set1_epi32(0xFF);
+		__m256i weight_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(tap_count));
+		for (; x + 8 <= dest_width; x += 8) {
+			__m256i source_index = _mm256_loadu_si256((__m256i*)(starts + x));
+			__m256i weight_index = _mm256_add_epi32(weight_offsets, _mm256_set1_epi32(x * tap_count));
+			__m256i acc = _mm256_set1_epi32(1 << (shift - 1));
+			for (i32 k = 0; k < tap_count; k += 2) {
+				__m256i p = _mm256_i32gather_epi32((const int*)(src + k), source_index, 1);
+				p = _mm256_or_si256(_mm256_and_si256(p, byte_mask),
+				                    _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 8), byte_mask), 16));
+				__m256i w01 = _mm256_i32gather_epi32((const int*)(weights + k), weight_index, 2);
+				acc = _mm256_add_epi32(acc, _mm256_madd_epi16(p, w01));
+			}
+			acc = _mm256_srai_epi32(acc, shift);
+			// packs works within 128-bit lanes: the values end up in 64-bit elements 0 and 2.
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(acc, acc), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i*)(dest + x), _mm256_castsi256_si128(packed));
+		}
+#endif
+		for (; x + 4 <= dest_width; x += 4) {
+			const u8* s0 = src + starts[x];
+			const u8* s1 = src + starts[x + 1];
+			const u8* s2 = src + starts[x + 2];
+			const u8* s3 = src + starts[x + 3];
+			const i16* w0 = weights + x * tap_count;
+			const i16* w1 = w0 + tap_count;
+			const i16* w2 = w1 + tap_count;
+			const i16* w3 = w2 + tap_count;
+			__m128i acc = _mm_set1_epi32(1 << (shift - 1));
+			for (i32 k = 0; k < tap_count; k += 2) {
+				__m128i p = _mm_setr_epi16(s0[k], s0[k + 1], s1[k], s1[k + 1], s2[k], s2[k + 1], s3[k], s3[k + 1]);
+				__m128i w01 = _mm_setr_epi32((i32)load_u32_unaligned((const u8*)(w0 + k)),
+				                             (i32)load_u32_unaligned((const u8*)(w1 + k)),
+				                             (i32)load_u32_unaligned((const u8*)(w2 + k)),
+				                             (i32)load_u32_unaligned((const u8*)(w3 + k)));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(p, w01));
+			}
+			acc = _mm_srai_epi32(acc, shift);
+			_mm_storel_epi64((__m128i*)(dest + x), _mm_packs_epi32(acc, acc));
+		}
+	}
+#endif
+	for (; x < dest_width; ++x) {
+		const u8* s = src + starts[x] * channels;
+		const i16* w = weights + x * tap_count;
+		for (i32 c = 0; c < channels; ++c) {
+			i32 sum = 1 << (shift - 1);
+			for (i32 k = 0; k < tap_count; ++k) {
+				sum += s[k * channels + c] * w[k];
+			}
+			dest[x * channels + c] = (i16)(sum >> shift);
+		}
+	}
+}
+
+// dest[i] is the weighted sum of src[k * src_stride + i] over the tap_count rows, clamped to 0..255.
+static void resample_vertical_row(const i16* src, i32 src_stride, const i16* weights, i32 tap_count, i32 count, u8* dest) {
+	const i32 shift = RESAMPLE_WEIGHT_BITS + RESAMPLE_INTERMEDIATE_BITS;
+	i32 i = 0;
+#if defined(__AVX512BW__)
+	for (; i + 32 <= count; i += 32) {
+		__m512i acc_lo = _mm512_set1_epi32(1 << (shift - 1));
+		__m512i acc_hi = acc_lo;
+		for (i32 k = 0; k < tap_count; k += 2) {
+			__m512i a = _mm512_loadu_si512((void*)(src + k * src_stride + i));
+			__m512i b = _mm512_setzero_si512();
+			i32 w1 = 0;
+			if (k + 1 < tap_count) {
+				b = _mm512_loadu_si512((void*)(src + (k + 1) * src_stride + i));
+				w1 = weights[k + 1];
+			}
+			__m512i w01 = _mm512_set1_epi32((i32)((u16)weights[k] | ((u32)(u16)w1 << 16)));
+			acc_lo = _mm512_add_epi32(acc_lo, _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), w01));
+			acc_hi = _mm512_add_epi32(acc_hi, _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), w01));
+		}
+		// unpack and packs both work within 128-bit lanes, so the values end up in their original order.
+		__m512i v = _mm512_packs_epi32(_mm512_srai_epi32(acc_lo, shift), _mm512_srai_epi32(acc_hi, shift));
+		v = _mm512_max_epi16(v, _mm512_setzero_si512());
+		_mm256_storeu_si256((__m256i*)(dest + i), _mm512_cvtusepi16_epi8(v));
+	}
+#endif
+#if defined(__AVX2__)
+	for (; i + 16 <= count; i += 16) {
+		__m256i acc_lo = _mm256_set1_epi32(1 << (shift - 1));
+		__m256i acc_hi = acc_lo;
+		for (i32 k = 0; k < tap_count; k += 2) {
+			__m256i a = _mm256_loadu_si256((__m256i*)(src + k * src_stride + i));
+			__m256i b = _mm256_setzero_si256();
+			i32 w1 = 0;
+			if (k + 1 < tap_count) {
+				b = _mm256_loadu_si256((__m256i*)(src + (k + 1) * src_stride + i));
+				w1 = weights[k + 1];
+			}
+			__m256i w01 = _mm256_set1_epi32((i32)((u16)weights[k] | ((u32)(u16)w1 << 16)));
+			acc_lo = _mm256_add_epi32(acc_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w01));
+			acc_hi = _mm256_add_epi32(acc_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w01));
+		}
+		__m256i v = _mm256_packs_epi32(_mm256_srai_epi32(acc_lo, shift), _mm256_srai_epi32(acc_hi, shift));
+		__m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		_mm_storeu_si128((__m128i*)(dest + i), packed);
+	}
+#endif
+#if defined(__SSE2__)
+	for (; i + 8 <= count; i += 8) {
+		__m128i acc_lo = _mm_set1_epi32(1 << (shift - 1));
+		__m128i acc_hi = acc_lo;
+		for (i32 k = 0; k < tap_count; k += 2) {
+			__m128i a = _mm_loadu_si128((__m128i*)(src + k * src_stride + i));
+			__m128i b = _mm_setzero_si128();
+			i32 w1 = 0;
+			if (k + 1 < tap_count) {
+				b = _mm_loadu_si128((__m128i*)(src + (k + 1) * src_stride + i));
+				w1 = weights[k + 1];
+			}
+			__m128i w01 = _mm_set1_epi32((i32)((u16)weights[k] | ((u32)(u16)w1 << 16)));
+			acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w01));
+			acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w01));
+		}
+		__m128i v = _mm_packs_epi32(_mm_srai_epi32(acc_lo, shift), _mm_srai_epi32(acc_hi, shift));
+		_mm_storel_epi64((__m128i*)(dest + i), _mm_packus_epi16(v, v));
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	for (; i + 8 <= count; i += 8) {
+		int32x4_t acc_lo = vdupq_n_s32(1 << (shift - 1));
+		int32x4_t acc_hi = acc_lo;
+		for (i32 k = 0; k < tap_count; ++k) {
+			int16x8_t a = vld1q_s16(src + k * src_stride + i);
+			acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(a), weights[k]);
+			acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(a), weights[k]);
+		}
+		int32x4_t lo = vshrq_n_s32(acc_lo, RESAMPLE_WEIGHT_BITS + RESAMPLE_INTERMEDIATE_BITS);
+		int32x4_t hi = vshrq_n_s32(acc_hi, RESAMPLE_WEIGHT_BITS + RESAMPLE_INTERMEDIATE_BITS);
+		int16x8_t v = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+		vst1_u8(dest + i, vqmovun_s16(v));
+	}
+#endif
+	for (; i < count; ++i) {
+		i32 sum = 1 << (shift - 1);
+		for (i32 k = 0; k < tap_count; ++k) {
+			sum += src[k * src_stride + i] * weights[k];
+		}
+		dest[i] = (u8)CLAMP(sum >> shift, 0, 255);
+	}
+}
+
+// Conversion of 8-bit values to normalized floats (used by libisyntax_read_patches()): dest[i] = src[i] * scale[c] +
+// bias[c], with c = i % channels (1 or 3, interleaved). The values can be converted in place, with src in the last
+// quarter of the memory of dest: each value is read before the memory it occupies is written.
+static void normalize_u8_to_f32(const u8* src, float* dest, size_t count, i32 channels, const float* scale,
+                                const float* bias) {
+	// The factors per value for a block of 24 values, which is a whole number of pixels and of SIMD vectors.
+	float block_scale[24];
+	float block_bias[24];
+	for (i32 k = 0; k < 24; ++k) {
+		block_scale[k] = scale[k % channels];
+		block_bias[k] = bias[k % channels];
+	}
+	size_t i = 0;
+#if defined(__AVX2__)
+	for (; i + 24 <= count; i += 24) {
+		for (i32 k = 0; k < 24; k += 8) {
+			__m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(src + i + k))));
+			v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_loadu_ps(block_scale + k)), _mm256_loadu_ps(block_bias + k));
+			_mm256_storeu_ps(dest + i + k, v);
+		}
+	}
+#endif
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 24 <= count; i += 24) {
+		for (i32 k = 0; k < 24; k += 4) {
+			__m128i p = _mm_cvtsi32_si128((i32)load_u32_unaligned(src + i + k));
+			__m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero));
+			v = _mm_add_ps(_mm_mul_ps(v, _mm_loadu_ps(block_scale + k)), _mm_loadu_ps(block_bias + k));
+			_mm_storeu_ps(dest + i + k, v);
+		}
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	for (; i + 24 <= count; i += 24) {
+		for (i32 k = 0; k < 24; k += 8) {
+			uint16x8_t p = vmovl_u8(vld1_u8(src + i + k));
+			float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(p)));
+			float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(p)));
+			vst1q_f32(dest + i + k, vaddq_f32(vmulq_f32(lo, vld1q_f32(block_scale + k)), vld1q_f32(block_bias + k)));
+			vst1q_f32(dest + i + k + 4, vaddq_f32(vmulq_f32(hi, vld1q_f32(block_scale + k + 4)),
+			                                      vld1q_f32(block_bias + k + 4)));
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		dest[i] = src[i] * scale[i % channels] + bias[i % channels];
+	}
+}
+
+const isyntax_kernels_t ISYNTAX_KERNELS_TABLE = {
+	.simd_level = ISYNTAX_KERNELS_SIMD_LEVEL,
+	.reassemble_bitplanes = reassemble_bitplanes,
+	.convert_ycocg_to_bgra_block = convert_ycocg_to_bgra_block,
+	.convert_ycocg_to_rgba_block = convert_ycocg_to_rgba_block,
+	.convert_ycocg_to_rgb_block = convert_ycocg_to_rgb_block,
+	.convert_ycocg_to_bgr_block = convert_ycocg_to_bgr_block,
+	.convert_ycocg_to_rgb48_block = convert_ycocg_to_rgb48_block,
+	.convert_ycocg_to_rgb_planar_block = convert_ycocg_to_rgb_planar_block,
+	.convert_ycocg_to_gray8_block = convert_ycocg_to_gray8_block,
+	.idwt_horizontal_pass = idwt_horizontal_pass,
+	.idwt_vertical_pass = idwt_vertical_pass,
+	.idwt_line_based = idwt_line_based,
+	.resample_horizontal_row = resample_horizontal_row,
+	.resample_vertical_row = resample_vertical_row,
+	.normalize_u8_to_f32 = normalize_u8_to_f32,
+};
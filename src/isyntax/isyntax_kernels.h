@@ -0,0 +1,86 @@
+/*
+  BSD 2-Clause License
+
+  Copyright (c) 2019-2026, Pieter Valkema
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  1. Redistributions of source code must retain the above copyright notice, this
+     list of conditions and the following disclaimer.
+
+  2. Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+  FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+  DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "common.h"
+#include "isyntax.h"
+
+// The SIMD kernels (isyntax_kernels.c) are compiled once per instruction set level, each copy exporting one table of
+// function pointers. isyntax_select_simd_level() picks the table that is used at runtime.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ISYNTAX_KERNELS_X86 1
+#else
+#define ISYNTAX_KERNELS_X86 0
+#endif
+
+typedef struct isyntax_kernels_t {
+	i32 simd_level; // LIBISYNTAX_SIMD_LEVEL_*
+	void (*reassemble_bitplanes)(u8** bitplanes, i32 block_width, i32 block_height, i16* out);
+	// stride is the row stride of the coefficients (in elements), out_stride that of the output (in bytes).
+	void (*convert_ycocg_to_bgra_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_bgra, i32 out_stride);
+	void (*convert_ycocg_to_rgba_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u32* out_rgba, i32 out_stride);
+	void (*convert_ycocg_to_rgb_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u8* out_rgb, i32 out_stride);
+	void (*convert_ycocg_to_bgr_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u8* out_bgr, i32 out_stride);
+	void (*convert_ycocg_to_rgb48_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u16* out_rgb48, i32 out_stride);
+	void (*convert_ycocg_to_rgb_planar_block)(icoeff_t* Y, icoeff_t* Co, icoeff_t* Cg, i32 width, i32 height, i32 stride, u8* out_planes, i32 out_stride);
+	void (*convert_ycocg_to_gray8_block)(icoeff_t* Y, i32 width, i32 height, i32 stride, u8* out_gray, i32 out_stride);
+	void (*idwt_horizontal_pass)(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height);
+	void (*idwt_vertical_pass)(icoeff_t* idwt, i32 quadrant_width, i32 quadrant_height);
+	void (*idwt_line_based)(icoeff_t* idwt, icoeff_t* dest, i32 quadrant_width, i32 quadrant_height);
+	void (*resample_horizontal_row)(const u8* src, i16* dest, i32 dest_width, i32 channels, const i32* starts, const i16* weights, i32 tap_count);
+	void (*resample_vertical_row)(const i16* src, i32 src_stride, const i16* weights, i32 tap_count, i32 count, u8* dest);
+	void (*normalize_u8_to_f32)(const u8* src, float* dest, size_t count, i32 channels, const float* scale, const float* bias);
+} isyntax_kernels_t;
+
+// Fixed point precision of the resampling weights and of the values between the horizontal and vertical passes.
+#define RESAMPLE_WEIGHT_BITS 14
+#define RESAMPLE_INTERMEDIATE_BITS 6
+
+// Baseline for the target architecture: SSE2 on x86-64, NEON on arm64, otherwise plain C.
+extern const isyntax_kernels_t isyntax_kernels_baseline;
+#if ISYNTAX_KERNELS_X86
+extern const isyntax_kernels_t isyntax_kernels_ssse3;
+extern const isyntax_kernels_t isyntax_kernels_avx2;
+extern const isyntax_kernels_t isyntax_kernels_avx512;
+#endif
+
+// The kernels currently in use.
+extern const isyntax_kernels_t* isyntax_kernels;
+
+i32 isyntax_get_cpu_simd_level(void);
+bool isyntax_select_simd_level(i32 simd_level);
+
+// Convert between signed magnitude and two's complement
+// https://stackoverflow.com/questions/21837008/how-to-convert-from-sign-magnitude-to-twos-complement
+// N.B. This function is its own inverse (conversion works the other way as well)
+static inline i16 signed_magnitude_to_twos_complement_16(u16 x) {
+	u16 m = -(x >> 15);
+	i16 result = (~m & x) | (((x & (u16)0x8000) - x) & m);
+	return result;
+}
@@ -27,6 +27,7 @@
 
 #include "common.h"
 #include "isyntax_reader.h"
+#include "intrinsics.h"
 
 #define LOG(msg, ...) console_print(msg, ##__VA_ARGS__)
 #define LOG_VAR(fmt, var) console_print("%s: %s=" fmt "\n", __FUNCTION__, #var, var)
@@ -98,24 +99,40 @@ static void tile_list_insert_list_first(isyntax_tile_list_t* target_list, isynta
 #define ITERATE_TILE_LIST(_iter, _list) \
     isyntax_tile_t* _iter = _list.head; _iter; _iter = _iter->cache_next
 
+// Approximate (bitplane-truncated) coefficients may only be reused at the same reduced quality, never for full quality.
+static inline bool isyntax_cache_can_use_coefficients(isyntax_cache_t* cache, u8 bitplane_limit) {
+    return bitplane_limit == 0 || bitplane_limit == cache->h_bitplane_limit;
+}
+
+// Coefficients loaded for a grayscale read only cover the Y channel, see isyntax_pixel_format_color_count().
+static inline bool isyntax_has_color_channels(bool is_y_only, int color_count) {
+    return !is_y_only || color_count == 1;
+}
 
+
+// Loads the codeblocks for the color channels first_color up to color_count.
 static void isyntax_openslide_load_tile_coefficients_ll_or_h(isyntax_cache_t* cache,
                                                              isyntax_t* isyntax, isyntax_tile_t* tile,
-                                                             int codeblock_index, bool is_ll) {
+                                                             int codeblock_index, bool is_ll,
+                                                             int first_color, int color_count) {
     isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
     isyntax_data_chunk_t* chunk = &wsi->data_chunks[tile->data_chunk_index];
 
-    for (int color = 0; color < 3; ++color) {
+    // Only codeblocks that were actually truncated make the H coefficients approximate (v1 codeblocks never are).
+    bool is_truncated = !is_ll && first_color > 0 && tile->h_bitplane_limit != 0;
+    for (int color = first_color; color < color_count; ++color) {
         isyntax_codeblock_t* codeblock = &wsi->codeblocks[codeblock_index + color * chunk->codeblock_count_per_color];
         ASSERT(codeblock->coefficient == (is_ll ? 0 : 1)); // LL coefficient codeblock for this tile.
         // TODO(avirodov): int vs i32 vs u32 consistently.
         ASSERT(codeblock->color_component == (u32)color);
         ASSERT(codeblock->scale == (u32)tile->tile_scale);
         if (is_ll) {
-            tile->color_channels[color].coeff_ll = (icoeff_t *) block_alloc(cache->ll_coeff_block_allocator);
-        } else {
+            if (!tile->color_channels[color].coeff_ll) {
+                tile->color_channels[color].coeff_ll = (icoeff_t *) block_alloc(cache->ll_coeff_block_allocator);
+            }
+        } else if (!tile->color_channels[color].coeff_h) {
             tile->color_channels[color].coeff_h = (icoeff_t *) block_alloc(cache->h_coeff_block_allocator);
-        }
+        } // else: decoding again at a different quality, the H coefficients can be overwritten in place.
         // TODO(avirodov): fancy allocators, for multiple sequential blocks (aka chunk). Or let OS do the caching.
         // Adding 7 safety bytes so bitstream_lsb_read() won't access out of bounds in isyntax_hulsken_decompress().
         u8* codeblock_data = malloc(codeblock->block_size + 7);
@@ -126,21 +143,32 @@ static void isyntax_openslide_load_tile_coefficients_ll_or_h(isyntax_cache_t* ca
                                 codeblock->block_data_offset, codeblock->block_size);
         }
 
-        isyntax_hulsken_decompress(codeblock_data, codeblock->block_size,
-                                   isyntax->block_width, isyntax->block_height,
-                                   codeblock->coefficient, wsi->compressor_version,
-                                   is_ll ? tile->color_channels[color].coeff_ll : tile->color_channels[color].coeff_h);
+        isyntax_codeblock_stats_t stats;
+        isyntax_hulsken_decompress_truncated(codeblock_data, codeblock->block_size,
+                                             isyntax->block_width, isyntax->block_height,
+                                             codeblock->coefficient, wsi->compressor_version,
+                                             is_ll ? 0 : cache->h_bitplane_limit,
+                                             is_ll ? tile->color_channels[color].coeff_ll : tile->color_channels[color].coeff_h,
+                                             &stats);
+        is_truncated |= stats.is_truncated;
         free(codeblock_data);
     }
 
     if (is_ll) {
         tile->has_ll = true;
+        tile->ll_bitplane_limit = 0;
+        tile->ll_is_y_only = (color_count == 1);
     } else {
         tile->has_h = true;
+        tile->h_bitplane_limit = is_truncated ? (u8)cache->h_bitplane_limit : 0;
+        tile->h_is_y_only = (color_count == 1);
     }
 }
 
-static void isyntax_openslide_load_tile_coefficients(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile) {
+// If color_count is 1, only the codeblocks of the Y channel are read and decoded. If the tile only has the Y channel
+// and all channels are needed, only the Co and Cg channels are added.
+static void isyntax_openslide_load_tile_coefficients(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile,
+                                                     int color_count) {
     isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
 
     if (!tile->exists) {
@@ -149,12 +177,17 @@ static void isyntax_openslide_load_tile_coefficients(isyntax_cache_t* cache, isy
 
     // Load LL codeblocks here only for top-level tiles. For other levels, the LL coefficients are computed from parent
     // tiles later on.
-    if (!tile->has_ll && tile->tile_scale == wsi->max_scale) {
+    if (tile->tile_scale == wsi->max_scale &&
+        !(tile->has_ll && isyntax_has_color_channels(tile->ll_is_y_only, color_count))) {
+        int first_color = tile->has_ll ? 1 : 0;
         isyntax_openslide_load_tile_coefficients_ll_or_h(
-                cache, isyntax, tile, /*codeblock_index=*/tile->codeblock_index, /*is_ll=*/true);
+                cache, isyntax, tile, /*codeblock_index=*/tile->codeblock_index, /*is_ll=*/true,
+                first_color, color_count);
     }
 
-    if (!tile->has_h) {
+    bool h_is_usable = tile->has_h && isyntax_cache_can_use_coefficients(cache, tile->h_bitplane_limit);
+    if (!(h_is_usable && isyntax_has_color_channels(tile->h_is_y_only, color_count))) {
+        int first_color = h_is_usable ? 1 : 0;
         ASSERT(tile->exists);
         isyntax_data_chunk_t* chunk = wsi->data_chunks + tile->data_chunk_index;
 
@@ -173,7 +206,8 @@ static void isyntax_openslide_load_tile_coefficients(isyntax_cache_t* cache, isy
 
         isyntax_openslide_load_tile_coefficients_ll_or_h(
                 cache, isyntax, tile,
-                /*codeblock_index=*/tile->codeblock_chunk_index + codeblock_index_in_chunk, /*is_ll=*/false);
+                /*codeblock_index=*/tile->codeblock_chunk_index + codeblock_index_in_chunk, /*is_ll=*/false,
+                first_color, color_count);
     }
 }
 
@@ -199,44 +233,102 @@ static isyntax_tile_children_t isyntax_openslide_compute_children(isyntax_t* isy
     return result;
 }
 
+// Selects the children that should get their ll coefficients written by the idwt of a tile: those that don't have
+// usable ll coefficients yet and that are reserved by the current read. Unless the cache policy keeps all ll
+// coefficients, these are only the children that the read depends on (see isyntax_make_tile_lists_by_scale()).
+static u32 isyntax_openslide_get_children_ll_mask(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile,
+                                                 u32 read_id, int color_count) {
+    isyntax_tile_children_t children = isyntax_openslide_compute_children(isyntax, tile);
+    u32 child_ll_mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        isyntax_tile_t* child = children.as_array[i];
+        if (child->has_ll && isyntax_cache_can_use_coefficients(cache, child->ll_bitplane_limit) &&
+            isyntax_has_color_channels(child->ll_is_y_only, color_count)) {
+            continue;
+        }
+        // Children reserved by another read are left alone, that read may be using them.
+        if (child->cache_marked != read_id) {
+            continue;
+        }
+        child_ll_mask |= (1u << i);
+    }
+    return child_ll_mask;
+}
+
+// The idwt of a tile writes the ll coefficients of its children, using the coefficients of the tile and its neighbors.
+// If any of these were approximate, so are the children's ll coefficients.
+static void isyntax_openslide_update_children_ll_bitplane_limit(isyntax_t* isyntax, isyntax_tile_t* tile, u32 child_ll_mask) {
+    isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
+    isyntax_level_t* level = &wsi->levels[tile->tile_scale];
+    u8 bitplane_limit = 0;
+    for (int y_offset = -1; y_offset <= 1; ++y_offset) {
+        for (int x_offset = -1; x_offset <= 1; ++x_offset) {
+            int neighbor_tile_x = tile->tile_x + x_offset;
+            int neighbor_tile_y = tile->tile_y + y_offset;
+            if (neighbor_tile_x < 0 || neighbor_tile_x >= level->width_in_tiles ||
+                neighbor_tile_y < 0 || neighbor_tile_y >= level->height_in_tiles) {
+                continue;
+            }
+            isyntax_tile_t* neighbor_tile = &level->tiles[level->width_in_tiles * neighbor_tile_y + neighbor_tile_x];
+            if (neighbor_tile->exists) {
+                bitplane_limit = MAX(bitplane_limit, MAX(neighbor_tile->ll_bitplane_limit, neighbor_tile->h_bitplane_limit));
+            }
+        }
+    }
+    isyntax_tile_children_t children = isyntax_openslide_compute_children(isyntax, tile);
+    for (int i = 0; i < 4; ++i) {
+        if (child_ll_mask & (1u << i)) {
+            children.as_array[i]->ll_bitplane_limit = bitplane_limit;
+        }
+    }
+}
 
-static void isyntax_openslide_idwt(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile,
-                                   uint32_t* pixels_buffer, enum isyntax_pixel_format_t pixel_format) {
+// If pixels_buffer is not NULL, the part of the tile starting at (x, y) of size width x height is written to it.
+static void isyntax_openslide_idwt(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile, u32 read_id,
+                                   int color_count, void* pixels_buffer, int stride, int x, int y, int width, int height,
+                                   enum isyntax_pixel_format_t pixel_format) {
     if (tile->tile_scale == 0) {
         ASSERT(pixels_buffer != NULL); // Shouldn't be asking for idwt at level 0 if we're not going to use the result for pixels.
-        isyntax_load_tile(isyntax, &isyntax->images[isyntax->wsi_image_index],
-                                 tile->tile_scale, tile->tile_x, tile->tile_y,
-                                 cache->ll_coeff_block_allocator,
-                                 pixels_buffer, pixel_format);
+        isyntax_load_tile_with_children(isyntax, &isyntax->images[isyntax->wsi_image_index],
+                                        tile->tile_scale, tile->tile_x, tile->tile_y,
+                                        cache->ll_coeff_block_allocator, ISYNTAX_ALL_CHILDREN, color_count,
+                                        pixels_buffer, stride, x, y, width, height, pixel_format);
         return;
     }
 
-    if (pixels_buffer != NULL) {
-        // TODO(avirodov): if we want rgb from tile where idwt was done already, this could be cheaper if we store
-        //  the lls in the tile. Currently need to recompute idwt.
-        isyntax_load_tile(isyntax, &isyntax->images[isyntax->wsi_image_index],
-                          tile->tile_scale, tile->tile_x, tile->tile_y,
-                          cache->ll_coeff_block_allocator,
-                          pixels_buffer, pixel_format);
+    // If all (wanted) children have usable ll coefficients and we don't need the rgb pixels, no need to do the idwt.
+    // TODO(avirodov): if we want rgb from tile where idwt was done already, this could be cheaper if we store
+    //  the lls in the tile. Currently need to recompute idwt.
+    u32 child_ll_mask = isyntax_openslide_get_children_ll_mask(cache, isyntax, tile, read_id, color_count);
+    if (pixels_buffer == NULL && child_ll_mask == 0) {
         return;
     }
 
-    // If all children have ll coefficients and we don't need the rgb pixels, no need to do the idwt.
-    ASSERT(pixels_buffer == NULL && tile->tile_scale > 0);
-    isyntax_tile_children_t children = isyntax_openslide_compute_children(isyntax, tile);
-    if (children.child_top_left->has_ll && children.child_top_right->has_ll &&
-        children.child_bottom_left->has_ll && children.child_bottom_right->has_ll) {
+    isyntax_load_tile_with_children(isyntax, &isyntax->images[isyntax->wsi_image_index],
+                                    tile->tile_scale, tile->tile_x, tile->tile_y,
+                                    cache->ll_coeff_block_allocator, child_ll_mask, color_count,
+                                    pixels_buffer, stride, x, y, width, height, pixel_format);
+    isyntax_openslide_update_children_ll_bitplane_limit(isyntax, tile, child_ll_mask);
+}
+
+// Reserves a tile for a read, moving it from the cache to one of the lists of the read. If the tile is already reserved
+// by another read, is_blocked is set instead.
+static void isyntax_tile_reserve(isyntax_tile_t* tile, u32 read_id, isyntax_tile_list_t* list,
+                                 isyntax_tile_list_t* cache_list, bool* is_blocked) {
+    if (tile->cache_marked) {
+        if (tile->cache_marked != read_id) {
+            *is_blocked = true;
+        }
         return;
     }
-
-    isyntax_load_tile(isyntax, &isyntax->images[isyntax->wsi_image_index],
-                      tile->tile_scale, tile->tile_x, tile->tile_y,
-                      cache->ll_coeff_block_allocator,
-                      /*pixels_buffer=*/NULL, /*pixel_format=*/0);
+    tile_list_remove(cache_list, tile);
+    tile->cache_marked = read_id;
+    tile_list_insert_first(list, tile);
 }
 
-static void isyntax_make_tile_lists_add_parent_to_list(isyntax_t* isyntax, isyntax_tile_t* tile,
-                                                       isyntax_tile_list_t* idwt_list, isyntax_tile_list_t* cache_list) {
+static void isyntax_make_tile_lists_add_parent_to_list(isyntax_t* isyntax, isyntax_tile_t* tile, u32 read_id,
+                                                       isyntax_tile_list_t* idwt_list, isyntax_tile_list_t* cache_list,
+                                                       bool* is_blocked) {
     isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
     int parent_tile_scale = tile->tile_scale + 1;
     if (parent_tile_scale > wsi->max_scale) {
@@ -247,31 +339,33 @@ static void isyntax_make_tile_lists_add_parent_to_list(isyntax_t* isyntax, isynt
     int parent_tile_y = tile->tile_y / 2;
     isyntax_level_t* parent_level = &wsi->levels[parent_tile_scale];
     isyntax_tile_t* parent_tile = &parent_level->tiles[parent_level->width_in_tiles * parent_tile_y + parent_tile_x];
-    if (parent_tile->exists && !parent_tile->cache_marked) {
-        tile_list_remove(cache_list, parent_tile);
-        parent_tile->cache_marked = true;
-        tile_list_insert_first(idwt_list, parent_tile);
+    if (parent_tile->exists) {
+        isyntax_tile_reserve(parent_tile, read_id, idwt_list, cache_list, is_blocked);
     }
 }
 
-static void isyntax_make_tile_lists_add_children_to_list(isyntax_t* isyntax, isyntax_tile_t* tile,
+// Children that are reserved by another read are skipped: the read doesn't depend on them, so it doesn't have to wait.
+static void isyntax_make_tile_lists_add_children_to_list(isyntax_t* isyntax, isyntax_tile_t* tile, u32 read_id,
                                                          isyntax_tile_list_t* children_list, isyntax_tile_list_t* cache_list) {
     if (tile->tile_scale > 0) {
         isyntax_tile_children_t children = isyntax_openslide_compute_children(isyntax, tile);
         for (int i = 0; i < 4; ++i) {
             if (!children.as_array[i]->cache_marked) {
                 tile_list_remove(cache_list, children.as_array[i]);
+                children.as_array[i]->cache_marked = read_id;
                 tile_list_insert_first(children_list, children.as_array[i]);
             }
         }
     }
 }
 
-static void isyntax_make_tile_lists_by_scale(isyntax_t* isyntax, int start_scale,
+// All tiles that are added to the lists are reserved for the read (see isyntax_tile_reserve()). If a tile that the read
+// depends on is reserved by another read, is_blocked is set.
+static void isyntax_make_tile_lists_by_scale(isyntax_t* isyntax, int start_scale, u32 read_id,
                                              isyntax_tile_list_t* idwt_list,
                                              isyntax_tile_list_t* coeff_list,
                                              isyntax_tile_list_t* children_list,
-                                             isyntax_tile_list_t* cache_list) {
+                                             isyntax_tile_list_t* cache_list, bool add_children, bool* is_blocked) {
     isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
     for (int scale = start_scale; scale <= wsi->max_scale; ++scale) {
         // Mark all neighbors of idwt tiles at this level as requiring coefficients.
@@ -288,13 +382,10 @@ static void isyntax_make_tile_lists_by_scale(isyntax_t* isyntax, int start_scale
                         }
 
                         isyntax_tile_t* neighbor_tile = &level->tiles[level->width_in_tiles * neighbor_tile_y + neighbor_tile_x];
-                        if (neighbor_tile->cache_marked || !neighbor_tile->exists) {
+                        if (!neighbor_tile->exists) {
                             continue;
                         }
-
-                        tile_list_remove(cache_list, neighbor_tile);
-                        neighbor_tile->cache_marked = true;
-                        tile_list_insert_first(coeff_list, neighbor_tile);
+                        isyntax_tile_reserve(neighbor_tile, read_id, coeff_list, cache_list, is_blocked);
                     }
                 }
             }
@@ -304,12 +395,12 @@ static void isyntax_make_tile_lists_by_scale(isyntax_t* isyntax, int start_scale
         // ll coefficients.
         for (ITERATE_TILE_LIST(tile, (*idwt_list))) {
             if (tile->tile_scale == scale) {
-                isyntax_make_tile_lists_add_parent_to_list(isyntax, tile, idwt_list, cache_list);
+                isyntax_make_tile_lists_add_parent_to_list(isyntax, tile, read_id, idwt_list, cache_list, is_blocked);
             }
         }
         for (ITERATE_TILE_LIST(tile, (*coeff_list))) {
             if (tile->tile_scale == scale) {
-                isyntax_make_tile_lists_add_parent_to_list(isyntax, tile, idwt_list, cache_list);
+                isyntax_make_tile_lists_add_parent_to_list(isyntax, tile, read_id, idwt_list, cache_list, is_blocked);
             }
         }
     }
@@ -318,109 +409,421 @@ static void isyntax_make_tile_lists_by_scale(isyntax_t* isyntax, int start_scale
     // and so should be cache bumped.
     // TODO(avirodov): if we store the idwt result (ll of next level) in the tile instead of the children, this
     //  would be unnecessary. But I'm not sure this is bad either.
+    if (!add_children) {
+        return; // the ll coefficients of children that are not needed for the request are not written
+    }
     for (ITERATE_TILE_LIST(tile, (*idwt_list))) {
-        isyntax_make_tile_lists_add_children_to_list(isyntax, tile, children_list, cache_list);
+        isyntax_make_tile_lists_add_children_to_list(isyntax, tile, read_id, children_list, cache_list);
     }
 }
 
-void isyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, int tile_x, int tile_y,
-                       uint32_t* pixels_buffer, enum isyntax_pixel_format_t pixel_format) {
-    // TODO(avirodov): more granular locking (some notes below). This will require handling overlapping work, that is
-    //  thread A needing tile 123 and started to load it, and thread B needing same tile 123 and needs to wait for A.
-    // TODO(pvalkema): Can we safely lock the mutex later, after checking if the tile exists?
-    platform_mutex_lock(&cache->mutex);
-
-    isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
-    isyntax_level_t* level = &wsi->levels[scale];
+// Fill rows of pixels with white, e.g. for tiles that are out of bounds or don't exist.
+static void isyntax_fill_white(void* pixels_buffer, int stride, size_t plane_stride, int width, int row_count,
+                               enum isyntax_pixel_format_t pixel_format) {
+    int plane_count = isyntax_pixel_format_plane_count(pixel_format);
+    int row_size = isyntax_pixel_format_packed_stride(pixel_format, width);
+    for (int plane = 0; plane < plane_count; ++plane) {
+        uint8_t* dest = (uint8_t*)pixels_buffer + plane * plane_stride;
+        if (pixel_format == LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR) {
+            // White is Y = 255 with zero chroma.
+            icoeff_t value = (plane == 0) ? 255 : 0;
+            for (int row = 0; row < row_count; ++row) {
+                icoeff_t* dest_row = (icoeff_t*)(dest + (size_t)row * stride);
+                for (int i = 0; i < width; ++i) {
+                    dest_row[i] = value;
+                }
+            }
+        } else if (stride == row_size) {
+            memset(dest, 0xff, (size_t)row_size * row_count);
+        } else {
+            for (int row = 0; row < row_count; ++row) {
+                memset(dest + (size_t)row * stride, 0xff, row_size);
+            }
+        }
+    }
+}
 
-	if (!(tile_x >= 0 && tile_x < level->width_in_tiles && tile_y >= 0 && tile_y < level->height_in_tiles)) {
-		// Read out of bounds -> set to all white
-		memset(pixels_buffer, 0xff, isyntax->tile_width * isyntax->tile_height * 4);
-        platform_mutex_unlock(&cache->mutex);
-		return;
-	}
+// Returns NULL if the tile is out of bounds or doesn't exist.
+static isyntax_tile_t* isyntax_get_requested_tile(isyntax_t* isyntax, const isyntax_tile_read_request_t* request) {
+    isyntax_level_t* level = &isyntax->images[isyntax->wsi_image_index].levels[request->scale];
+    if (!(request->tile_x >= 0 && request->tile_x < level->width_in_tiles &&
+          request->tile_y >= 0 && request->tile_y < level->height_in_tiles)) {
+        return NULL;
+    }
+    isyntax_tile_t* tile = &level->tiles[level->width_in_tiles * request->tile_y + request->tile_x];
+    return tile->exists ? tile : NULL;
+}
 
-    isyntax_tile_t *tile = &level->tiles[level->width_in_tiles * tile_y + tile_x];
-    // printf("=== isyntax_openslide_load_tile scale=%d tile_x=%d tile_y=%d\n", scale, tile_x, tile_y);
-    if (!tile->exists) {
-        memset(pixels_buffer, 0xff, isyntax->tile_width * isyntax->tile_height * 4);
-        platform_mutex_unlock(&cache->mutex);
+// Transforms a requested tile (all its dependencies must be loaded) and writes its pixels. If the request is cropped,
+// only the part of the tile around the cropped area is transformed, unless the children of the tile still need their
+// LL coefficients from it. If the planes of the request are laid out differently, the pixels are written to scratch
+// memory of the current thread first.
+// If the tile is requested more than once (is_duplicate), the LL coefficients of the children are left to the first
+// request, so that the requests for the same tile can run at the same time.
+static void isyntax_tile_read_write_pixels(isyntax_cache_t* cache, isyntax_t* isyntax, isyntax_tile_t* tile, u32 read_id,
+                                           int color_count, const isyntax_tile_read_request_t* request,
+                                           bool is_duplicate, enum isyntax_pixel_format_t pixel_format) {
+    int plane_count = isyntax_pixel_format_plane_count(pixel_format);
+    int bytes_per_pixel = isyntax_pixel_format_packed_stride(pixel_format, 1);
+    int src_x = request->is_cropped ? request->src_x : 0;
+    int src_y = request->is_cropped ? request->src_y : 0;
+    int width = request->is_cropped ? request->width : isyntax->tile_width;
+    int height = request->is_cropped ? request->height : isyntax->tile_height;
+
+    if (tile == NULL) {
+        isyntax_fill_white(request->pixels_buffer, request->stride, request->plane_stride, width, height,
+                           pixel_format);
         return;
     }
 
-    // Need 3 lists:
-    // 1. idwt list - those tiles will have to perform an idwt for their children to get ll coeffs. Primary cache bump.
-    // 2. coeff list - those tiles are neighbors and will need to have coefficients loaded. Secondary cache bump.
-    // 3. children list - those tiles will have their ll coeffs loaded as a side effect. Tertiary cache bump.
-    // Those lists must be disjoint, and sorted such that parents are closer to head than children.
-    isyntax_tile_list_t idwt_list = {NULL, NULL, 0, "idwt_list"};
-    isyntax_tile_list_t coeff_list = {NULL, NULL, 0, "coeff_list"};
-    isyntax_tile_list_t children_list = {NULL, NULL, 0, "children_list"};
+    bool is_direct = (plane_count == 1 || request->plane_stride == (size_t)request->stride * height);
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    void* pixels = request->pixels_buffer;
+    int stride = request->stride;
+    size_t plane_size = (size_t)width * bytes_per_pixel * height;
+    if (!is_direct) {
+        stride = width * bytes_per_pixel;
+        arena_align(temp_memory.arena, 8);
+        pixels = arena_push_size(temp_memory.arena, plane_size * plane_count);
+        arena_align(temp_memory.arena, 8); // the idwt buffers come after the pixels
+    }
 
-    // Lock.
-    // Make a list of all dependent tiles (including the required one).
-    // Mark all dependent tiles as "reserved" so that they are not evicted by other threads as we load them.
-    // Unlock.
-    {
-        tile_list_remove(&cache->cache_list, tile);
-        tile->cache_marked = true;
-        tile_list_insert_first(&idwt_list, tile);
+    if (is_duplicate || (request->is_cropped && (tile->tile_scale == 0 ||
+                                                 isyntax_openslide_get_children_ll_mask(cache, isyntax, tile, read_id,
+                                                                                        color_count) == 0))) {
+        isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
+        isyntax_load_tile_window(isyntax, wsi, tile->tile_scale, tile->tile_x, tile->tile_y, color_count,
+                                 src_x, src_y, width, height, pixels, stride, pixel_format);
+    } else {
+        isyntax_openslide_idwt(cache, isyntax, tile, read_id, color_count, pixels, stride, src_x, src_y, width, height,
+                               pixel_format);
     }
-    isyntax_make_tile_lists_by_scale(isyntax, scale, &idwt_list, &coeff_list, &children_list, &cache->cache_list);
 
-    // Unmark visit status and reserve all nodes. todo(avirodov): reserve later when doing threading.
-    for (ITERATE_TILE_LIST(tile, idwt_list))     { tile->cache_marked = false; /*printf("@@@ idwt_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
-    for (ITERATE_TILE_LIST(tile, coeff_list))    { tile->cache_marked = false; /*printf("@@@ coeff_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
-    for (ITERATE_TILE_LIST(tile, children_list)) { tile->cache_marked = false; /*printf("@@@ children_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
+    if (!is_direct) {
+        for (int plane = 0; plane < plane_count; ++plane) {
+            uint8_t* dest = (uint8_t*)request->pixels_buffer + plane * request->plane_stride;
+            uint8_t* src = (uint8_t*)pixels + plane * plane_size;
+            for (int row = 0; row < height; ++row) {
+                memcpy(dest + (size_t)row * request->stride, src + (size_t)row * stride, stride);
+            }
+        }
+    }
+    release_temp_memory(&temp_memory);
+}
 
-    // IO+decode: For all dependent tiles, read and decode coefficients where missing (hh, and ll for top tiles).
-    // Assuming lists are sorted parents first.
-    // IDWT as needed, top to bottom. This should produce idwt for this tile as well, which should be last in idwt list.
-    // YCoCb->RGB for this tile only.
-    uint32_t* result = NULL;
-    for (ITERATE_TILE_LIST(tile, coeff_list)) {
-        isyntax_openslide_load_tile_coefficients(cache, isyntax, tile);
+typedef enum isyntax_tile_read_step_t {
+    ISYNTAX_TILE_READ_LOAD_COEFFICIENTS,
+    ISYNTAX_TILE_READ_IDWT,
+    ISYNTAX_TILE_READ_WRITE_PIXELS,
+} isyntax_tile_read_step_t;
+
+typedef struct isyntax_tile_read_task_t {
+    isyntax_tile_read_step_t step;
+    isyntax_cache_t* cache;
+    isyntax_t* isyntax;
+    isyntax_tile_t* tile;
+    u32 read_id;
+    int color_count;
+    enum isyntax_pixel_format_t pixel_format;
+    const isyntax_tile_read_request_t* request;
+    bool is_duplicate;
+} isyntax_tile_read_task_t;
+
+static void isyntax_tile_read_run_task(isyntax_tile_read_task_t* task) {
+    switch (task->step) {
+        case ISYNTAX_TILE_READ_LOAD_COEFFICIENTS: {
+            isyntax_openslide_load_tile_coefficients(task->cache, task->isyntax, task->tile, task->color_count);
+        } break;
+        case ISYNTAX_TILE_READ_IDWT: {
+            if (task->request) {
+                // The tile is requested itself as well: its pixels come from the same idwt.
+                isyntax_tile_read_write_pixels(task->cache, task->isyntax, task->tile, task->read_id, task->color_count,
+                                               task->request, false, task->pixel_format);
+            } else {
+                isyntax_openslide_idwt(task->cache, task->isyntax, task->tile, task->read_id, task->color_count,
+                                       /*pixels_buffer=*/NULL, /*stride=*/0, 0, 0, 0, 0, /*pixel_format=*/0);
+            }
+        } break;
+        case ISYNTAX_TILE_READ_WRITE_PIXELS: {
+            isyntax_tile_read_write_pixels(task->cache, task->isyntax, task->tile, task->read_id, task->color_count,
+                                           task->request, task->is_duplicate, task->pixel_format);
+        } break;
     }
-    for (ITERATE_TILE_LIST(tile, idwt_list)) {
-        isyntax_openslide_load_tile_coefficients(cache, isyntax, tile);
+}
+
+// The tasks of one step of a read. While the calling thread waits, it must not run other tasks from the pool: these may
+// be reads that wait for the tiles of this read. Instead, the calling thread and the worker threads (through helper
+// tasks) take the tasks of the batch from a shared counter. The calling thread runs whatever no worker has taken yet,
+// and then waits for the tasks that are already running; whoever completes the last task wakes it up. Helpers that
+// start after all tasks have been taken have nothing left to do; the batch is freed by whoever releases it last.
+typedef struct isyntax_tile_read_batch_t {
+    i32 volatile next_task;
+    i32 volatile completed_count;
+    i32 volatile refcount;
+    i32 task_count;
+    platform_mutex_t mutex;
+    platform_cond_t done;
+    isyntax_tile_read_task_t tasks[];
+} isyntax_tile_read_batch_t;
+
+static void isyntax_tile_read_batch_work(isyntax_tile_read_batch_t* batch) {
+    for (;;) {
+        i32 task_index = atomic_increment(&batch->next_task) - 1;
+        if (task_index >= batch->task_count) {
+            break;
+        }
+        isyntax_tile_read_run_task(&batch->tasks[task_index]);
+        if (atomic_increment(&batch->completed_count) == batch->task_count) {
+            platform_mutex_lock(&batch->mutex);
+            platform_cond_broadcast(&batch->done);
+            platform_mutex_unlock(&batch->mutex);
+        }
     }
-    for (ITERATE_TILE_LIST(tile, idwt_list)) {
-        if (tile == idwt_list.tail) {
-            isyntax_openslide_idwt(cache, isyntax, tile, pixels_buffer, pixel_format);
-        } else {
-            isyntax_openslide_idwt(cache, isyntax, tile, /*pixels_buffer=*/NULL, /*pixel_format=*/0);
+}
+
+static void isyntax_tile_read_batch_release(isyntax_tile_read_batch_t* batch, i32 ref_count) {
+    if (atomic_subtract(&batch->refcount, ref_count) == 0) {
+        platform_cond_destroy(&batch->done);
+        platform_mutex_destroy(&batch->mutex);
+        free(batch);
+    }
+}
+
+static void isyntax_tile_read_batch_helper_func(int logical_thread_index, void* userdata) {
+    (void)logical_thread_index;
+    isyntax_tile_read_batch_t* batch = *(isyntax_tile_read_batch_t**) userdata;
+    isyntax_tile_read_batch_work(batch);
+    isyntax_tile_read_batch_release(batch, 1);
+}
+
+// Runs the tasks, spread across the worker threads of the pool if there is one (see isyntax_tile_read_batch_t).
+static void isyntax_tile_read_run_tasks(thread_pool_t* pool, isyntax_tile_read_task_t* tasks, int task_count) {
+    int helper_count = MIN(task_count - 1, thread_pool_get_active_worker_thread_count(pool));
+    if (helper_count <= 0) {
+        for (int i = 0; i < task_count; ++i) {
+            isyntax_tile_read_run_task(&tasks[i]);
+        }
+        return;
+    }
+
+    isyntax_tile_read_batch_t* batch = malloc(sizeof(isyntax_tile_read_batch_t) + task_count * sizeof(isyntax_tile_read_task_t));
+    batch->next_task = 0;
+    batch->completed_count = 0;
+    batch->refcount = 1 + helper_count;
+    batch->task_count = task_count;
+    platform_mutex_init(&batch->mutex);
+    platform_cond_init(&batch->done);
+    memcpy(batch->tasks, tasks, task_count * sizeof(isyntax_tile_read_task_t));
+    for (int i = 0; i < helper_count; ++i) {
+        // Leave room in the queue for other work; the calling thread picks up the tasks that no helper takes.
+        if (!(thread_pool_get_task_count(pool) < thread_pool_get_task_capacity(pool) / 2 &&
+              thread_pool_submit_task(pool, isyntax_tile_read_batch_helper_func, &batch, sizeof(batch)))) {
+            isyntax_tile_read_batch_release(batch, helper_count - i);
+            break;
         }
     }
 
+    isyntax_tile_read_batch_work(batch);
+    platform_mutex_lock(&batch->mutex);
+    while (atomic_add(&batch->completed_count, 0) < task_count) {
+        platform_cond_wait(&batch->done, &batch->mutex);
+    }
+    platform_mutex_unlock(&batch->mutex);
+    isyntax_tile_read_batch_release(batch, 1);
+}
+
+// Unmarks the tiles of a read, bumps them in the cache and trims the cache. Must be called with the cache mutex held.
+// Tiles that are reserved by running reads are not in the cache list, so they are never evicted here.
+static void isyntax_tile_read_release_tiles(isyntax_cache_t* cache, isyntax_tile_list_t* idwt_list,
+                                            isyntax_tile_list_t* coeff_list, isyntax_tile_list_t* children_list) {
+    // Unmark visit status. The marks are kept until here, so that the idwt can tell which children the request needs.
+    for (ITERATE_TILE_LIST(tile, (*idwt_list)))     { tile->cache_marked = 0; /*printf("@@@ idwt_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
+    for (ITERATE_TILE_LIST(tile, (*coeff_list)))    { tile->cache_marked = 0; /*printf("@@@ coeff_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
+    for (ITERATE_TILE_LIST(tile, (*children_list))) { tile->cache_marked = 0; /*printf("@@@ children_list tile scale=%d x=%d y=%d\n", tile->tile_scale, tile->tile_x, tile->tile_y);*/ }
+
     // Lock.
     // Bump all the affected tiles in cache.
     // Unmark all dependent tiles as "referenced" so that they can be evicted.
     // Perform cache trim (possibly not every invocation).
     // Unlock.
 
-    tile_list_insert_list_first(&cache->cache_list, &children_list);
-    tile_list_insert_list_first(&cache->cache_list, &coeff_list);
-    tile_list_insert_list_first(&cache->cache_list, &idwt_list);
+    tile_list_insert_list_first(&cache->cache_list, children_list);
+    tile_list_insert_list_first(&cache->cache_list, coeff_list);
+    tile_list_insert_list_first(&cache->cache_list, idwt_list);
 
     // Cache trim. Since we have the result already, it is possible that tiles from this run will be trimmed here
     // if cache is small or work happened on other threads.
-    // TODO(avirodov): later will need to skip tiles that are reserved by other threads.
     while (cache->cache_list.count > cache->target_cache_size) {
         isyntax_tile_t* tile = cache->cache_list.tail;
         tile_list_remove(&cache->cache_list, tile);
         for (int i = 0; i < 3; ++i) {
-            if (tile->has_ll) {
+            // Not every channel is allocated if the tile was loaded for a grayscale read.
+            if (tile->color_channels[i].coeff_ll) {
                 block_free(cache->ll_coeff_block_allocator, tile->color_channels[i].coeff_ll);
                 tile->color_channels[i].coeff_ll = NULL;
             }
-            if (tile->has_h) {
+            if (tile->color_channels[i].coeff_h) {
                 block_free(cache->h_coeff_block_allocator, tile->color_channels[i].coeff_h);
                 tile->color_channels[i].coeff_h = NULL;
             }
         }
         tile->has_ll = false;
         tile->has_h = false;
+        tile->ll_bitplane_limit = 0;
+        tile->h_bitplane_limit = 0;
+        tile->ll_is_y_only = false;
+        tile->h_is_y_only = false;
+    }
+}
+
+// Returns the id of a new read, to reserve its tiles with. Must be called with the cache mutex held.
+static u32 isyntax_cache_next_read_id(isyntax_cache_t* cache) {
+    if (++cache->last_read_id == 0) {
+        ++cache->last_read_id; // 0 means that a tile is not reserved
+    }
+    return cache->last_read_id;
+}
+
+// Gives up the tiles of a read that is blocked by another read, and waits until a read is done. Must be called with the
+// cache mutex held.
+static void isyntax_tile_read_wait_for_other_reads(isyntax_cache_t* cache, isyntax_tile_list_t* idwt_list,
+                                                   isyntax_tile_list_t* coeff_list, isyntax_tile_list_t* children_list) {
+    isyntax_tile_read_release_tiles(cache, idwt_list, coeff_list, children_list);
+    platform_cond_wait(&cache->read_done, &cache->mutex);
+}
+
+void isyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, int tile_x, int tile_y,
+                       void* pixels_buffer, int stride, enum isyntax_pixel_format_t pixel_format) {
+    isyntax_tile_read_request_t request = {
+        .scale = scale,
+        .tile_x = tile_x,
+        .tile_y = tile_y,
+        .pixels_buffer = pixels_buffer,
+        .stride = stride,
+        .plane_stride = (size_t)stride * isyntax->tile_height,
+    };
+    isyntax_tile_read_multiple(isyntax, cache, &request, 1, pixel_format, NULL);
+}
+
+void isyntax_tile_read_multiple(isyntax_t* isyntax, isyntax_cache_t* cache,
+                                const isyntax_tile_read_request_t* requests, int request_count,
+                                enum isyntax_pixel_format_t pixel_format, thread_pool_t* pool) {
+    isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
+    int color_count = isyntax_pixel_format_color_count(pixel_format);
+
+    // Need 3 lists:
+    // 1. idwt list - those tiles will have to perform an idwt for their children to get ll coeffs. Primary cache bump.
+    // 2. coeff list - those tiles are neighbors and will need to have coefficients loaded. Secondary cache bump.
+    // 3. children list - those tiles will have their ll coeffs loaded as a side effect. Tertiary cache bump.
+    // Those lists must be disjoint, and sorted such that parents are closer to head than children.
+    isyntax_tile_list_t idwt_list = {NULL, NULL, 0, "idwt_list"};
+    isyntax_tile_list_t coeff_list = {NULL, NULL, 0, "coeff_list"};
+    isyntax_tile_list_t children_list = {NULL, NULL, 0, "children_list"};
+
+    // Make a list of all dependent tiles (including the requested ones), and reserve them for this read, so that other
+    // reads don't evict or change them while this read runs without the cache mutex. If another read has reserved some
+    // of them, give up the reservations and try again when a read is done.
+    int scale = wsi->max_scale; // the lowest level that is requested
+    int highest_requested_scale = 0;
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    bool* is_duplicate = arena_push_array(temp_memory.arena, request_count, bool);
+    arena_align(temp_memory.arena, 8); // the tasks, and the idwt buffers of this thread, come after the flags
+    for (int i = 0; i < request_count; ++i) {
+        scale = MIN(scale, requests[i].scale);
+        highest_requested_scale = MAX(highest_requested_scale, requests[i].scale);
+    }
+    platform_mutex_lock(&cache->mutex);
+    u32 read_id = isyntax_cache_next_read_id(cache);
+    for (;;) {
+        bool is_blocked = false;
+        for (int i = 0; i < request_count; ++i) {
+            isyntax_tile_t* tile = isyntax_get_requested_tile(isyntax, &requests[i]);
+            // Only requested tiles are reserved at this point, so a tile reserved by this read was requested before.
+            is_duplicate[i] = (tile && tile->cache_marked == read_id);
+            if (tile) {
+                isyntax_tile_reserve(tile, read_id, &idwt_list, &cache->cache_list, &is_blocked);
+            }
+        }
+        if (!is_blocked && idwt_list.count > 0) {
+            bool keep_all_ll = (cache->ll_policy == LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL);
+            isyntax_make_tile_lists_by_scale(isyntax, scale, read_id, &idwt_list, &coeff_list, &children_list,
+                                             &cache->cache_list, keep_all_ll, &is_blocked);
+        }
+        if (!is_blocked) {
+            break;
+        }
+        isyntax_tile_read_wait_for_other_reads(cache, &idwt_list, &coeff_list, &children_list);
+    }
+    platform_mutex_unlock(&cache->mutex);
+
+    if (idwt_list.count == 0) {
+        // Read out of bounds, or the tiles don't exist -> set to all white
+        for (int i = 0; i < request_count; ++i) {
+            isyntax_tile_read_write_pixels(cache, isyntax, NULL, 0, color_count, &requests[i], false, pixel_format);
+        }
+        release_temp_memory(&temp_memory);
+        return;
+    }
+
+    // IO+decode: For all dependent tiles, read and decode coefficients where missing (hh, and ll for top tiles).
+    // IDWT as needed, top to bottom. The idwts of tiles at the same level are independent of each other, and so are
+    //  the requested tiles at the lowest level.
+    // YCoCb->RGB for the requested tiles only. Requested tiles above the lowest level get their pixels from the idwt
+    //  that is needed for the levels below anyway.
+    // For grayscale, only the Y channel is loaded and transformed all the way down.
+    // With a thread pool, each of these steps is spread across the worker threads. Every tile is handled once per
+    //  step, so parent idwts that are shared between the requested tiles only run once.
+    isyntax_tile_read_task_t task = {.cache = cache, .isyntax = isyntax, .read_id = read_id, .color_count = color_count,
+                                     .pixel_format = pixel_format};
+    int max_task_count = MAX(coeff_list.count + idwt_list.count, request_count);
+    isyntax_tile_read_task_t* tasks = arena_push_array(temp_memory.arena, max_task_count, isyntax_tile_read_task_t);
+    int task_count = 0;
+    task.step = ISYNTAX_TILE_READ_LOAD_COEFFICIENTS;
+    for (ITERATE_TILE_LIST(tile, coeff_list)) {
+        task.tile = tile;
+        tasks[task_count++] = task;
+    }
+    for (ITERATE_TILE_LIST(tile, idwt_list)) {
+        task.tile = tile;
+        tasks[task_count++] = task;
+    }
+    isyntax_tile_read_run_tasks(pool, tasks, task_count);
+    task.step = ISYNTAX_TILE_READ_IDWT;
+    for (int idwt_scale = wsi->max_scale; idwt_scale > scale; --idwt_scale) {
+        task_count = 0;
+        for (ITERATE_TILE_LIST(tile, idwt_list)) {
+            if (tile->tile_scale == idwt_scale) {
+                task.tile = tile;
+                task.request = NULL;
+                for (int i = 0; idwt_scale <= highest_requested_scale && i < request_count; ++i) {
+                    if (requests[i].scale == idwt_scale && requests[i].tile_x == tile->tile_x &&
+                        requests[i].tile_y == tile->tile_y) {
+                        task.request = &requests[i];
+                        break;
+                    }
+                }
+                tasks[task_count++] = task;
+            }
+        }
+        isyntax_tile_read_run_tasks(pool, tasks, task_count);
     }
+    task.step = ISYNTAX_TILE_READ_WRITE_PIXELS;
+    task_count = 0;
+    for (int i = 0; i < request_count; ++i) {
+        task.tile = isyntax_get_requested_tile(isyntax, &requests[i]);
+        if (task.tile && requests[i].scale > scale && !is_duplicate[i]) {
+            continue; // already written during the idwt
+        }
+        task.request = &requests[i];
+        task.is_duplicate = is_duplicate[i];
+        tasks[task_count++] = task;
+    }
+    isyntax_tile_read_run_tasks(pool, tasks, task_count);
+    release_temp_memory(&temp_memory);
+
+    platform_mutex_lock(&cache->mutex);
+    isyntax_tile_read_release_tiles(cache, &idwt_list, &coeff_list, &children_list);
+    platform_cond_broadcast(&cache->read_done);
 
     // Prevent iSyntax streamer from calling isyntax_begin_first_load()
     if (!wsi->first_load_complete) {
@@ -429,3 +832,91 @@ void isyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, in
 
     platform_mutex_unlock(&cache->mutex);
 }
+
+bool isyntax_tile_read_coefficients(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, int tile_x, int tile_y,
+                                    icoeff_t* ll_buffer, icoeff_t* h_buffer) {
+    isyntax_image_t* wsi = &isyntax->images[isyntax->wsi_image_index];
+    isyntax_tile_read_request_t request = {.scale = scale, .tile_x = tile_x, .tile_y = tile_y};
+    int color_count = 3;
+
+    isyntax_tile_t* tile = isyntax_get_requested_tile(isyntax, &request);
+    if (!tile) {
+        return false;
+    }
+
+    // The tile itself only needs its own coefficients. Its LL coefficients come from the idwt of the parent (unless the
+    // cache still has them), which has the same dependencies as a regular read of the parent. The tiles are reserved in
+    // the same way as in isyntax_tile_read_multiple().
+    isyntax_tile_list_t idwt_list = {NULL, NULL, 0, "idwt_list"};
+    isyntax_tile_list_t coeff_list = {NULL, NULL, 0, "coeff_list"};
+    isyntax_tile_list_t children_list = {NULL, NULL, 0, "children_list"};
+    platform_mutex_lock(&cache->mutex);
+    u32 read_id = isyntax_cache_next_read_id(cache);
+    for (;;) {
+        bool is_blocked = false;
+        isyntax_tile_reserve(tile, read_id, &coeff_list, &cache->cache_list, &is_blocked);
+        bool needs_ll = !is_blocked && ll_buffer && scale < wsi->max_scale &&
+                        !(tile->has_ll && isyntax_cache_can_use_coefficients(cache, tile->ll_bitplane_limit) &&
+                          isyntax_has_color_channels(tile->ll_is_y_only, color_count));
+        if (needs_ll) {
+            isyntax_make_tile_lists_add_parent_to_list(isyntax, tile, read_id, &idwt_list, &cache->cache_list,
+                                                       &is_blocked);
+            if (!is_blocked && idwt_list.count > 0) {
+                bool keep_all_ll = (cache->ll_policy == LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL);
+                isyntax_make_tile_lists_by_scale(isyntax, scale + 1, read_id, &idwt_list, &coeff_list, &children_list,
+                                                 &cache->cache_list, keep_all_ll, &is_blocked);
+            }
+        }
+        if (!is_blocked) {
+            break;
+        }
+        isyntax_tile_read_wait_for_other_reads(cache, &idwt_list, &coeff_list, &children_list);
+    }
+    platform_mutex_unlock(&cache->mutex);
+
+    for (ITERATE_TILE_LIST(dependency, coeff_list)) {
+        isyntax_openslide_load_tile_coefficients(cache, isyntax, dependency, color_count);
+    }
+    for (ITERATE_TILE_LIST(dependency, idwt_list)) {
+        isyntax_openslide_load_tile_coefficients(cache, isyntax, dependency, color_count);
+    }
+    for (int idwt_scale = wsi->max_scale; idwt_scale > scale; --idwt_scale) {
+        for (ITERATE_TILE_LIST(dependency, idwt_list)) {
+            if (dependency->tile_scale == idwt_scale) {
+                isyntax_openslide_idwt(cache, isyntax, dependency, read_id, color_count,
+                                       /*pixels_buffer=*/NULL, /*stride=*/0, 0, 0, 0, 0, /*pixel_format=*/0);
+            }
+        }
+    }
+
+    // Missing coefficients are filled in the same way as the idwt does: LL is white for the Y channel, the rest is zero.
+    size_t block_size = (size_t)isyntax->block_width * isyntax->block_height;
+    for (int color = 0; color < color_count; ++color) {
+        isyntax_tile_channel_t* channel = tile->color_channels + color;
+        if (ll_buffer) {
+            icoeff_t* dest = ll_buffer + color * block_size;
+            if (channel->coeff_ll) {
+                memcpy(dest, channel->coeff_ll, block_size * sizeof(icoeff_t));
+            } else {
+                icoeff_t value = (color == 0) ? 255 : 0;
+                for (size_t i = 0; i < block_size; ++i) {
+                    dest[i] = value;
+                }
+            }
+        }
+        if (h_buffer) {
+            icoeff_t* dest = h_buffer + color * 3 * block_size;
+            if (channel->coeff_h) {
+                memcpy(dest, channel->coeff_h, 3 * block_size * sizeof(icoeff_t));
+            } else {
+                memset(dest, 0, 3 * block_size * sizeof(icoeff_t));
+            }
+        }
+    }
+
+    platform_mutex_lock(&cache->mutex);
+    isyntax_tile_read_release_tiles(cache, &idwt_list, &coeff_list, &children_list);
+    platform_cond_broadcast(&cache->read_done);
+    platform_mutex_unlock(&cache->mutex);
+    return true;
+}
@@ -14,6 +14,9 @@ typedef struct isyntax_tile_list_t {
 typedef struct isyntax_cache_t {
     isyntax_tile_list_t cache_list;
     platform_mutex_t mutex;
+    // Signalled when a read releases its tiles, for reads that need some of the same tiles.
+    platform_cond_t read_done;
+    u32 last_read_id;
     // TODO(avirodov): int refcount;
     int target_cache_size;
     block_allocator_t* ll_coeff_block_allocator;
@@ -21,11 +24,53 @@ typedef struct isyntax_cache_t {
 	bool is_block_allocator_owned;
     int allocator_block_width;
     int allocator_block_height;
+    // Number of magnitude bitplanes to decode for H coefficients (0 = all, full quality).
+    int h_bitplane_limit;
+    // Which ll coefficients of lower levels to keep (LIBISYNTAX_LL_CACHE_POLICY_*).
+    int ll_policy;
+    // Spread the tiles of a region read across the thread pool.
+    bool parallel_region_reads;
 } isyntax_cache_t;
 
 // TODO(avirodov): can this ever fail?
+// Rows of pixels_buffer are stride bytes apart, see isyntax_convert_ycocg_to_pixels().
 void isyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, int tile_x, int tile_y,
-                       uint32_t* pixels_buffer, enum isyntax_pixel_format_t pixel_format);
+                       void* pixels_buffer, int stride, enum isyntax_pixel_format_t pixel_format);
+
+// A tile (of level scale) to be read by isyntax_tile_read_multiple(). Rows of pixels_buffer are stride bytes apart, and for planar
+// formats the planes are plane_stride bytes apart. If is_cropped is set, only the part of the tile starting at
+// (src_x, src_y) of size width x height is written.
+typedef struct isyntax_tile_read_request_t {
+    int scale;
+    int tile_x;
+    int tile_y;
+    void* pixels_buffer;
+    int stride;
+    size_t plane_stride;
+    bool is_cropped;
+    int src_x;
+    int src_y;
+    int width;
+    int height;
+} isyntax_tile_read_request_t;
+
+// Reads several tiles as one request, so that their shared dependencies are loaded and transformed only once. The
+// tiles may be at different levels: tiles above the lowest requested level are written by the idwt that the levels
+// below need anyway. If a thread pool is given, the work is spread across its worker threads. The tiles that the read
+// depends on are reserved for it, and the transforms run without the cache mutex; reads that need some of the same
+// tiles wait until the read is done. While waiting for its own tasks, the calling thread only runs tasks of this read,
+// never other work from the pool, so the read also completes if all worker threads are busy. A tile may be requested
+// more than once (e.g. by overlapping patches).
+void isyntax_tile_read_multiple(isyntax_t* isyntax, isyntax_cache_t* cache,
+                                const isyntax_tile_read_request_t* requests, int request_count,
+                                enum isyntax_pixel_format_t pixel_format, thread_pool_t* pool);
+
+// Copies the wavelet coefficients of a tile (for all three color channels), as used by the idwt of the tile. The LL
+// block is laid out as [color][block_height][block_width], the H blocks as [color][HL, LH, HH][block_height][block_width].
+// Either buffer may be NULL. The LL coefficients are computed from the parent tiles if needed. Returns false if the tile
+// is out of bounds or doesn't exist.
+bool isyntax_tile_read_coefficients(isyntax_t* isyntax, isyntax_cache_t* cache, int scale, int tile_x, int tile_y,
+                                    icoeff_t* ll_buffer, icoeff_t* h_buffer);
 
 void tile_list_init(isyntax_tile_list_t* list, const char* dbg_name);
 void tile_list_remove(isyntax_tile_list_t* list, isyntax_tile_t* tile);
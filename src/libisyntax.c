@@ -54,6 +54,7 @@
 
 #include "libisyntax.h"
 #include "isyntax.h"
+#include "isyntax_kernels.h"
 #include "isyntax_reader.h"
 #include <math.h>
 
@@ -73,6 +74,33 @@ i32 volatile dbgctr_init_thread_pool_counter = 0;
 
 static platform_mutex_t libisyntax_global_mutex = PLATFORM_MUTEX_INITIALIZER;
 
+static const char* libisyntax_simd_level_names[] = {
+    [LIBISYNTAX_SIMD_LEVEL_SCALAR] = "scalar",
+    [LIBISYNTAX_SIMD_LEVEL_SSE2] = "sse2",
+    [LIBISYNTAX_SIMD_LEVEL_SSSE3] = "ssse3",
+    [LIBISYNTAX_SIMD_LEVEL_AVX2] = "avx2",
+    [LIBISYNTAX_SIMD_LEVEL_AVX512] = "avx512",
+    [LIBISYNTAX_SIMD_LEVEL_NEON] = "neon",
+};
+
+// Select the SIMD kernels: the best the CPU supports, unless overridden by the LIBISYNTAX_SIMD_LEVEL environment variable.
+static void libisyntax_init_simd_level(void) {
+    isyntax_select_simd_level(isyntax_get_cpu_simd_level());
+    const char* requested = getenv("LIBISYNTAX_SIMD_LEVEL");
+    if (requested && requested[0] != '\0') {
+        for (i32 i = 0; i < (i32)COUNT(libisyntax_simd_level_names); ++i) {
+            if (strcasecmp(requested, libisyntax_simd_level_names[i]) == 0) {
+                if (!isyntax_select_simd_level(i)) {
+                    console_print_error("libisyntax: SIMD level '%s' is not available, using '%s'\n", requested,
+                                        libisyntax_simd_level_names[isyntax_kernels->simd_level]);
+                }
+                return;
+            }
+        }
+        console_print_error("libisyntax: unknown SIMD level '%s' in LIBISYNTAX_SIMD_LEVEL\n", requested);
+    }
+}
+
 isyntax_error_t libisyntax_init() {
     // Lock-unlock to ensure that all parallel calls to libisyntax_init() wait for the actual initialization to complete.
     platform_mutex_lock(&libisyntax_global_mutex);
@@ -92,12 +120,24 @@ isyntax_error_t libisyntax_init() {
 #else
         libisyntax_init_thread_pool_for_slidescape();
 #endif
+        libisyntax_init_simd_level();
         libisyntax_global_init_complete = true;
     }
     platform_mutex_unlock(&libisyntax_global_mutex);
     return LIBISYNTAX_OK;
 }
 
+isyntax_error_t libisyntax_set_simd_level(int32_t simd_level) {
+    if (!isyntax_select_simd_level(simd_level)) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    return LIBISYNTAX_OK;
+}
+
+int32_t libisyntax_get_simd_level(void) {
+    return isyntax_kernels->simd_level;
+}
+
 isyntax_error_t libisyntax_open(const char* filename, enum libisyntax_open_flags_t flags, isyntax_t** out_isyntax) {
     // Note(avirodov): intentionally not changing api of isyntax_open. We can do that later if needed and reduce
     // the size/count of wrappers.
@@ -119,6 +159,10 @@ void libisyntax_close(isyntax_t* isyntax) {
     free(isyntax);
 }
 
+int32_t libisyntax_pixel_format_get_bytes_per_pixel(int32_t pixel_format) {
+    return isyntax_pixel_format_bytes_per_pixel(pixel_format);
+}
+
 int32_t libisyntax_get_tile_width(const isyntax_t* isyntax) {
     return isyntax->tile_width;
 }
@@ -291,6 +335,7 @@ isyntax_error_t libisyntax_cache_create(const char* debug_name_or_null, int32_t
     tile_list_init(&cache_ptr->cache_list, debug_name_or_null);
     cache_ptr->target_cache_size = cache_size;
     platform_mutex_init(&cache_ptr->mutex);
+    platform_cond_init(&cache_ptr->read_done);
 
     // Note: rest of initialization is deferred to the first injection, as that is where we will know the block size.
 
@@ -352,40 +397,121 @@ void libisyntax_cache_destroy(isyntax_cache_t* isyntax_cache) {
         }
     }
 
+    platform_cond_destroy(&isyntax_cache->read_done);
     platform_mutex_destroy(&isyntax_cache->mutex);
     free(isyntax_cache);
 }
 
-// TODO(pvalkema): should we allow passing a stride for the pixels_buffer, to allow blitting into buffers
-//  that are not exactly the height/width of the region?
+isyntax_error_t libisyntax_cache_set_decode_quality(isyntax_cache_t* isyntax_cache, int32_t h_bitplane_count) {
+    if (h_bitplane_count < 0 || h_bitplane_count > 15) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    platform_mutex_lock(&isyntax_cache->mutex);
+    isyntax_cache->h_bitplane_limit = h_bitplane_count;
+    platform_mutex_unlock(&isyntax_cache->mutex);
+    return LIBISYNTAX_OK;
+}
+
+int32_t libisyntax_cache_get_decode_quality(const isyntax_cache_t* isyntax_cache) {
+    return isyntax_cache->h_bitplane_limit;
+}
+
+isyntax_error_t libisyntax_cache_set_ll_policy(isyntax_cache_t* isyntax_cache, int32_t ll_policy) {
+    if (ll_policy != LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL && ll_policy != LIBISYNTAX_LL_CACHE_POLICY_REQUIRED_ONLY) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    platform_mutex_lock(&isyntax_cache->mutex);
+    isyntax_cache->ll_policy = ll_policy;
+    platform_mutex_unlock(&isyntax_cache->mutex);
+    return LIBISYNTAX_OK;
+}
+
+int32_t libisyntax_cache_get_ll_policy(const isyntax_cache_t* isyntax_cache) {
+    return isyntax_cache->ll_policy;
+}
+
+isyntax_error_t libisyntax_cache_set_parallel_region_reads(isyntax_cache_t* isyntax_cache, int32_t enabled) {
+    platform_mutex_lock(&isyntax_cache->mutex);
+    isyntax_cache->parallel_region_reads = (enabled != 0);
+    platform_mutex_unlock(&isyntax_cache->mutex);
+    return LIBISYNTAX_OK;
+}
+
+int32_t libisyntax_cache_get_parallel_region_reads(const isyntax_cache_t* isyntax_cache) {
+    return isyntax_cache->parallel_region_reads;
+}
+
 isyntax_error_t libisyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
                                      int32_t level, int64_t tile_x, int64_t tile_y,
                                      uint32_t* pixels_buffer, int32_t pixel_format) {
     if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
         return LIBISYNTAX_INVALID_ARGUMENT;
     }
+    int32_t stride = isyntax_pixel_format_packed_stride(pixel_format, isyntax->tile_width);
+    return libisyntax_tile_read_with_stride(isyntax, isyntax_cache, level, tile_x, tile_y, pixels_buffer, stride,
+                                            pixel_format);
+}
+
+isyntax_error_t libisyntax_tile_read_with_stride(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                 int32_t level, int64_t tile_x, int64_t tile_y,
+                                                 uint32_t* pixels_buffer, int32_t stride_in_bytes, int32_t pixel_format) {
+    if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (stride_in_bytes < isyntax_pixel_format_packed_stride(pixel_format, isyntax->tile_width)) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
     // TODO(avirodov): additional vaidations, e.g. tile_x >= 0 && tile_x < isyntax...[level]...->width_in_tiles.
 
     // TODO(avirodov): if isyntax_cache is null, we can support using allocators that are in isyntax object,
     //  if is_init_allocators = 1 when created. Not sure is needed.
-    isyntax_tile_read(isyntax, isyntax_cache, level, tile_x, tile_y, pixels_buffer, pixel_format);
+    isyntax_tile_read(isyntax, isyntax_cache, level, tile_x, tile_y, pixels_buffer, stride_in_bytes, pixel_format);
+    return LIBISYNTAX_OK;
+}
+
+isyntax_error_t libisyntax_tile_read_coefficients(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                  int32_t level, int64_t tile_x, int64_t tile_y,
+                                                  int16_t* ll_buffer, int16_t* h_buffer) {
+    STATIC_ASSERT(sizeof(icoeff_t) == sizeof(int16_t)); // the buffers are passed on as icoeff_t
+    if (level < 0 || level >= isyntax->images[0].level_count || tile_x < 0 || tile_x > INT32_MAX ||
+        tile_y < 0 || tile_y > INT32_MAX) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (!isyntax_tile_read_coefficients(isyntax, isyntax_cache, level, (int)tile_x, (int)tile_y,
+                                        ll_buffer, h_buffer)) {
+        return LIBISYNTAX_INVALID_ARGUMENT; // out of bounds, or the tile doesn't exist
+    }
     return LIBISYNTAX_OK;
 }
 
 #define PER_LEVEL_PADDING 3
 
+// Division that rounds towards negative infinity, so that negative coordinates map to the tiles they are in.
+static inline int64_t floor_div_i64(int64_t a, int64_t b) {
+    return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
 isyntax_error_t libisyntax_read_region(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
                                        int64_t x, int64_t y, int64_t width, int64_t height, uint32_t* pixels_buffer,
                                        int32_t pixel_format) {
-
     if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
         return LIBISYNTAX_INVALID_ARGUMENT;
     }
+    int64_t stride = (int64_t)isyntax_pixel_format_packed_stride(pixel_format, 1) * width;
+    if (stride > INT32_MAX) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    return libisyntax_read_region_with_stride(isyntax, isyntax_cache, level, x, y, width, height, pixels_buffer,
+                                              (int32_t)stride, pixel_format);
+}
 
-    // Get the level
-    ASSERT(level < isyntax->images[0].level_count);
-    isyntax_level_t* current_level = &isyntax->images[0].levels[level];
-
+// Splits a region of a level into one read request per tile. Tiles that lie entirely within the region are decoded
+// straight into pixels_buffer. For the tiles at the edges, only their overlap with the region is copied (see
+// isyntax_tile_read_multiple()). Returns the number of requests, which are only written if requests is not NULL.
+static int64_t libisyntax_get_region_requests(isyntax_t* isyntax, int32_t level, int64_t x, int64_t y,
+                                              int64_t width, int64_t height, uint32_t* pixels_buffer,
+                                              int32_t stride_in_bytes, int32_t pixel_format,
+                                              isyntax_tile_read_request_t* requests) {
     // TODO(pvalkema): check if this still needs adjustment
     int32_t num_levels = isyntax->images[0].level_count;
     int32_t offset = ((PER_LEVEL_PADDING << num_levels) - PER_LEVEL_PADDING) >> level;
@@ -396,44 +522,26 @@ isyntax_error_t libisyntax_read_region(isyntax_t* isyntax, isyntax_cache_t* isyn
     int32_t tile_width = isyntax->tile_width;
     int32_t tile_height = isyntax->tile_height;
 
-    int64_t start_tile_x;
-    int64_t end_tile_x;
-    int64_t x_remainder;
-    int64_t x_remainder_last;
+    int64_t start_tile_x = floor_div_i64(x, tile_width);
+    int64_t end_tile_x = floor_div_i64(x + width - 1, tile_width);
+    int64_t x_remainder = x - start_tile_x * tile_width;
+    int64_t x_remainder_last = (x + width - 1) - end_tile_x * tile_width;
 
-    if (x > 0) {
-        start_tile_x = x / tile_width;
-        end_tile_x = (x + width - 1) / tile_width;
-        x_remainder = x % tile_width;
-        x_remainder_last = (x + width - 1) % tile_width;
-    } else {
-        start_tile_x = -(-x / tile_width);
-        end_tile_x = -(-(x + width - 1) / tile_width);
-        x_remainder = (x % tile_width + tile_width) % tile_width;
-        x_remainder_last = ((x + width - 1) % tile_width + tile_width) % tile_width;
-    }
-
-    int64_t start_tile_y;
-    int64_t end_tile_y;
-    int64_t y_remainder;
-    int64_t y_remainder_last;
-
-    if (y > 0) {
-        start_tile_y = y / tile_height;
-        end_tile_y = (y + height - 1) / tile_height;
-        y_remainder = y % tile_height;
-        y_remainder_last = (y + height - 1) % tile_height;
-    } else {
-        start_tile_y = -(-y / tile_height);
-        end_tile_y = -(-(y + height - 1) / tile_height);
-        y_remainder = (y % tile_height + tile_height) % tile_height;
-        y_remainder_last = ((y + height - 1) % tile_height + tile_height) % tile_height;
+    int64_t start_tile_y = floor_div_i64(y, tile_height);
+    int64_t end_tile_y = floor_div_i64(y + height - 1, tile_height);
+    int64_t y_remainder = y - start_tile_y * tile_height;
+    int64_t y_remainder_last = (y + height - 1) - end_tile_y * tile_height;
+
+    int64_t request_count = (end_tile_x - start_tile_x + 1) * (end_tile_y - start_tile_y + 1);
+    if (requests == NULL) {
+        return request_count;
     }
 
-    // Allocate memory for tile pixels (will reuse for consecutive libisyntax_tile_read() calls)
-    uint32_t* tile_pixels = (uint32_t*)malloc(tile_width * tile_height * sizeof(uint32_t));
+    // For planar formats, this is the size of a pixel within one plane.
+    int32_t bytes_per_pixel = isyntax_pixel_format_packed_stride(pixel_format, 1);
+    size_t plane_stride = (size_t)stride_in_bytes * height;
 
-    // Read tiles and copy the relevant portion of each tile to the region
+    int64_t request_index = 0;
     for (int64_t tile_y = start_tile_y; tile_y <= end_tile_y; ++tile_y) {
         for (int64_t tile_x = start_tile_x; tile_x <= end_tile_x; ++tile_x) {
             // Calculate the portion of the tile to be copied
@@ -444,29 +552,400 @@ isyntax_error_t libisyntax_read_region(isyntax_t* isyntax, isyntax_cache_t* isyn
             int64_t copy_width = (tile_x == end_tile_x) ? x_remainder_last - src_x + 1 : tile_width - src_x;
             int64_t copy_height = (tile_y == end_tile_y) ? y_remainder_last - src_y + 1 : tile_height - src_y;
 
-            // Read tile
-            CHECK_LIBISYNTAX_OK(libisyntax_tile_read(isyntax, isyntax_cache, level, tile_x, tile_y, tile_pixels, pixel_format));
+            requests[request_index++] = (isyntax_tile_read_request_t){
+                .scale = level,
+                .tile_x = (int)tile_x,
+                .tile_y = (int)tile_y,
+                .pixels_buffer = (uint8_t*)pixels_buffer + dest_y * stride_in_bytes + dest_x * bytes_per_pixel,
+                .stride = stride_in_bytes,
+                .plane_stride = plane_stride,
+                .is_cropped = (copy_width != tile_width || copy_height != tile_height),
+                .src_x = (int)src_x,
+                .src_y = (int)src_y,
+                .width = (int)copy_width,
+                .height = (int)copy_height,
+            };
+        }
+    }
+    return request_count;
+}
 
-            // Copy the relevant portion of the tile to the region
-            for (int64_t i = 0; i < copy_height; ++i) {
-                int64_t dest_index = (dest_y + i) * width + dest_x;
-                int64_t src_index = (src_y + i) * tile_width + src_x;
-                memcpy((pixels_buffer) + dest_index,
-                       tile_pixels + src_index,
-                       copy_width * sizeof(uint32_t));
-            }
+isyntax_error_t libisyntax_read_region_with_stride(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
+                                                   int64_t x, int64_t y, int64_t width, int64_t height,
+                                                   uint32_t* pixels_buffer, int32_t stride_in_bytes,
+                                                   int32_t pixel_format) {
+
+    if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (width <= 0 || height <= 0) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (stride_in_bytes < (int64_t)isyntax_pixel_format_packed_stride(pixel_format, 1) * width) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+
+    // Get the level
+    ASSERT(level < isyntax->images[0].level_count);
+
+    int64_t request_count = libisyntax_get_region_requests(isyntax, level, x, y, width, height, pixels_buffer,
+                                                           stride_in_bytes, pixel_format, NULL);
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    arena_align(temp_memory.arena, 8);
+    isyntax_tile_read_request_t* requests = arena_push_array(temp_memory.arena, request_count, isyntax_tile_read_request_t);
+    libisyntax_get_region_requests(isyntax, level, x, y, width, height, pixels_buffer, stride_in_bytes, pixel_format,
+                                   requests);
+
+    if (isyntax_cache->parallel_region_reads) {
+        thread_pool_t* pool = isyntax->work_submission_pool ? isyntax->work_submission_pool : &global_thread_pool;
+        isyntax_tile_read_multiple(isyntax, isyntax_cache, requests, (int)request_count, pixel_format, pool);
+    } else {
+        for (int64_t i = 0; i < request_count; ++i) {
+            isyntax_tile_read_multiple(isyntax, isyntax_cache, &requests[i], 1, pixel_format, NULL);
+        }
+    }
+
+    release_temp_memory(&temp_memory);
+
+    return LIBISYNTAX_OK;
+}
+
+isyntax_error_t libisyntax_read_multiscale_patches(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                   int64_t x, int64_t y, int32_t patch_width, int32_t patch_height,
+                                                   const int32_t* levels, int32_t patch_count,
+                                                   uint32_t** pixels_buffers, int32_t pixel_format) {
+    if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (patch_width <= 0 || patch_height <= 0 || patch_count <= 0) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    for (int32_t i = 0; i < patch_count; ++i) {
+        if (levels[i] < 0 || levels[i] >= isyntax->images[0].level_count) {
+            return LIBISYNTAX_INVALID_ARGUMENT;
+        }
+    }
+    int32_t stride = isyntax_pixel_format_packed_stride(pixel_format, patch_width);
+
+    // All patches are read as one request, so that the levels above the lowest one get their pixels from the idwt
+    // that is needed to reconstruct the lowest level anyway.
+    int64_t request_count = 0;
+    for (int32_t i = 0; i < patch_count; ++i) {
+        int64_t patch_x = floor_div_i64(x, (int64_t)1 << levels[i]) - patch_width / 2;
+        int64_t patch_y = floor_div_i64(y, (int64_t)1 << levels[i]) - patch_height / 2;
+        request_count += libisyntax_get_region_requests(isyntax, levels[i], patch_x, patch_y, patch_width, patch_height,
+                                                        pixels_buffers[i], stride, pixel_format, NULL);
+    }
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    arena_align(temp_memory.arena, 8);
+    isyntax_tile_read_request_t* requests = arena_push_array(temp_memory.arena, request_count, isyntax_tile_read_request_t);
+    int64_t request_index = 0;
+    for (int32_t i = 0; i < patch_count; ++i) {
+        int64_t patch_x = floor_div_i64(x, (int64_t)1 << levels[i]) - patch_width / 2;
+        int64_t patch_y = floor_div_i64(y, (int64_t)1 << levels[i]) - patch_height / 2;
+        request_index += libisyntax_get_region_requests(isyntax, levels[i], patch_x, patch_y, patch_width, patch_height,
+                                                        pixels_buffers[i], stride, pixel_format,
+                                                        requests + request_index);
+    }
+
+    thread_pool_t* pool = NULL;
+    if (isyntax_cache->parallel_region_reads) {
+        pool = isyntax->work_submission_pool ? isyntax->work_submission_pool : &global_thread_pool;
+    }
+    isyntax_tile_read_multiple(isyntax, isyntax_cache, requests, (int)request_count, pixel_format, pool);
+
+    release_temp_memory(&temp_memory);
+    return LIBISYNTAX_OK;
+}
+
+typedef struct libisyntax_patch_order_t {
+    uint64_t key;
+    int32_t index;
+} libisyntax_patch_order_t;
+
+static int libisyntax_compare_patch_order(const void* a, const void* b) {
+    uint64_t key_a = ((const libisyntax_patch_order_t*)a)->key;
+    uint64_t key_b = ((const libisyntax_patch_order_t*)b)->key;
+    if (key_a != key_b) return (key_a < key_b) ? -1 : 1;
+    return ((const libisyntax_patch_order_t*)a)->index - ((const libisyntax_patch_order_t*)b)->index;
+}
+
+// Interleaves the bits of x and y (Z-order), so that tiles that are close together get keys that are close together.
+static uint64_t libisyntax_morton_key(uint32_t x, uint32_t y) {
+    uint64_t key = 0;
+    for (int i = 0; i < 32; ++i) {
+        key |= (uint64_t)((x >> i) & 1) << (2 * i);
+        key |= (uint64_t)((y >> i) & 1) << (2 * i + 1);
+    }
+    return key;
+}
+
+isyntax_error_t libisyntax_read_patches(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
+                                        const int64_t* coords, int32_t patch_count,
+                                        int32_t patch_width, int32_t patch_height,
+                                        void* out, int32_t layout, const float* mean, const float* std) {
+    if (level < 0 || level >= isyntax->images[0].level_count || patch_count < 0 ||
+        patch_width <= 0 || patch_height <= 0) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    bool is_planar = (layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_U8 || layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_F32);
+    bool is_float = (layout == LIBISYNTAX_PATCH_LAYOUT_NHWC_F32 || layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_F32);
+    if (!is_planar && !is_float && layout != LIBISYNTAX_PATCH_LAYOUT_NHWC_U8) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    // Normalization: (v / 255 - mean) / std, computed as v * scale + bias.
+    float scale[3];
+    float bias[3];
+    for (int c = 0; c < 3; ++c) {
+        float channel_mean = mean ? mean[c] : 0.0f;
+        float channel_std = std ? std[c] : 1.0f;
+        if (is_float && channel_std == 0.0f) {
+            return LIBISYNTAX_INVALID_ARGUMENT;
         }
+        scale[c] = 1.0f / (255.0f * channel_std);
+        bias[c] = -channel_mean / channel_std;
+    }
+    if (patch_count == 0) {
+        return LIBISYNTAX_OK;
     }
 
-    free(tile_pixels);
+    int32_t pixel_format = is_planar ? LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR : LIBISYNTAX_PIXEL_FORMAT_RGB;
+    int32_t stride = isyntax_pixel_format_packed_stride(pixel_format, patch_width);
+    size_t patch_size = (size_t)patch_width * patch_height * 3;
 
+    // Read the patches in order of the tiles they start in, so that patches that share tiles (and the tiles they
+    // depend on) are read together.
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    arena_align(temp_memory.arena, 8);
+    libisyntax_patch_order_t* order = arena_push_array(temp_memory.arena, patch_count, libisyntax_patch_order_t);
+    int32_t num_levels = isyntax->images[0].level_count;
+    int64_t offset = ((PER_LEVEL_PADDING << num_levels) - PER_LEVEL_PADDING) >> level;
+    for (int32_t i = 0; i < patch_count; ++i) {
+        int64_t tile_x = floor_div_i64(coords[2 * i] + offset, isyntax->tile_width);
+        int64_t tile_y = floor_div_i64(coords[2 * i + 1] + offset, isyntax->tile_height);
+        order[i].key = libisyntax_morton_key((uint32_t)MAX(0, tile_x), (uint32_t)MAX(0, tile_y));
+        order[i].index = i;
+    }
+    qsort(order, patch_count, sizeof(libisyntax_patch_order_t), libisyntax_compare_patch_order);
+
+    // The patches are read in batches of about max_batch_requests tiles, to limit how many tiles (and their
+    // dependencies) are reserved in the cache at the same time. With parallel region reads enabled, each batch is
+    // spread across the thread pool.
+    const int64_t max_batch_requests = 256;
+    thread_pool_t* pool = NULL;
+    if (isyntax_cache->parallel_region_reads) {
+        pool = isyntax->work_submission_pool ? isyntax->work_submission_pool : &global_thread_pool;
+    }
+    int64_t max_requests_per_patch = ((patch_width + isyntax->tile_width - 2) / isyntax->tile_width + 1) *
+                                     ((patch_height + isyntax->tile_height - 2) / isyntax->tile_height + 1);
+    isyntax_tile_read_request_t* requests = arena_push_array(temp_memory.arena,
+                                                             max_batch_requests + max_requests_per_patch,
+                                                             isyntax_tile_read_request_t);
+    // The 8-bit layouts are written straight into the output. For the float layouts, the 8-bit pixels of a patch are
+    // written to the last quarter of the memory of the patch, and converted in place after each batch.
+    int64_t request_count = 0;
+    int32_t batch_start = 0;
+    size_t plane_size = (size_t)patch_width * patch_height;
+    for (int32_t i = 0; i < patch_count; ++i) {
+        int32_t index = order[i].index;
+        uint8_t* patch_pixels = (uint8_t*)out + patch_size * index;
+        if (is_float) {
+            patch_pixels = (uint8_t*)((float*)out + patch_size * index) + 3 * patch_size;
+        }
+        request_count += libisyntax_get_region_requests(isyntax, level, coords[2 * index], coords[2 * index + 1],
+                                                        patch_width, patch_height, (uint32_t*)patch_pixels, stride,
+                                                        pixel_format, requests + request_count);
+        if (request_count >= max_batch_requests || i == patch_count - 1) {
+            isyntax_tile_read_multiple(isyntax, isyntax_cache, requests, (int)request_count, pixel_format, pool);
+            request_count = 0;
+            for (int32_t j = batch_start; is_float && j <= i; ++j) {
+                float* patch_dest = (float*)out + patch_size * order[j].index;
+                const uint8_t* src = (const uint8_t*)patch_dest + 3 * patch_size;
+                if (is_planar) {
+                    for (int c = 0; c < 3; ++c) {
+                        isyntax_kernels->normalize_u8_to_f32(src + c * plane_size, patch_dest + c * plane_size,
+                                                             plane_size, 1, &scale[c], &bias[c]);
+                    }
+                } else {
+                    isyntax_kernels->normalize_u8_to_f32(src, patch_dest, patch_size, 3, scale, bias);
+                }
+            }
+            batch_start = i + 1;
+        }
+    }
+    release_temp_memory(&temp_memory);
     return LIBISYNTAX_OK;
 }
 
+// Resampling filters for libisyntax_read_region_scaled(), as a function of the distance to the output sample (in
+// source pixels, or in output pixels when reducing).
+static double resample_filter_support(int32_t filter) {
+    switch (filter) {
+        default:
+        case LIBISYNTAX_RESAMPLE_FILTER_BOX: return 0.5;
+        case LIBISYNTAX_RESAMPLE_FILTER_BILINEAR: return 1.0;
+        case LIBISYNTAX_RESAMPLE_FILTER_LANCZOS: return 3.0;
+    }
+}
+
+static double resample_filter(int32_t filter, double x) {
+    switch (filter) {
+        default:
+        case LIBISYNTAX_RESAMPLE_FILTER_BOX: {
+            return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+        }
+        case LIBISYNTAX_RESAMPLE_FILTER_BILINEAR: {
+            x = fabs(x);
+            return (x < 1.0) ? 1.0 - x : 0.0;
+        }
+        case LIBISYNTAX_RESAMPLE_FILTER_LANCZOS: {
+            if (x == 0.0) return 1.0;
+            if (x <= -3.0 || x >= 3.0) return 0.0;
+            double px = M_PI * x;
+            return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+        }
+    }
+}
+
+typedef struct resample_axis_t {
+    int64_t source_start; // first source pixel that is needed
+    int32_t source_length;
+    int32_t tap_count;
+    int32_t* starts;      // for each output pixel, its first source pixel (relative to source_start)
+    int16_t* weights;     // for each output pixel, tap_count weights (RESAMPLE_WEIGHT_BITS fixed point)
+} resample_axis_t;
+
+// Computes the filter weights along one axis. start and scale (source pixels per output pixel) are in pixels of the
+// level that is read from.
+static void resample_axis_init(resample_axis_t* axis, arena_t* arena, double start, double scale, int32_t out_length,
+                               int32_t filter) {
+    double filter_scale = MAX(scale, 1.0);
+    double support = resample_filter_support(filter) * filter_scale;
+    int32_t tap_count = (int32_t)ceil(support * 2.0) + 2;
+    tap_count += tap_count & 1; // the vertical pass processes pairs of rows
+    axis->tap_count = tap_count;
+    arena_align(arena, 8);
+    double* w = arena_push_array(arena, tap_count, double);
+    axis->starts = arena_push_array(arena, out_length, int32_t);
+    axis->weights = arena_push_array(arena, (size_t)out_length * tap_count, int16_t);
+
+    for (int32_t i = 0; i < out_length; ++i) {
+        double center = start + (i + 0.5) * scale;
+        int64_t first = (int64_t)floor(center - support - 0.5);
+        if (i == 0) {
+            axis->source_start = first;
+        }
+        axis->starts[i] = (int32_t)(first - axis->source_start);
+
+        double sum = 0.0;
+        int32_t largest = 0;
+        for (int32_t k = 0; k < tap_count; ++k) {
+            w[k] = resample_filter(filter, ((double)(first + k) + 0.5 - center) / filter_scale);
+            sum += w[k];
+            if (w[k] > w[largest]) largest = k;
+        }
+        // Normalize, and make the rounded weights add up to exactly 1.0 so that flat areas stay flat.
+        int16_t* weights = axis->weights + (size_t)i * tap_count;
+        int32_t fixed_sum = 0;
+        for (int32_t k = 0; k < tap_count; ++k) {
+            weights[k] = (int16_t)lround(w[k] / sum * (1 << RESAMPLE_WEIGHT_BITS));
+            fixed_sum += weights[k];
+        }
+        weights[largest] += (int16_t)((1 << RESAMPLE_WEIGHT_BITS) - fixed_sum);
+    }
+    axis->source_length = axis->starts[out_length - 1] + tap_count;
+}
+
+isyntax_error_t libisyntax_read_region_scaled(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                              double x, double y, double width, double height,
+                                              int32_t out_width, int32_t out_height, uint32_t* pixels_buffer,
+                                              int32_t pixel_format, int32_t filter) {
+    int32_t channels = 0;
+    int32_t plane_count = 1;
+    switch (pixel_format) {
+        case LIBISYNTAX_PIXEL_FORMAT_RGBA:
+        case LIBISYNTAX_PIXEL_FORMAT_BGRA: channels = 4; break;
+        case LIBISYNTAX_PIXEL_FORMAT_RGB:
+        case LIBISYNTAX_PIXEL_FORMAT_BGR: channels = 3; break;
+        case LIBISYNTAX_PIXEL_FORMAT_GRAY8: channels = 1; break;
+        case LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR: channels = 1; plane_count = 3; break;
+        default: return LIBISYNTAX_INVALID_ARGUMENT; // RGB48 is not supported
+    }
+    if (filter != LIBISYNTAX_RESAMPLE_FILTER_BOX && filter != LIBISYNTAX_RESAMPLE_FILTER_BILINEAR &&
+        filter != LIBISYNTAX_RESAMPLE_FILTER_LANCZOS) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+    if (!(width > 0.0 && height > 0.0) || out_width <= 0 || out_height <= 0) {
+        return LIBISYNTAX_INVALID_ARGUMENT;
+    }
+
+    // Read from the lowest resolution level that still has at least as many pixels as the output, so that the filter
+    // only has to reduce by less than a factor 2 (or enlarge).
+    double scale_x = width / out_width;
+    double scale_y = height / out_height;
+    double min_scale = MIN(scale_x, scale_y);
+    int32_t level_count = isyntax->images[0].level_count;
+    int32_t level = 0;
+    while (level + 1 < level_count && (double)((int64_t)1 << (level + 1)) <= min_scale * (1.0 + 1e-9)) {
+        ++level;
+    }
+    double level_scale = (double)((int64_t)1 << level);
+
+    temp_memory_t temp_memory = begin_temp_memory_on_local_thread();
+    resample_axis_t axis_x, axis_y;
+    resample_axis_init(&axis_x, temp_memory.arena, x / level_scale, scale_x / level_scale, out_width, filter);
+    resample_axis_init(&axis_y, temp_memory.arena, y / level_scale, scale_y / level_scale, out_height, filter);
+
+    // The horizontal pass reads 4 bytes per pixel for 3 channels (and writes 4 values), and 4 bytes per pair of pixels
+    // for 1 channel, hence the padding.
+    int32_t source_stride = axis_x.source_length * channels;
+    size_t source_plane_size = (size_t)source_stride * axis_y.source_length;
+    int32_t intermediate_stride = out_width * channels + 1;
+    size_t intermediate_size = (size_t)intermediate_stride * axis_y.source_length;
+    u8* source = (u8*)malloc(source_plane_size * plane_count + 4);
+    i16* intermediate = (i16*)malloc(intermediate_size * sizeof(i16));
+    if (!source || !intermediate) {
+        free(source);
+        free(intermediate);
+        release_temp_memory(&temp_memory);
+        return LIBISYNTAX_FATAL;
+    }
+
+    isyntax_error_t result = libisyntax_read_region_with_stride(isyntax, isyntax_cache, level, axis_x.source_start,
+                                                                axis_y.source_start, axis_x.source_length,
+                                                                axis_y.source_length, (uint32_t*)source,
+                                                                source_stride, pixel_format);
+    if (result == LIBISYNTAX_OK) {
+        int32_t out_stride = out_width * channels;
+        for (int32_t plane = 0; plane < plane_count; ++plane) {
+            u8* source_plane = source + plane * source_plane_size;
+            u8* out_plane = (u8*)pixels_buffer + (size_t)plane * out_stride * out_height;
+            for (int32_t row = 0; row < axis_y.source_length; ++row) {
+                isyntax_kernels->resample_horizontal_row(source_plane + (size_t)row * source_stride,
+                                                         intermediate + (size_t)row * intermediate_stride,
+                                                         out_width, channels, axis_x.starts, axis_x.weights,
+                                                         axis_x.tap_count);
+            }
+            for (int32_t row = 0; row < out_height; ++row) {
+                isyntax_kernels->resample_vertical_row(intermediate + (size_t)axis_y.starts[row] * intermediate_stride,
+                                                       intermediate_stride,
+                                                       axis_y.weights + (size_t)row * axis_y.tap_count,
+                                                       axis_y.tap_count, out_stride,
+                                                       out_plane + (size_t)row * out_stride);
+            }
+        }
+    }
+
+    free(source);
+    free(intermediate);
+    release_temp_memory(&temp_memory);
+    return result;
+}
+
 // TODO(pvalkema): remove this / only support returning compressed JPEG buffer and leave decompression to caller?
 static isyntax_error_t libisyntax_read_associated_image(isyntax_t* isyntax, isyntax_image_t* image, int32_t* width, int32_t* height,
                                                         uint32_t** pixels_buffer, int32_t pixel_format) {
-    if (pixel_format <= _LIBISYNTAX_PIXEL_FORMAT_START || pixel_format >= _LIBISYNTAX_PIXEL_FORMAT_END) {
+    if (pixel_format != LIBISYNTAX_PIXEL_FORMAT_RGBA && pixel_format != LIBISYNTAX_PIXEL_FORMAT_BGRA) {
         return LIBISYNTAX_INVALID_ARGUMENT;
     }
     uint32_t* pixels = (uint32_t*)isyntax_get_associated_image_pixels(isyntax, image, pixel_format);
@@ -28,10 +28,21 @@ typedef int32_t isyntax_error_t;
 // One of the arguments passed to a function is invalid.
 #define LIBISYNTAX_INVALID_ARGUMENT 2
 
+// Pixel formats for tile and region reads. Unless noted otherwise, channels are 8 bits.
+// Use libisyntax_pixel_format_get_bytes_per_pixel() to size the buffers.
 enum isyntax_pixel_format_t {
   _LIBISYNTAX_PIXEL_FORMAT_START = 0x100,
   LIBISYNTAX_PIXEL_FORMAT_RGBA,
   LIBISYNTAX_PIXEL_FORMAT_BGRA,
+  LIBISYNTAX_PIXEL_FORMAT_RGB,        // packed, 3 bytes per pixel
+  LIBISYNTAX_PIXEL_FORMAT_BGR,        // packed, 3 bytes per pixel
+  LIBISYNTAX_PIXEL_FORMAT_GRAY8,      // the Y (luminance) channel of the YCoCg color space, 1 byte per pixel (only Y is decoded)
+  LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR, // a full plane of R, then G, then B (each width * height bytes)
+  LIBISYNTAX_PIXEL_FORMAT_RGB48,      // packed, 16 bits per channel (uint16_t, native endianness), scaled to 0..65535
+  // A full plane of Y, then Co, then Cg (each width * height int16_t values), exactly as reconstructed by the inverse
+  // wavelet transform: no color conversion and no clamping. The luminance is the absolute value of Y (this is what the
+  // RGB formats use). Not supported by libisyntax_read_region_scaled().
+  LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR,
   _LIBISYNTAX_PIXEL_FORMAT_END,
 };
 
@@ -54,7 +65,23 @@ isyntax_error_t libisyntax_init(void);
 isyntax_error_t libisyntax_open(const char* filename, enum libisyntax_open_flags_t flags, isyntax_t** out_isyntax);
 void            libisyntax_close(isyntax_t* isyntax);
 
+// The SIMD kernels (bitplane reassembly, IDWT, color conversion) are built for several instruction set levels, and
+// libisyntax_init() selects the highest one the CPU supports. To force a lower level (e.g. for benchmarking or
+// debugging), set the environment variable LIBISYNTAX_SIMD_LEVEL to one of: scalar, sse2, ssse3, avx2, avx512, neon,
+// or call libisyntax_set_simd_level() after libisyntax_init(), before any tiles are being decoded.
+// Setting a level that is not built for this architecture or not supported by the CPU returns LIBISYNTAX_INVALID_ARGUMENT.
+#define LIBISYNTAX_SIMD_LEVEL_SCALAR 0
+#define LIBISYNTAX_SIMD_LEVEL_SSE2 1
+#define LIBISYNTAX_SIMD_LEVEL_SSSE3 2
+#define LIBISYNTAX_SIMD_LEVEL_AVX2 3
+#define LIBISYNTAX_SIMD_LEVEL_AVX512 4
+#define LIBISYNTAX_SIMD_LEVEL_NEON 5
+isyntax_error_t libisyntax_set_simd_level(int32_t simd_level);
+int32_t         libisyntax_get_simd_level(void);
+
 //== Getters API ==
+// Returns the size of one pixel in the given pixel format, or 0 if the pixel format is invalid.
+int32_t                libisyntax_pixel_format_get_bytes_per_pixel(int32_t pixel_format);
 int32_t                libisyntax_get_tile_width(const isyntax_t* isyntax);
 int32_t                libisyntax_get_tile_height(const isyntax_t* isyntax);
 const isyntax_image_t* libisyntax_get_wsi_image(const isyntax_t* isyntax);
@@ -109,21 +136,108 @@ isyntax_error_t libisyntax_cache_inject(isyntax_cache_t* isyntax_cache, isyntax_
 // TODO(avirodov): currently flushes all cache, isyntax_or_null is unused.
 void            libisyntax_cache_flush(isyntax_cache_t* isyntax_cache, isyntax_t* isyntax_or_null);
 void            libisyntax_cache_destroy(isyntax_cache_t* isyntax_cache);
+// Sets the decode quality for tiles read through this cache: LIBISYNTAX_DECODE_QUALITY_FULL (the default), or a number
+// N between 1 and 15 to decode only the N most significant magnitude bitplanes of the high-pass wavelet coefficients.
+// Reduced quality decodes faster but is lossy, e.g. for fast previews. Coefficients decoded this way are marked as
+// approximate in the cache: they are only reused at the same quality, and decoded again when full quality is requested.
+// Note: slides using the older (v1) codeblock compressor are always decoded at full quality. Codeblocks that don't have
+// more bitplanes than requested are complete, and are kept as full quality as well.
+#define LIBISYNTAX_DECODE_QUALITY_FULL 0
+isyntax_error_t libisyntax_cache_set_decode_quality(isyntax_cache_t* isyntax_cache, int32_t h_bitplane_count);
+int32_t         libisyntax_cache_get_decode_quality(const isyntax_cache_t* isyntax_cache);
+// Sets which LL (low-pass) coefficients are kept when a tile is reconstructed from the levels above it. Every IDWT
+// produces the LL coefficients of four child tiles at the next level.
+// - LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL (the default): all of them are stored in the cache, which makes reading the
+//   neighboring tiles cheaper later on.
+// - LIBISYNTAX_LL_CACHE_POLICY_REQUIRED_ONLY: only the LL coefficients that the requested tile depends on are stored.
+//   This lowers the latency and memory use of reads that start from a cold cache (e.g. random access).
+#define LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL 0
+#define LIBISYNTAX_LL_CACHE_POLICY_REQUIRED_ONLY 1
+isyntax_error_t libisyntax_cache_set_ll_policy(isyntax_cache_t* isyntax_cache, int32_t ll_policy);
+int32_t         libisyntax_cache_get_ll_policy(const isyntax_cache_t* isyntax_cache);
+// If enabled, libisyntax_read_region() reads the tiles of the region in parallel on the library's worker threads
+// (the calling thread joins in). The levels above are still transformed only once. Disabled by default.
+isyntax_error_t libisyntax_cache_set_parallel_region_reads(isyntax_cache_t* isyntax_cache, int32_t enabled);
+int32_t         libisyntax_cache_get_parallel_region_reads(const isyntax_cache_t* isyntax_cache);
 
 
 //== Tile API ==
-// Reads a tile into a user-supplied buffer. Buffer size should be [tile_width * tile_height * 4], as returned by
-// `libisyntax_get_tile_width()`/`libisyntax_get_tile_height()`. The caller is responsible for managing the buffer
+// Reads a tile into a user-supplied buffer. Buffer size should be [tile_width * tile_height * bytes_per_pixel], as
+// returned by `libisyntax_get_tile_width()`/`libisyntax_get_tile_height()` and
+// `libisyntax_pixel_format_get_bytes_per_pixel()`. The caller is responsible for managing the buffer
 // allocation/deallocation.
-// pixel_format is one of isyntax_pixel_format_t.
+// pixel_format is one of isyntax_pixel_format_t. For formats other than RGBA/BGRA, pixels_buffer is reinterpreted
+// accordingly (e.g. as uint8_t* for RGB).
 isyntax_error_t libisyntax_tile_read(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
                                      int32_t level, int64_t tile_x, int64_t tile_y,
                                      uint32_t* pixels_buffer, int32_t pixel_format);
 isyntax_error_t libisyntax_read_region(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
                                        int64_t x, int64_t y, int64_t width, int64_t height, uint32_t* pixels_buffer,
                                        int32_t pixel_format);
-
-
+// Same as above, but the rows of pixels_buffer are stride_in_bytes apart, so that tiles and regions can be written
+// straight into a larger buffer (e.g. a texture atlas or canvas). The stride must be at least the size of one row of
+// pixels. For the planar formats, the stride applies to the rows within each plane, and the planes
+// are [stride_in_bytes * height] bytes apart.
+// Both region reads return LIBISYNTAX_INVALID_ARGUMENT for an empty region (width or height <= 0).
+isyntax_error_t libisyntax_tile_read_with_stride(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                 int32_t level, int64_t tile_x, int64_t tile_y,
+                                                 uint32_t* pixels_buffer, int32_t stride_in_bytes, int32_t pixel_format);
+isyntax_error_t libisyntax_read_region_with_stride(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
+                                                   int64_t x, int64_t y, int64_t width, int64_t height,
+                                                   uint32_t* pixels_buffer, int32_t stride_in_bytes,
+                                                   int32_t pixel_format);
+// Reads the raw wavelet coefficients of a tile instead of its pixels: the LL block and the HL, LH and HH blocks from
+// which the tile is reconstructed. Each block is (tile_width / 2) x (tile_height / 2) int16_t values, for Y, Co and Cg:
+// - ll_buffer: [3][tile_height / 2][tile_width / 2]
+// - h_buffer: [3][3][tile_height / 2][tile_width / 2] (HL, LH, HH for each color channel)
+// Either buffer may be NULL. The LL coefficients of tiles below the top level are reconstructed from the parent tiles,
+// which are kept in the cache like for a regular read. Missing coefficients are 0, except for LL of Y (255, white).
+// The coefficients are decoded at the decode quality of the cache: at reduced quality, the H blocks hold only the most
+// significant bitplanes (and the LL blocks below the top level derive from those). Use LIBISYNTAX_DECODE_QUALITY_FULL
+// (the default) to get the exact coefficients.
+isyntax_error_t libisyntax_tile_read_coefficients(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                  int32_t level, int64_t tile_x, int64_t tile_y,
+                                                  int16_t* ll_buffer, int16_t* h_buffer);
+// Reads patches of patch_width x patch_height pixels centered on the same point at several levels, e.g. for
+// multi-resolution models. (x, y) is in pixels of level 0; the patch at level L starts at
+// ((x >> L) - patch_width / 2, (y >> L) - patch_height / 2). pixels_buffers[i] receives the patch at levels[i]
+// (packed, patch_width * patch_height pixels). All patches are read in one pass: the levels above the lowest one get
+// their pixels from the decoding work that the lowest one needs anyway.
+isyntax_error_t libisyntax_read_multiscale_patches(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                                   int64_t x, int64_t y, int32_t patch_width, int32_t patch_height,
+                                                   const int32_t* levels, int32_t patch_count,
+                                                   uint32_t** pixels_buffers, int32_t pixel_format);
+// Reads a batch of patch_count patches of patch_width x patch_height RGB pixels at one level into one contiguous
+// buffer, e.g. as input for a neural network. coords holds the top left corner (x, y) of each patch, in pixels of the
+// level (the same as for libisyntax_read_region()). The output layout is one of:
+// - LIBISYNTAX_PATCH_LAYOUT_NHWC_U8: uint8_t [patch_count][patch_height][patch_width][3]
+// - LIBISYNTAX_PATCH_LAYOUT_NCHW_U8: uint8_t [patch_count][3][patch_height][patch_width]
+// - LIBISYNTAX_PATCH_LAYOUT_NHWC_F32 / _NCHW_F32: the same as float, normalized per channel as
+//   (v / 255 - mean[c]) / std[c]. mean and std may be NULL (0 and 1); they are ignored for the uint8_t layouts.
+// The patches are read in order of their location in the slide (not in the order given), spread across the library's
+// worker threads if enabled with libisyntax_cache_set_parallel_region_reads().
+#define LIBISYNTAX_PATCH_LAYOUT_NHWC_U8 0
+#define LIBISYNTAX_PATCH_LAYOUT_NCHW_U8 1
+#define LIBISYNTAX_PATCH_LAYOUT_NHWC_F32 2
+#define LIBISYNTAX_PATCH_LAYOUT_NCHW_F32 3
+isyntax_error_t libisyntax_read_patches(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache, int32_t level,
+                                        const int64_t* coords, int32_t patch_count,
+                                        int32_t patch_width, int32_t patch_height,
+                                        void* out, int32_t layout, const float* mean, const float* std);
+// Reads the region [x, x + width) x [y, y + height) (in pixels of level 0, fractions allowed) resampled to
+// out_width x out_height pixels, at an arbitrary scale. The pixels are read from the lowest resolution level that has
+// at least as many pixels as the output, then filtered. pixels_buffer is packed (out_width * out_height pixels).
+// Supports the 8-bit pixel formats (not LIBISYNTAX_PIXEL_FORMAT_RGB48 or LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR).
+#define LIBISYNTAX_RESAMPLE_FILTER_BOX 0
+#define LIBISYNTAX_RESAMPLE_FILTER_BILINEAR 1
+#define LIBISYNTAX_RESAMPLE_FILTER_LANCZOS 2 // Lanczos3
+isyntax_error_t libisyntax_read_region_scaled(isyntax_t* isyntax, isyntax_cache_t* isyntax_cache,
+                                              double x, double y, double width, double height,
+                                              int32_t out_width, int32_t out_height, uint32_t* pixels_buffer,
+                                              int32_t pixel_format, int32_t filter);
+
+
+// The label and macro images only support LIBISYNTAX_PIXEL_FORMAT_RGBA and LIBISYNTAX_PIXEL_FORMAT_BGRA.
 isyntax_error_t libisyntax_read_label_image(isyntax_t* isyntax, int32_t* width, int32_t* height,
                                                    uint32_t** pixels_buffer, int32_t pixel_format);
 isyntax_error_t libisyntax_read_macro_image(isyntax_t* isyntax, int32_t* width, int32_t* height,
@@ -83,6 +83,12 @@ static inline u32 bit_scan_forward(u32 x) {
 	return (u32) first_bit;
 }
 
+static inline u32 bit_scan_forward_64(u64 x) {
+	unsigned long first_bit = 0;
+	_BitScanForward64(&first_bit, x);
+	return (u32) first_bit;
+}
+
 #elif APPLE
 #define OSATOMIC_USE_INLINED 1
 #include <libkern/OSAtomic.h>
@@ -115,6 +121,10 @@ static inline u32 bit_scan_forward(u32 x) {
 	return __builtin_ctz(x);
 }
 
+static inline u32 bit_scan_forward_64(u64 x) {
+	return __builtin_ctzll(x);
+}
+
 #else
 //TODO: implement
 #define write_barrier
@@ -149,6 +159,10 @@ static inline u32 bit_scan_forward(u32 x) {
 	return __builtin_ctz(x);
 }
 
+static inline u32 bit_scan_forward_64(u64 x) {
+	return __builtin_ctzll(x);
+}
+
 #endif
 
 // see:
@@ -331,12 +345,21 @@ static inline u64 read_u64_endian(const void* src, bool data_is_big_endian) {
 static inline i32 popcount(u32 x) {
     return __builtin_popcount(x);
 }
+static inline i32 popcount_64(u64 x) {
+    return __builtin_popcountll(x);
+}
 #elif COMPILER_MSVC
 static inline i32 popcount(u32 x) {
 	return __popcnt(x);
 }
+static inline i32 popcount_64(u64 x) {
+	return (i32)__popcnt64(x);
+}
 #else
 static inline i32 popcount(u32 x) {
     return __builtin_popcount(x);
 }
+static inline i32 popcount_64(u64 x) {
+    return __builtin_popcountll(x);
+}
 #endif
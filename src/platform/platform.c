@@ -219,6 +219,7 @@ void init_thread_memory(system_info_t* system_info) {
 
 void destroy_thread_memory(void) {
 	if (threadlocal_thread_memory != NULL) {
+		free(threadlocal_thread_memory->huffman_table_cache);
 		free(threadlocal_thread_memory);
         threadlocal_thread_memory = NULL;
 	}
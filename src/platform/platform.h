@@ -92,6 +92,7 @@ typedef struct {
 	void* aligned_rest_of_thread_memory;
 	u32 pbo;
 	arena_t temp_arena;
+	void* huffman_table_cache; // per-thread cache of the codeblock decoder (malloc'ed), freed with the thread memory
 } thread_memory_t;
 
 typedef struct system_info_t {
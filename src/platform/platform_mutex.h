@@ -55,11 +55,25 @@ typedef struct platform_mutex_t {
 #define PLATFORM_MUTEX_INITIALIZER { PTHREAD_MUTEX_INITIALIZER }
 #endif
 
+typedef struct platform_cond_t {
+#ifdef _WIN32
+	CONDITION_VARIABLE cond;
+#else
+	pthread_cond_t cond;
+#endif
+} platform_cond_t;
+
 void platform_mutex_init(platform_mutex_t* mutex);
 void platform_mutex_destroy(platform_mutex_t* mutex);
 void platform_mutex_lock(platform_mutex_t* mutex);
 void platform_mutex_unlock(platform_mutex_t* mutex);
 
+void platform_cond_init(platform_cond_t* cond);
+void platform_cond_destroy(platform_cond_t* cond);
+// Unlocks the mutex while waiting, and locks it again before returning. May return spuriously.
+void platform_cond_wait(platform_cond_t* cond, platform_mutex_t* mutex);
+void platform_cond_broadcast(platform_cond_t* cond);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,395 @@
+// Benchmarks for the decoding stages of libisyntax, on real codeblocks.
+// A corpus of raw codeblocks (LL and H) is first captured from one or more slides into a single file, so that
+// decoder changes can be validated without needing the (multi-GB) slides themselves.
+// Usage:
+//   codeblock_corpus_benchmark capture <corpus_file> <slide.isyntax> [<slide.isyntax> ...]
+//   codeblock_corpus_benchmark run <corpus_file> [iterations]
+
+#include "common.h"
+#include "platform.h"
+#include "libisyntax.h"
+#include "isyntax.h"
+#include "timerutils.h"
+
+#include <stdio.h>
+
+#define CORPUS_MAGIC "ISYNCBC1"
+#define CORPUS_MAX_BLOCKS_PER_KIND 2000 // per slide, for each of LL and H
+#define CORPUS_MAX_BLOCK_SIZE MEGABYTES(1)
+#define CORPUS_BLOCK_PADDING 8 // the decoder reads up to 8 bytes past the end of a codeblock
+#define COLD_CACHE_EVICTION_SIZE MEGABYTES(64)
+#define COLD_CACHE_MAX_SAMPLES 256
+
+typedef struct corpus_entry_header_t {
+	u8 coefficient; // 0 = LL, 1 = H
+	u8 compressor_version;
+	u8 scale;
+	u8 color_component;
+	u16 block_width;
+	u16 block_height;
+	u32 size;
+} corpus_entry_header_t;
+
+typedef struct corpus_entry_t {
+	corpus_entry_header_t header;
+	u8* data;
+} corpus_entry_t;
+
+typedef struct corpus_t {
+	corpus_entry_t* entries;
+	i32 entry_count;
+} corpus_t;
+
+// Capture
+
+static i32 capture_codeblocks_from_slide(FILE* fp, const char* filename) {
+	isyntax_t* isyntax = NULL;
+	if (libisyntax_open(filename, 0, &isyntax) != LIBISYNTAX_OK) {
+		printf("could not open %s\n", filename);
+		return -1;
+	}
+	isyntax_image_t* wsi = isyntax->images + isyntax->wsi_image_index;
+	u8* buffer = (u8*)malloc(CORPUS_MAX_BLOCK_SIZE);
+	i32 captured_count = 0;
+	for (u32 coefficient = 0; coefficient <= 1; ++coefficient) {
+		i32 available_count = 0;
+		for (i32 i = 0; i < wsi->codeblock_count; ++i) {
+			isyntax_codeblock_t* codeblock = wsi->codeblocks + i;
+			if (codeblock->coefficient == coefficient && codeblock->block_size > 0 &&
+			    codeblock->block_size <= CORPUS_MAX_BLOCK_SIZE) {
+				++available_count;
+			}
+		}
+		// Sample evenly over the whole slide, so that all scales and colors are represented.
+		i32 step = MAX(1, available_count / CORPUS_MAX_BLOCKS_PER_KIND);
+		i32 available_index = 0;
+		for (i32 i = 0; i < wsi->codeblock_count; ++i) {
+			isyntax_codeblock_t* codeblock = wsi->codeblocks + i;
+			if (codeblock->coefficient != coefficient || codeblock->block_size == 0 ||
+			    codeblock->block_size > CORPUS_MAX_BLOCK_SIZE) {
+				continue;
+			}
+			if (available_index++ % step != 0) continue;
+			size_t bytes_read = file_handle_read_at_offset(buffer, isyntax->file_handle, codeblock->block_data_offset,
+			                                               codeblock->block_size);
+			if (bytes_read != codeblock->block_size) continue;
+			corpus_entry_header_t header = {
+				.coefficient = (u8)coefficient,
+				.compressor_version = (u8)wsi->compressor_version,
+				.scale = (u8)codeblock->scale,
+				.color_component = (u8)codeblock->color_component,
+				.block_width = (u16)isyntax->block_width,
+				.block_height = (u16)isyntax->block_height,
+				.size = (u32)codeblock->block_size,
+			};
+			fwrite(&header, sizeof(header), 1, fp);
+			fwrite(buffer, codeblock->block_size, 1, fp);
+			++captured_count;
+		}
+	}
+	printf("%s: captured %d codeblocks (compressor version %d)\n", filename, captured_count, wsi->compressor_version);
+	free(buffer);
+	libisyntax_close(isyntax);
+	return captured_count;
+}
+
+static bool capture_corpus(const char* corpus_filename, const char** slide_filenames, i32 slide_count) {
+	FILE* fp = fopen(corpus_filename, "wb");
+	if (!fp) {
+		printf("could not open %s for writing\n", corpus_filename);
+		return false;
+	}
+	u32 entry_count = 0;
+	fwrite(CORPUS_MAGIC, 8, 1, fp);
+	fwrite(&entry_count, sizeof(entry_count), 1, fp);
+	for (i32 i = 0; i < slide_count; ++i) {
+		i32 captured_count = capture_codeblocks_from_slide(fp, slide_filenames[i]);
+		if (captured_count > 0) entry_count += captured_count;
+	}
+	fseek(fp, 8, SEEK_SET);
+	fwrite(&entry_count, sizeof(entry_count), 1, fp);
+	fclose(fp);
+	printf("wrote %u codeblocks to %s\n", entry_count, corpus_filename);
+	return entry_count > 0;
+}
+
+static bool load_corpus(corpus_t* corpus, const char* corpus_filename) {
+	FILE* fp = fopen(corpus_filename, "rb");
+	if (!fp) {
+		printf("could not open %s\n", corpus_filename);
+		return false;
+	}
+	char magic[8] = {0};
+	u32 entry_count = 0;
+	if (fread(magic, 8, 1, fp) != 1 || memcmp(magic, CORPUS_MAGIC, 8) != 0 ||
+	    fread(&entry_count, sizeof(entry_count), 1, fp) != 1) {
+		printf("%s is not a codeblock corpus\n", corpus_filename);
+		fclose(fp);
+		return false;
+	}
+	corpus->entries = (corpus_entry_t*)calloc(entry_count, sizeof(corpus_entry_t));
+	corpus->entry_count = 0;
+	for (u32 i = 0; i < entry_count; ++i) {
+		corpus_entry_t* entry = corpus->entries + corpus->entry_count;
+		if (fread(&entry->header, sizeof(entry->header), 1, fp) != 1 || entry->header.size > CORPUS_MAX_BLOCK_SIZE) break;
+		entry->data = (u8*)calloc(1, entry->header.size + CORPUS_BLOCK_PADDING);
+		if (fread(entry->data, entry->header.size, 1, fp) != 1) {
+			free(entry->data);
+			break;
+		}
+		++corpus->entry_count;
+	}
+	fclose(fp);
+	if (corpus->entry_count != (i32)entry_count) {
+		printf("warning: %s is truncated (%d of %u codeblocks read)\n", corpus_filename, corpus->entry_count, entry_count);
+	}
+	return corpus->entry_count > 0;
+}
+
+static void free_corpus(corpus_t* corpus) {
+	for (i32 i = 0; i < corpus->entry_count; ++i) {
+		free(corpus->entries[i].data);
+	}
+	free(corpus->entries);
+	corpus->entries = NULL;
+	corpus->entry_count = 0;
+}
+
+// Benchmarks
+
+// Push the working set out of the CPU caches, for the 'cold' measurements.
+static u8* eviction_buffer;
+static void evict_caches(void) {
+	for (size_t i = 0; i < COLD_CACHE_EVICTION_SIZE; i += 64) {
+		eviction_buffer[i] += 1;
+	}
+}
+
+static void print_result(const char* name, const char* cache_state, double seconds, i64 bytes, i64 coeff_count) {
+	printf("  %-24s %-5s %12.1f MB/s %10.3f ns/coeff\n", name, cache_state,
+	       (double)bytes / (1024.0 * 1024.0) / seconds, seconds * 1e9 / (double)coeff_count);
+}
+
+static i32 get_coeff_count(corpus_entry_header_t* header) {
+	return ((header->coefficient == 1) ? 3 : 1) * header->block_width * header->block_height;
+}
+
+// Codeblock decompression, per kind of codeblock. Throughput is measured in compressed bytes.
+static bool benchmark_decompress(corpus_t* corpus, i32 iterations) {
+	i16* decoded = (i16*)malloc(3 * 256 * 256 * sizeof(i16));
+	bool ok = true;
+	printf("codeblock decompression (throughput of compressed input):\n");
+	for (i32 version = 1; version <= 2; ++version) {
+		for (i32 coefficient = 0; coefficient <= 1; ++coefficient) {
+			char name[64];
+			snprintf(name, sizeof(name), "v%d %s", version, coefficient ? "H" : "LL");
+			i64 warm_ticks = 0, warm_bytes = 0, warm_coeffs = 0;
+			i64 cold_ticks = 0, cold_bytes = 0, cold_coeffs = 0;
+			i32 block_count = 0;
+			for (i32 i = 0; i < corpus->entry_count; ++i) {
+				corpus_entry_t* entry = corpus->entries + i;
+				corpus_entry_header_t* h = &entry->header;
+				if (h->compressor_version != version || h->coefficient != coefficient) continue;
+				if (h->block_width > 256 || h->block_height > 256) continue;
+				i32 coeff_count = get_coeff_count(h);
+				if (block_count++ < COLD_CACHE_MAX_SAMPLES) {
+					evict_caches();
+					i64 start = get_clock();
+					if (!isyntax_hulsken_decompress(entry->data, h->size, h->block_width, h->block_height,
+					                                h->coefficient, h->compressor_version, decoded)) {
+						ok = false;
+					}
+					cold_ticks += get_clock() - start;
+					cold_bytes += h->size;
+					cold_coeffs += coeff_count;
+				}
+				i64 start = get_clock();
+				for (i32 j = 0; j < iterations; ++j) {
+					isyntax_hulsken_decompress(entry->data, h->size, h->block_width, h->block_height,
+					                           h->coefficient, h->compressor_version, decoded);
+				}
+				warm_ticks += get_clock() - start;
+				warm_bytes += (i64)h->size * iterations;
+				warm_coeffs += (i64)coeff_count * iterations;
+			}
+			if (block_count == 0) continue;
+			printf("  %s: %d codeblocks\n", name, block_count);
+			print_result(name, "warm", get_seconds_elapsed(0, warm_ticks), warm_bytes, warm_coeffs);
+			print_result(name, "cold", get_seconds_elapsed(0, cold_ticks), cold_bytes, cold_coeffs);
+		}
+	}
+	free(decoded);
+	return ok;
+}
+
+// Decode a LL and a H codeblock of the same size into the four quadrants of an IDWT buffer (with the same padding
+// as used when loading tiles, but without sampling the margins from adjacent tiles).
+static bool prepare_idwt_input(corpus_t* corpus, i32 start_index, icoeff_t* idwt, i32* block_width, i32* block_height) {
+	corpus_entry_t* ll = NULL;
+	corpus_entry_t* h = NULL;
+	for (i32 i = 0; i < corpus->entry_count && !(ll && h); ++i) {
+		corpus_entry_t* entry = corpus->entries + (start_index + i) % corpus->entry_count;
+		if (entry->header.block_width > 256 || entry->header.block_height > 256) continue;
+		if (entry->header.coefficient == 0 && !ll) ll = entry;
+		if (entry->header.coefficient == 1 && !h) h = entry;
+	}
+	if (!ll || !h || ll->header.block_width != h->header.block_width ||
+	    ll->header.block_height != h->header.block_height) {
+		return false;
+	}
+	i32 bw = ll->header.block_width;
+	i32 bh = ll->header.block_height;
+	i16* decoded = (i16*)malloc(4 * bw * bh * sizeof(i16));
+	bool ok = isyntax_hulsken_decompress(ll->data, ll->header.size, bw, bh, 0, ll->header.compressor_version, decoded);
+	ok = isyntax_hulsken_decompress(h->data, h->header.size, bw, bh, 1, h->header.compressor_version,
+	                                decoded + bw * bh) && ok;
+	i32 pad_l = ISYNTAX_IDWT_PAD_L;
+	i32 quadrant_width = bw + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 quadrant_height = bh + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 full_width = 2 * quadrant_width;
+	memset(idwt, 0, 4 * quadrant_width * quadrant_height * sizeof(icoeff_t));
+	i32 quadrant_offsets[4] = {0, quadrant_width, full_width * quadrant_height, full_width * quadrant_height + quadrant_width};
+	for (i32 q = 0; q < 4; ++q) {
+		for (i32 y = 0; y < bh; ++y) {
+			icoeff_t* dest = idwt + quadrant_offsets[q] + (pad_l + y) * full_width + pad_l;
+			i16* source = decoded + q * bw * bh + y * bw;
+			for (i32 x = 0; x < bw; ++x) {
+				dest[x] = source[x];
+			}
+		}
+	}
+	free(decoded);
+	*block_width = bw;
+	*block_height = bh;
+	return ok;
+}
+
+// Inverse wavelet transform of one tile-sized buffer, and the conversion of three of them (Y, Co, Cg) to BGRA pixels.
+// Throughput is measured in coefficients going in.
+static bool benchmark_idwt_and_color_conversion(corpus_t* corpus, i32 iterations) {
+	i32 max_quadrant_size = 256 + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	size_t idwt_size = 4 * max_quadrant_size * max_quadrant_size * sizeof(icoeff_t);
+	icoeff_t* input[3];
+	icoeff_t* channels[3];
+	for (i32 i = 0; i < 3; ++i) {
+		input[i] = (icoeff_t*)malloc(idwt_size);
+		channels[i] = (icoeff_t*)malloc(idwt_size);
+	}
+	u32* pixels = (u32*)malloc(512 * 512 * sizeof(u32));
+	i32 block_width = 0, block_height = 0;
+	bool ok = true;
+	for (i32 i = 0; i < 3; ++i) {
+		if (!prepare_idwt_input(corpus, i * (corpus->entry_count / 3), input[i], &block_width, &block_height)) {
+			printf("IDWT: the corpus needs LL and H codeblocks of the same size\n");
+			ok = false;
+			goto cleanup;
+		}
+	}
+	i32 quadrant_width = block_width + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 quadrant_height = block_height + ISYNTAX_IDWT_PAD_L + ISYNTAX_IDWT_PAD_R;
+	i32 idwt_coeff_count = 4 * quadrant_width * quadrant_height;
+	size_t idwt_bytes = idwt_coeff_count * sizeof(icoeff_t);
+
+	printf("IDWT (%dx%d incl. padding) and YCoCg to BGRA conversion (%dx%d):\n", 2 * quadrant_width,
+	       2 * quadrant_height, 2 * block_width, 2 * block_height);
+	for (i32 cold = 0; cold <= 1; ++cold) {
+		i32 run_count = cold ? MIN(iterations, COLD_CACHE_MAX_SAMPLES) : iterations;
+		i64 ticks = 0;
+		for (i32 i = 0; i < run_count; ++i) {
+			memcpy(channels[0], input[0], idwt_bytes); // the IDWT works in place
+			if (cold) evict_caches();
+			i64 start = get_clock();
+			isyntax_idwt(channels[0], quadrant_width, quadrant_height, false, NULL);
+			ticks += get_clock() - start;
+		}
+		print_result("isyntax_idwt", cold ? "cold" : "warm", get_seconds_elapsed(0, ticks),
+		             (i64)idwt_bytes * run_count, (i64)idwt_coeff_count * run_count);
+	}
+
+	// The line-based variant writes its output to a separate buffer (and clobbers the input).
+	icoeff_t* scratch = (icoeff_t*)malloc(idwt_size);
+	for (i32 cold = 0; cold <= 1; ++cold) {
+		i32 run_count = cold ? MIN(iterations, COLD_CACHE_MAX_SAMPLES) : iterations;
+		i64 ticks = 0;
+		for (i32 i = 0; i < run_count; ++i) {
+			memcpy(scratch, input[0], idwt_bytes);
+			if (cold) evict_caches();
+			i64 start = get_clock();
+			isyntax_idwt_line_based(scratch, channels[1], quadrant_width, quadrant_height);
+			ticks += get_clock() - start;
+		}
+		print_result("isyntax_idwt_line_based", cold ? "cold" : "warm", get_seconds_elapsed(0, ticks),
+		             (i64)idwt_bytes * run_count, (i64)idwt_coeff_count * run_count);
+	}
+	free(scratch);
+	if (memcmp(channels[0], channels[1], idwt_bytes) != 0) {
+		printf("IDWT: the line-based transform gives a different result\n");
+		ok = false;
+		goto cleanup;
+	}
+
+	for (i32 c = 0; c < 3; ++c) {
+		memcpy(channels[c], input[c], idwt_bytes);
+		isyntax_idwt(channels[c], quadrant_width, quadrant_height, false, NULL);
+	}
+	i32 idwt_stride = 2 * quadrant_width;
+	i32 valid_offset = ISYNTAX_IDWT_FIRST_VALID_PIXEL * idwt_stride + ISYNTAX_IDWT_FIRST_VALID_PIXEL;
+	i32 pixel_count = 4 * block_width * block_height;
+	for (i32 cold = 0; cold <= 1; ++cold) {
+		i32 run_count = cold ? MIN(iterations, COLD_CACHE_MAX_SAMPLES) : iterations;
+		i64 ticks = 0;
+		for (i32 i = 0; i < run_count; ++i) {
+			if (cold) evict_caches();
+			i64 start = get_clock();
+			isyntax_convert_ycocg_to_pixels(channels[0] + valid_offset, channels[1] + valid_offset,
+			                                channels[2] + valid_offset, 2 * block_width, 2 * block_height,
+			                                idwt_stride, pixels, 2 * block_width * 4, LIBISYNTAX_PIXEL_FORMAT_BGRA);
+			ticks += get_clock() - start;
+		}
+		print_result("ycocg_to_bgra", cold ? "cold" : "warm", get_seconds_elapsed(0, ticks),
+		             (i64)3 * pixel_count * sizeof(icoeff_t) * run_count, (i64)3 * pixel_count * run_count);
+	}
+
+	cleanup:
+	for (i32 i = 0; i < 3; ++i) {
+		free(input[i]);
+		free(channels[i]);
+	}
+	free(pixels);
+	return ok;
+}
+
+int main(int argc, const char** argv) {
+	if (argc < 3 || !(strcmp(argv[1], "capture") == 0 || strcmp(argv[1], "run") == 0)) {
+		printf("usage: %s capture <corpus_file> <slide.isyntax> [<slide.isyntax> ...]\n"
+		       "       %s run <corpus_file> [iterations]\n", argv[0], argv[0]);
+		return 1;
+	}
+	if (libisyntax_init() != LIBISYNTAX_OK) {
+		printf("libisyntax_init() failed\n");
+		return 1;
+	}
+	init_timer();
+
+	if (strcmp(argv[1], "capture") == 0) {
+		if (argc < 4) {
+			printf("no slides given\n");
+			return 1;
+		}
+		return capture_corpus(argv[2], argv + 3, argc - 3) ? 0 : 1;
+	}
+
+	i32 iterations = 20;
+	if (argc > 3) iterations = atoi(argv[3]);
+	corpus_t corpus = {0};
+	if (!load_corpus(&corpus, argv[2])) {
+		return 1;
+	}
+	printf("%d codeblocks in %s\n", corpus.entry_count, argv[2]);
+	eviction_buffer = (u8*)calloc(1, COLD_CACHE_EVICTION_SIZE);
+	bool ok = benchmark_decompress(&corpus, iterations);
+	ok = benchmark_idwt_and_color_conversion(&corpus, iterations * 10) && ok;
+	free(eviction_buffer);
+	free_corpus(&corpus);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+// Microbenchmarks for the decoding stages of libisyntax, on synthetic data.
+// Usage: decoder_benchmark [iterations]
+
+#include "common.h"
+#include "libisyntax.h"
+#include "isyntax.h"
+#include "timerutils.h"
+#include "hulsken_test_encoder.h"
+
+#include <stdio.h>
+
+typedef void reassemble_bitplanes_func_t(u8** bitplanes, i32 block_width, i32 block_height, i16* out);
+
+static double benchmark_reassemble(reassemble_bitplanes_func_t* func, u8** bitplanes, i32 block_width, i32 block_height,
+                                   i16* out, i32 iterations) {
+	i64 start = get_clock();
+	for (i32 i = 0; i < iterations; ++i) {
+		func(bitplanes, block_width, block_height, out);
+	}
+	return get_seconds_elapsed(start, get_clock()) * 1e6 / iterations; // microseconds per block
+}
+
+// Bitplane reassembly: scalar vs. SIMD, for a 128x128 codeblock with a varying number of bitplanes and zero density.
+static bool benchmark_bitplane_reassembly(test_rng_t* rng, i32 iterations) {
+	i32 block_width = 128;
+	i32 block_height = 128;
+	i32 coeff_total = block_width * block_height;
+	i32 bytes_per_bitplane = coeff_total / 8;
+	u8* bitplane_data = (u8*)malloc(16 * bytes_per_bitplane);
+	i16* out_scalar = (i16*)malloc(coeff_total * sizeof(i16));
+	i16* out_simd = (i16*)malloc(coeff_total * sizeof(i16));
+	bool ok = true;
+
+	static const i32 bitplane_counts[] = {4, 8, 16};
+	static const i32 zero_percentages[] = {0, 50, 90, 99};
+	printf("bitplane reassembly (128x128 codeblock, microseconds per block):\n");
+	printf("  %8s %6s %10s %10s %8s\n", "planes", "zeroes", "scalar", "simd", "speedup");
+	for (i32 c = 0; c < (i32)COUNT(bitplane_counts); ++c) {
+		for (i32 z = 0; z < (i32)COUNT(zero_percentages); ++z) {
+			i32 bitplane_count = bitplane_counts[c];
+			i16* coeffs = (i16*)malloc(coeff_total * sizeof(i16));
+			test_generate_coefficients(rng, coeffs, coeff_total, zero_percentages[z], bitplane_count - 1);
+			// Split the coefficients into bitplanes (sign, msb ... lsb), in 4x4 snake order.
+			u8* bitplanes[16] = {0};
+			memset(bitplane_data, 0, 16 * bytes_per_bitplane);
+			for (i32 bit = 0; bit < 16; ++bit) {
+				if (bit == 15 || bit < bitplane_count - 1) {
+					bitplanes[bit] = bitplane_data + bit * bytes_per_bitplane;
+				}
+			}
+			for (i32 i = 0; i < coeff_total; ++i) {
+				i32 area_index = i / 16;
+				i32 area_x = (area_index % (block_width / 4)) * 4 + (i % 4);
+				i32 area_y = (area_index / (block_width / 4)) * 4 + (i % 16) / 4;
+				i16 value = coeffs[area_y * block_width + area_x];
+				u16 signed_magnitude = (value < 0) ? (u16)(0x8000 | -value) : (u16)value;
+				for (i32 bit = 0; bit < 16; ++bit) {
+					if (bitplanes[bit] && (signed_magnitude & (1 << bit))) {
+						bitplanes[bit][i / 8] |= (u8)(1 << (i % 8));
+					}
+				}
+			}
+			double scalar_us = benchmark_reassemble(isyntax_hulsken_reassemble_bitplanes_scalar, bitplanes, block_width, block_height, out_scalar, iterations);
+			double simd_us = benchmark_reassemble(isyntax_hulsken_reassemble_bitplanes, bitplanes, block_width, block_height, out_simd, iterations);
+			bool match = memcmp(out_scalar, coeffs, coeff_total * sizeof(i16)) == 0 &&
+			             memcmp(out_simd, coeffs, coeff_total * sizeof(i16)) == 0;
+			printf("  %8d %5d%% %10.2f %10.2f %7.2fx%s\n", bitplane_count, zero_percentages[z], scalar_us, simd_us,
+			       scalar_us / simd_us, match ? "" : "  MISMATCH");
+			ok = ok && match;
+			free(coeffs);
+		}
+	}
+	free(bitplane_data);
+	free(out_scalar);
+	free(out_simd);
+	return ok;
+}
+
+// Codeblock decoding at full quality vs. only the most significant bitplanes (3 H coefficients, compressor v2).
+static bool benchmark_truncated_decoding(test_rng_t* rng, i32 iterations) {
+	i32 block_width = 128;
+	i32 block_height = 128;
+	i32 coeff_total = 3 * block_width * block_height;
+	i16* coeffs = (i16*)malloc(coeff_total * sizeof(i16));
+	i16* decoded = (i16*)malloc(coeff_total * sizeof(i16));
+	size_t capacity = coeff_total * 4 + 4096;
+	u8* compressed = (u8*)malloc(capacity);
+	test_encoder_options_t options = { .zero_counter_size = 4, .min_zero_run = 2, .v2_valid_seektable = true };
+	bool ok = true;
+
+	static const i32 zero_percentages[] = {30, 60, 90};
+	static const i32 bitplane_limits[] = {0, 6, 4, 2};
+	printf("codeblock decoding (128x128, 3 H coefficients, v2; microseconds per block):\n");
+	printf("  %6s %8s %8s %8s %8s\n", "zeroes", "full", "top 6", "top 4", "top 2");
+	for (i32 z = 0; z < (i32)COUNT(zero_percentages); ++z) {
+		test_generate_coefficients(rng, coeffs, coeff_total, zero_percentages[z], 12);
+		size_t compressed_size = test_hulsken_encode(rng, coeffs, block_width, block_height, 3, 2, options,
+		                                             compressed, capacity);
+		printf("  %5d%%", zero_percentages[z]);
+		for (i32 b = 0; b < (i32)COUNT(bitplane_limits); ++b) {
+			i64 start = get_clock();
+			for (i32 i = 0; i < iterations; ++i) {
+				if (!isyntax_hulsken_decompress_truncated(compressed, compressed_size, block_width, block_height,
+				                                          1, 2, bitplane_limits[b], decoded, NULL)) {
+					ok = false;
+				}
+			}
+			printf(" %8.2f", get_seconds_elapsed(start, get_clock()) * 1e6 / iterations);
+		}
+		printf("\n");
+	}
+	free(coeffs);
+	free(decoded);
+	free(compressed);
+	return ok;
+}
+
+// Codeblock decoding time vs. the amount of zeroes (3 H coefficients, compressor v2).
+static bool benchmark_zero_density(test_rng_t* rng, i32 iterations) {
+	i32 block_width = 128;
+	i32 block_height = 128;
+	i32 coeff_total = 3 * block_width * block_height;
+	i16* coeffs = (i16*)malloc(coeff_total * sizeof(i16));
+	i16* decoded = (i16*)malloc(coeff_total * sizeof(i16));
+	size_t capacity = coeff_total * 4 + 4096;
+	u8* compressed = (u8*)malloc(capacity);
+	test_encoder_options_t options = { .zero_counter_size = 4, .min_zero_run = 2, .v2_valid_seektable = true };
+	bool ok = true;
+
+	static const i32 zero_percentages[] = {0, 50, 80, 90, 95, 99, 100};
+	printf("codeblock decoding vs. zeroes (128x128, 3 H coefficients, v2):\n");
+	printf("  %6s %12s %14s %12s\n", "zeroes", "zero density", "compressed", "us/block");
+	for (i32 z = 0; z < (i32)COUNT(zero_percentages); ++z) {
+		test_generate_coefficients(rng, coeffs, coeff_total, zero_percentages[z], 8);
+		coeffs[0] = 1; // not an empty codeblock
+		size_t compressed_size = test_hulsken_encode(rng, coeffs, block_width, block_height, 3, 2, options,
+		                                             compressed, capacity);
+		isyntax_codeblock_stats_t stats = {0};
+		i64 start = get_clock();
+		for (i32 i = 0; i < iterations; ++i) {
+			if (!isyntax_hulsken_decompress_truncated(compressed, compressed_size, block_width, block_height, 1, 2, 0,
+			                                          decoded, &stats)) {
+				ok = false;
+			}
+		}
+		double elapsed = get_seconds_elapsed(start, get_clock()) * 1e6 / iterations;
+		if (memcmp(coeffs, decoded, coeff_total * sizeof(i16)) != 0) ok = false;
+		printf("  %5d%% %11.1f%% %8zu bytes %12.2f\n", zero_percentages[z], stats.zero_density * 100.0f,
+		       compressed_size, elapsed);
+	}
+	free(coeffs);
+	free(decoded);
+	free(compressed);
+	return ok;
+}
+
+// Reuse of Huffman tables across codeblocks compressed with an identical tree (3 H coefficients, compressor v2).
+// The blocks are cycled through round-robin, so the hit rate drops once there are more distinct trees than cache slots.
+static bool benchmark_huffman_table_cache(test_rng_t* rng, i32 iterations) {
+	i32 block_width = 128;
+	i32 block_height = 128;
+	i32 coeff_total = 3 * block_width * block_height;
+	enum { max_block_count = 8 };
+	i16* coeffs = (i16*)malloc(coeff_total * sizeof(i16));
+	i16* decoded = (i16*)malloc(coeff_total * sizeof(i16));
+	size_t capacity = coeff_total * 4 + 4096;
+	u8* compressed[max_block_count];
+	size_t compressed_sizes[max_block_count];
+	test_encoder_options_t options = { .zero_counter_size = 4, .min_zero_run = 2, .v2_valid_seektable = true };
+	bool ok = true;
+
+	static const i32 zero_percentages[] = {60, 95, 99};
+	static const i32 distinct_block_counts[] = {1, 4, 8};
+	printf("Huffman table cache (128x128, 3 H coefficients, v2; microseconds per block):\n");
+	printf("  %6s %7s %10s %10s %10s %9s\n", "zeroes", "blocks", "hit rate", "uncached", "cached", "saved");
+	for (i32 z = 0; z < (i32)COUNT(zero_percentages); ++z) {
+		for (i32 b = 0; b < max_block_count; ++b) {
+			test_generate_coefficients(rng, coeffs, coeff_total, zero_percentages[z], 8);
+			coeffs[0] = 1; // not an empty codeblock
+			compressed[b] = (u8*)malloc(capacity);
+			compressed_sizes[b] = test_hulsken_encode(rng, coeffs, block_width, block_height, 3, 2, options,
+			                                          compressed[b], capacity);
+		}
+		for (i32 d = 0; d < (i32)COUNT(distinct_block_counts); ++d) {
+			i32 block_count = distinct_block_counts[d];
+			double elapsed[2];
+			i32 hits = 0;
+			for (i32 enabled = 0; enabled <= 1; ++enabled) {
+				isyntax_hulsken_set_huffman_table_cache_enabled(enabled);
+				i64 start = get_clock();
+				for (i32 i = 0; i < iterations; ++i) {
+					i32 b = i % block_count;
+					isyntax_codeblock_stats_t stats = {0};
+					if (!isyntax_hulsken_decompress_truncated(compressed[b], compressed_sizes[b], block_width,
+					                                          block_height, 1, 2, 0, decoded, &stats)) {
+						ok = false;
+					}
+					if (enabled && stats.huffman_table_reused) ++hits;
+				}
+				elapsed[enabled] = get_seconds_elapsed(start, get_clock()) * 1e6 / iterations;
+			}
+			printf("  %5d%% %7d %9.1f%% %10.2f %10.2f %8.1f%%\n", zero_percentages[z], block_count,
+			       hits * 100.0 / iterations, elapsed[0], elapsed[1], (1.0 - elapsed[1] / elapsed[0]) * 100.0);
+		}
+		for (i32 b = 0; b < max_block_count; ++b) {
+			free(compressed[b]);
+		}
+	}
+	isyntax_hulsken_set_huffman_table_cache_enabled(true);
+	free(coeffs);
+	free(decoded);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	if (libisyntax_init() != LIBISYNTAX_OK) {
+		printf("libisyntax_init() failed\n");
+		return 1;
+	}
+	init_timer();
+	i32 iterations = 2000;
+	if (argc > 1) iterations = atoi(argv[1]);
+
+	test_rng_t rng = { .state = 0x2545F4914F6CDD1DULL };
+	bool ok = benchmark_bitplane_reassembly(&rng, iterations);
+	ok = benchmark_truncated_decoding(&rng, iterations / 10) && ok;
+	ok = benchmark_zero_density(&rng, iterations / 10) && ok;
+	ok = benchmark_huffman_table_cache(&rng, iterations / 10) && ok;
+	return ok ? 0 : 1;
+}
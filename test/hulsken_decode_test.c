@@ -0,0 +1,127 @@
+// Round-trip test for the Hulsken codeblock decoder: random coefficient blocks are encoded with a small reference
+// encoder and must decode back to exactly the same coefficients.
+
+#include "common.h"
+#include "libisyntax.h"
+#include "isyntax.h"
+#include "hulsken_test_encoder.h"
+
+#include <stdio.h>
+
+typedef struct test_case_t {
+	i32 compressor_version;
+	i32 coefficient;
+	i32 block_width;
+	i32 block_height;
+	i32 zero_percentage;
+	i32 max_magnitude_bits;
+	test_encoder_options_t options;
+} test_case_t;
+
+// Expected result of decoding only the sign and the most significant magnitude bitplanes (compressor v2 only):
+// bitplanes are grouped by bit position, over all coefficients in the codeblock.
+static void truncate_coefficients(i16* coeffs, i32 coeff_count, i32 block_area, i32 max_magnitude_bitplanes) {
+	u32 bitmask_aggregate = 0;
+	for (i32 i = 0; i < coeff_count * block_area; ++i) {
+		u16 signed_magnitude = (coeffs[i] < 0) ? (u16)(0x8000 | -coeffs[i]) : (u16)coeffs[i];
+		for (i32 bit_index = 0; bit_index < 16; ++bit_index) {
+			if (signed_magnitude & (1u << (15 - bit_index))) bitmask_aggregate |= (1u << bit_index);
+		}
+	}
+	i32 kept_group_count = max_magnitude_bitplanes + (bitmask_aggregate & 1);
+	u16 kept_magnitude_bits = 0;
+	for (i32 bit_index = 1, group = (bitmask_aggregate & 1); bit_index < 16; ++bit_index) {
+		if (bitmask_aggregate & (1u << bit_index)) {
+			if (group++ < kept_group_count) kept_magnitude_bits |= (u16)(1u << (15 - bit_index));
+		}
+	}
+	for (i32 i = 0; i < coeff_count * block_area; ++i) {
+		i32 magnitude = (coeffs[i] < 0 ? -coeffs[i] : coeffs[i]) & kept_magnitude_bits;
+		coeffs[i] = (i16)(coeffs[i] < 0 ? -magnitude : magnitude);
+	}
+}
+
+static bool run_test_case(test_rng_t* rng, test_case_t* t, i32 case_index) {
+	i32 coeff_count = (t->coefficient == 1) ? 3 : 1;
+	i32 coeff_total = coeff_count * t->block_width * t->block_height;
+	i16* coeffs = (i16*)malloc(coeff_total * sizeof(i16));
+	i16* decoded = (i16*)malloc(coeff_total * sizeof(i16));
+	size_t capacity = coeff_total * 4 + 4096;
+	u8* compressed = (u8*)malloc(capacity);
+
+	test_generate_coefficients(rng, coeffs, coeff_total, t->zero_percentage, t->max_magnitude_bits);
+	if (t->compressor_version == 2) {
+		coeffs[test_rng_range(rng, coeff_total)] = 1; // empty v2 blocks are stored as dummy blocks instead
+	}
+	size_t compressed_size = test_hulsken_encode(rng, coeffs, t->block_width, t->block_height, coeff_count,
+	                                             t->compressor_version, t->options, compressed, capacity);
+	bool ok = (compressed_size > 0);
+	if (ok) {
+		memset(decoded, 0x55, coeff_total * sizeof(i16));
+		ok = isyntax_hulsken_decompress(compressed, compressed_size, t->block_width, t->block_height,
+		                                t->coefficient, t->compressor_version, decoded);
+		ok = ok && (memcmp(coeffs, decoded, coeff_total * sizeof(i16)) == 0);
+	}
+	if (ok && t->compressor_version == 2 && t->coefficient == 1) {
+		// Decoding only the most significant bitplanes (lossy preview)
+		i32 max_magnitude_bitplanes = 1 + (i32)test_rng_range(rng, 6);
+		truncate_coefficients(coeffs, coeff_count, t->block_width * t->block_height, max_magnitude_bitplanes);
+		memset(decoded, 0x55, coeff_total * sizeof(i16));
+		isyntax_codeblock_stats_t stats = {0};
+		ok = isyntax_hulsken_decompress_truncated(compressed, compressed_size, t->block_width, t->block_height,
+		                                          t->coefficient, t->compressor_version, max_magnitude_bitplanes, decoded, &stats);
+		ok = ok && (memcmp(coeffs, decoded, coeff_total * sizeof(i16)) == 0);
+		ok = ok && stats.huffman_table_reused; // same tree as the block that was just decoded
+	}
+	if (!ok) {
+		printf("FAILED case %d: version=%d coefficient=%d block=%dx%d zeroes=%d%% magnitude_bits=%d counter_bits=%d extra_symbols=%d\n",
+		       case_index, t->compressor_version, t->coefficient, t->block_width, t->block_height, t->zero_percentage,
+		       t->max_magnitude_bits, t->options.zero_counter_size, t->options.extra_symbols);
+	}
+	free(coeffs);
+	free(decoded);
+	free(compressed);
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	if (libisyntax_init() != LIBISYNTAX_OK) {
+		printf("libisyntax_init() failed\n");
+		return 1;
+	}
+	i32 case_count = 2000;
+	if (argc > 1) case_count = atoi(argv[1]);
+
+	// Run the same cases with each of the SIMD levels the CPU supports (the bitplane reassembly differs per level).
+	i32 total_failures = 0;
+	for (i32 simd_level = LIBISYNTAX_SIMD_LEVEL_SCALAR; simd_level <= LIBISYNTAX_SIMD_LEVEL_NEON; ++simd_level) {
+		if (libisyntax_set_simd_level(simd_level) != LIBISYNTAX_OK) continue;
+		test_rng_t rng = { .state = 0x9E3779B97F4A7C15ULL };
+		i32 failures = 0;
+		for (i32 i = 0; i < case_count; ++i) {
+			static const i32 block_sizes[] = {128, 128, 64, 32};
+			i32 block_size = block_sizes[test_rng_range(&rng, COUNT(block_sizes))];
+			test_case_t t = {
+				.compressor_version = 1 + (i32)test_rng_range(&rng, 2),
+				.coefficient = (i32)test_rng_range(&rng, 2),
+				.block_width = block_size,
+				.block_height = block_size,
+				.zero_percentage = (i32)test_rng_range(&rng, 101),
+				.max_magnitude_bits = 1 + (i32)test_rng_range(&rng, 14),
+				.options = {
+					.zero_counter_size = 1 + (i32)test_rng_range(&rng, 8),
+					.min_zero_run = 1 + (i32)test_rng_range(&rng, 4),
+					.extra_symbols = (test_rng_range(&rng, 2) == 0) ? 0 : (i32)test_rng_range(&rng, 256),
+					.v1_store_bitmasks = test_rng_range(&rng, 2) == 0,
+					.v2_valid_seektable = test_rng_range(&rng, 4) != 0,
+				},
+			};
+			if (!run_test_case(&rng, &t, i)) {
+				++failures;
+			}
+		}
+		printf("SIMD level %d: %d/%d codeblocks decoded correctly\n", simd_level, case_count - failures, case_count);
+		total_failures += failures;
+	}
+	return total_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+// Minimal encoder for synthetic iSyntax codeblocks (Hulsken compression, compressor versions 1 and 2).
+// This is the inverse of isyntax_hulsken_decompress(), used by the tests and benchmarks so that the decoder
+// can be exercised without needing a real slide. It is not meant to produce optimal (or Philips-identical) output.
+
+#include "common.h"
+#include "intrinsics.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct test_rng_t {
+	u64 state;
+} test_rng_t;
+
+static inline u32 test_rng_next(test_rng_t* rng) {
+	// xorshift64*
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return (u32)((rng->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static inline u32 test_rng_range(test_rng_t* rng, u32 count) {
+	return test_rng_next(rng) % count;
+}
+
+// Fill coefficients with plausible wavelet-like data: mostly zeroes and small values, with some larger outliers.
+// zero_percentage controls the sparsity, max_magnitude_bits the dynamic range.
+static void test_generate_coefficients(test_rng_t* rng, i16* coeffs, i32 count, i32 zero_percentage, i32 max_magnitude_bits) {
+	for (i32 i = 0; i < count; ++i) {
+		i32 value = 0;
+		if ((i32)test_rng_range(rng, 100) >= zero_percentage) {
+			i32 bits = 1 + (i32)test_rng_range(rng, max_magnitude_bits);
+			if (test_rng_range(rng, 4) != 0) bits = MIN(bits, 4); // bias towards small values
+			value = (i32)test_rng_range(rng, 1u << bits);
+			if (test_rng_range(rng, 2)) value = -value;
+		}
+		coeffs[i] = (i16)value;
+	}
+}
+
+typedef struct test_bitwriter_t {
+	u8* data;
+	size_t capacity;
+	size_t bit_pos;
+} test_bitwriter_t;
+
+static void test_bitwriter_put(test_bitwriter_t* w, u32 value, i32 bit_count) {
+	for (i32 i = 0; i < bit_count; ++i) {
+		size_t byte_index = w->bit_pos / 8;
+		if (byte_index >= w->capacity) return; // caller checks the final length
+		if ((value >> i) & 1) {
+			w->data[byte_index] |= (u8)(1u << (w->bit_pos % 8));
+		}
+		++w->bit_pos;
+	}
+}
+
+typedef struct test_huffman_node_t {
+	i32 freq;
+	i32 symbol; // -1 for internal nodes
+	i32 left;
+	i32 right;
+} test_huffman_node_t;
+
+typedef struct test_huffman_code_t {
+	u32 code[256];
+	u8 size[256];
+	bool present[256];
+} test_huffman_code_t;
+
+static void test_huffman_assign_codes(test_huffman_node_t* nodes, i32 node, u32 code, i32 depth, test_huffman_code_t* out) {
+	if (nodes[node].symbol >= 0) {
+		out->code[nodes[node].symbol] = code;
+		out->size[nodes[node].symbol] = (u8)depth;
+		out->present[nodes[node].symbol] = true;
+	} else {
+		// Left branch is a 0 bit, right branch is a 1 bit; the first bit in the stream is the branch nearest the root.
+		test_huffman_assign_codes(nodes, nodes[node].left, code, depth + 1, out);
+		test_huffman_assign_codes(nodes, nodes[node].right, code | (1u << depth), depth + 1, out);
+	}
+}
+
+static i32 test_huffman_max_depth(test_huffman_node_t* nodes, i32 node) {
+	if (nodes[node].symbol >= 0) return 0;
+	return 1 + MAX(test_huffman_max_depth(nodes, nodes[node].left), test_huffman_max_depth(nodes, nodes[node].right));
+}
+
+// Serialize the tree in pre-order: a 0 bit for an internal node, a 1 bit followed by the 8-bit symbol for a leaf.
+static void test_huffman_serialize(test_huffman_node_t* nodes, i32 node, test_bitwriter_t* w) {
+	if (nodes[node].symbol >= 0) {
+		test_bitwriter_put(w, 1, 1);
+		test_bitwriter_put(w, (u32)nodes[node].symbol, 8);
+	} else {
+		test_bitwriter_put(w, 0, 1);
+		test_huffman_serialize(nodes, nodes[node].left, w);
+		test_huffman_serialize(nodes, nodes[node].right, w);
+	}
+}
+
+// Build a Huffman tree with code lengths of at most 16 bits. Returns the root node index.
+static i32 test_huffman_build(test_huffman_node_t* nodes, const i32* freqs) {
+	i32 scaled[256];
+	memcpy(scaled, freqs, sizeof(scaled));
+	for (;;) {
+		i32 node_count = 0;
+		i32 active[256];
+		i32 active_count = 0;
+		for (i32 s = 0; s < 256; ++s) {
+			if (scaled[s] > 0) {
+				nodes[node_count] = (test_huffman_node_t){ .freq = scaled[s], .symbol = s, .left = -1, .right = -1 };
+				active[active_count++] = node_count++;
+			}
+		}
+		if (active_count == 0) return -1;
+		while (active_count > 1) {
+			// Naive O(n^2) merge of the two least frequent nodes; fine for 256 symbols.
+			i32 a = 0, b = 1;
+			if (nodes[active[b]].freq < nodes[active[a]].freq) { a = 1; b = 0; }
+			for (i32 i = 2; i < active_count; ++i) {
+				i32 f = nodes[active[i]].freq;
+				if (f < nodes[active[a]].freq) { b = a; a = i; }
+				else if (f < nodes[active[b]].freq) { b = i; }
+			}
+			nodes[node_count] = (test_huffman_node_t){ .freq = nodes[active[a]].freq + nodes[active[b]].freq,
+			                                           .symbol = -1, .left = active[a], .right = active[b] };
+			i32 hi = MAX(a, b), lo = MIN(a, b);
+			active[lo] = node_count++;
+			active[hi] = active[--active_count];
+		}
+		i32 root = active[0];
+		if (test_huffman_max_depth(nodes, root) <= 16) return root;
+		// Too deep: flatten the distribution and try again.
+		for (i32 s = 0; s < 256; ++s) {
+			if (scaled[s] > 0) scaled[s] = scaled[s] / 2 + 1;
+		}
+	}
+}
+
+typedef struct test_token_t {
+	u8 symbol;
+	bool is_zero_run;
+	u32 run_length;
+} test_token_t;
+
+typedef struct test_encoder_options_t {
+	i32 zero_counter_size;       // bits per zero run counter chunk (1-8)
+	i32 min_zero_run;            // shorter runs are emitted as literal zeroes (must be >= 2 for v2)
+	i32 extra_symbols;           // number of unused symbols to add to the tree (makes some codes longer)
+	bool v1_store_bitmasks;      // v1: omit empty bitplanes and append bitmasks
+	bool v2_valid_seektable;     // v2: write a seektable with the start offset of each bitplane group
+} test_encoder_options_t;
+
+// Encode a codeblock. coeffs holds coeff_count blocks of block_width * block_height coefficients (row-major).
+// Returns the size of the codeblock in bytes, or 0 if the output capacity was too small.
+static size_t test_hulsken_encode(test_rng_t* rng, const i16* coeffs, i32 block_width, i32 block_height, i32 coeff_count,
+                                  i32 compressor_version, test_encoder_options_t options, u8* out, size_t out_capacity) {
+	i32 coeff_per_block = block_width * block_height;
+	i32 bytes_per_bitplane = coeff_per_block / 8;
+
+	// Signed magnitude, in 4x4 snake order
+	u16* serial = (u16*)calloc(coeff_count * coeff_per_block, sizeof(u16));
+	i32 area_stride_x = block_width / 4;
+	for (i32 c = 0; c < coeff_count; ++c) {
+		for (i32 area = 0; area < coeff_per_block / 16; ++area) {
+			i32 area_x = (area % area_stride_x) * 4;
+			i32 area_y = (area / area_stride_x) * 4;
+			for (i32 i = 0; i < 16; ++i) {
+				i32 v = coeffs[c * coeff_per_block + (area_y + i / 4) * block_width + area_x + i % 4];
+				u16 sm = (v < 0) ? (u16)(0x8000 | (-v)) : (u16)v;
+				serial[c * coeff_per_block + area * 16 + i] = sm;
+			}
+		}
+	}
+
+	// Which bitplanes are non-empty? bit_index -> shift: v1 stores sign, lsb..msb; v2 stores sign, msb..lsb.
+	u32 bitmasks[3] = {0};
+	for (i32 c = 0; c < coeff_count; ++c) {
+		u16 all_bits = 0;
+		for (i32 i = 0; i < coeff_per_block; ++i) all_bits |= serial[c * coeff_per_block + i];
+		for (i32 bit_index = 0; bit_index < 16; ++bit_index) {
+			i32 shift = (compressor_version == 1) ? ((bit_index == 0) ? 15 : bit_index - 1) : 15 - bit_index;
+			if (all_bits & (1u << shift)) bitmasks[c] |= (1u << bit_index);
+		}
+		if (compressor_version == 1 && !options.v1_store_bitmasks) bitmasks[c] = 0xFFFF;
+	}
+	bool v1_append_bitmasks = (compressor_version == 1) && options.v1_store_bitmasks;
+
+	// Serialize the bitplanes in the order the decoder expects
+	i32 plane_count = 0;
+	for (i32 c = 0; c < coeff_count; ++c) plane_count += popcount(bitmasks[c]);
+	size_t serialized_length = (size_t)plane_count * bytes_per_bitplane + (v1_append_bitmasks ? coeff_count * 2 : 0);
+	u8* serialized = (u8*)calloc(serialized_length + 1, 1);
+	i32 group_start_byte[16] = {0};
+	i32 group_count = 0;
+	{
+		i32 plane = 0;
+		if (compressor_version == 1) {
+			for (i32 c = 0; c < coeff_count; ++c) {
+				for (i32 bit_index = 0; bit_index < 16; ++bit_index) {
+					if (!(bitmasks[c] & (1u << bit_index))) continue;
+					i32 shift = (bit_index == 0) ? 15 : bit_index - 1;
+					u8* dst = serialized + plane++ * bytes_per_bitplane;
+					for (i32 i = 0; i < coeff_per_block; ++i) {
+						dst[i / 8] |= (u8)(((serial[c * coeff_per_block + i] >> shift) & 1) << (i % 8));
+					}
+				}
+			}
+			if (v1_append_bitmasks) {
+				u8* dst = serialized + plane * bytes_per_bitplane;
+				for (i32 c = 0; c < coeff_count; ++c) {
+					dst[c * 2] = (u8)bitmasks[c];
+					dst[c * 2 + 1] = (u8)(bitmasks[c] >> 8);
+				}
+			}
+		} else {
+			for (i32 bit_index = 0; bit_index < 16; ++bit_index) {
+				bool group_started = false;
+				for (i32 c = 0; c < coeff_count; ++c) {
+					if (!(bitmasks[c] & (1u << bit_index))) continue;
+					if (!group_started) {
+						group_start_byte[group_count++] = plane * bytes_per_bitplane;
+						group_started = true;
+					}
+					i32 shift = 15 - bit_index;
+					u8* dst = serialized + plane++ * bytes_per_bitplane;
+					for (i32 i = 0; i < coeff_per_block; ++i) {
+						dst[i / 8] |= (u8)(((serial[c * coeff_per_block + i] >> shift) & 1) << (i % 8));
+					}
+				}
+			}
+		}
+	}
+	free(serial);
+
+	// Pick a zero run symbol that does not occur in the data (if possible), to avoid escapes right after a run.
+	bool byte_used[256] = {0};
+	for (size_t i = 0; i < serialized_length; ++i) byte_used[serialized[i]] = true;
+	u8 zerorun_symbol = 0;
+	{
+		i32 start = 1 + (i32)test_rng_range(rng, 255);
+		for (i32 k = 0; k < 255; ++k) {
+			i32 s = 1 + (start - 1 + k) % 255;
+			if (!byte_used[s]) { zerorun_symbol = (u8)s; break; }
+		}
+		if (zerorun_symbol == 0) zerorun_symbol = (u8)(1 + test_rng_range(rng, 255));
+	}
+	i32 zero_counter_size = options.zero_counter_size;
+	i32 min_zero_run = MAX(options.min_zero_run, (compressor_version == 2) ? 2 : 1);
+
+	// Tokenize (zero runs and literals). In v2 the stream is restarted at each bitplane group boundary,
+	// so that each group can be decoded independently using the seektable.
+	test_token_t* tokens = (test_token_t*)malloc((serialized_length + 1) * sizeof(test_token_t));
+	i32* token_group_start = (i32*)calloc(17, sizeof(i32));
+	i32 token_count = 0;
+	{
+		i32 group = 0;
+		size_t pos = 0;
+		bool last_token_was_run = false;
+		while (pos < serialized_length) {
+			size_t segment_end = serialized_length;
+			if (compressor_version == 2) {
+				token_group_start[group] = token_count;
+				segment_end = (group + 1 < group_count) ? (size_t)group_start_byte[group + 1] : serialized_length;
+				++group;
+			}
+			while (pos < segment_end) {
+				u8 b = serialized[pos];
+				if (b == 0) {
+					size_t run = 1;
+					while (pos + run < segment_end && serialized[pos + run] == 0) ++run;
+					// A zero run symbol directly after a run is parsed as a continuation of that run, so an escaped
+					// zero run symbol (or a new run at the start of a bitplane group) must not follow a run.
+					if (pos + run < serialized_length && serialized[pos + run] == zerorun_symbol) {
+						--run; // the last zero is emitted as a literal
+					}
+					if ((i32)run >= min_zero_run && !last_token_was_run) {
+						tokens[token_count++] = (test_token_t){ .symbol = zerorun_symbol, .is_zero_run = true, .run_length = (u32)run };
+						pos += run;
+						last_token_was_run = true;
+					} else {
+						tokens[token_count++] = (test_token_t){ .symbol = 0 };
+						pos += 1;
+						last_token_was_run = false;
+					}
+				} else {
+					tokens[token_count++] = (test_token_t){ .symbol = b };
+					pos += 1;
+					last_token_was_run = false;
+				}
+			}
+		}
+	}
+	free(serialized);
+
+	// Symbol frequencies (zero runs count once per counter chunk)
+	i32 freqs[256] = {0};
+	for (i32 i = 0; i < token_count; ++i) {
+		if (tokens[i].is_zero_run) {
+			u32 count = tokens[i].run_length - ((compressor_version == 2) ? 1 : 0);
+			i32 chunks = 0;
+			while (count) { ++chunks; count >>= zero_counter_size; }
+			freqs[zerorun_symbol] += chunks;
+		} else {
+			freqs[tokens[i].symbol] += 1;
+		}
+	}
+	for (i32 i = 0; i < options.extra_symbols; ++i) {
+		i32 s = (i32)test_rng_range(rng, 256);
+		if (freqs[s] == 0) freqs[s] = 1;
+	}
+
+	test_huffman_node_t* nodes = (test_huffman_node_t*)malloc(512 * sizeof(test_huffman_node_t));
+	test_huffman_code_t codes = {0};
+	i32 root = test_huffman_build(nodes, freqs);
+	if (root < 0) {
+		// No data at all: make sure there is at least a tree with a single leaf
+		freqs[zerorun_symbol] = 1;
+		root = test_huffman_build(nodes, freqs);
+	}
+	test_huffman_assign_codes(nodes, root, 0, 0, &codes);
+
+	memset(out, 0, out_capacity);
+	test_bitwriter_t w = { .data = out, .capacity = out_capacity };
+	if (compressor_version == 1) {
+		test_bitwriter_put(&w, (u32)serialized_length, 32);
+	} else {
+		for (i32 c = 0; c < coeff_count; ++c) test_bitwriter_put(&w, bitmasks[c], 16);
+	}
+	test_bitwriter_put(&w, zerorun_symbol, 8);
+	test_bitwriter_put(&w, (u32)zero_counter_size, 8);
+
+	size_t seektable_pos = w.bit_pos;
+	i32 bitplane_ptr_bits = 0;
+	if (compressor_version == 2) {
+		bitplane_ptr_bits = (i32)(log2f((float)serialized_length)) + 5;
+		w.bit_pos += (size_t)(group_count - 1) * bitplane_ptr_bits; // filled in below
+	}
+	test_huffman_serialize(nodes, root, &w);
+	size_t message_start = w.bit_pos;
+
+	size_t group_offsets[16] = {0};
+	i32 next_group = 1;
+	for (i32 i = 0; i < token_count; ++i) {
+		if (compressor_version == 2 && next_group < group_count && token_group_start[next_group] == i) {
+			group_offsets[next_group++] = w.bit_pos - message_start;
+		}
+		test_token_t t = tokens[i];
+		i32 code_size = MAX(codes.size[t.symbol], 1); // a lone root leaf still occupies one bit
+		if (t.is_zero_run) {
+			u32 count = t.run_length - ((compressor_version == 2) ? 1 : 0);
+			i32 chunks = 0;
+			for (u32 c = count; c; c >>= zero_counter_size) ++chunks;
+			for (i32 k = chunks - 1; k >= 0; --k) {
+				test_bitwriter_put(&w, codes.code[t.symbol], code_size);
+				test_bitwriter_put(&w, (count >> (k * zero_counter_size)) & ((1u << zero_counter_size) - 1), zero_counter_size);
+			}
+		} else {
+			test_bitwriter_put(&w, codes.code[t.symbol], code_size);
+			if (t.symbol == zerorun_symbol) {
+				test_bitwriter_put(&w, 0, zero_counter_size); // escaped zero run symbol
+			}
+		}
+	}
+	size_t total_bits = w.bit_pos;
+
+	if (compressor_version == 2) {
+		w.bit_pos = seektable_pos;
+		for (i32 g = 1; g < group_count; ++g) {
+			u32 offset = options.v2_valid_seektable ? (u32)group_offsets[g] : test_rng_next(rng);
+			test_bitwriter_put(&w, offset & ((1u << bitplane_ptr_bits) - 1), bitplane_ptr_bits);
+		}
+	}
+
+	free(nodes);
+	free(tokens);
+	free(token_group_start);
+
+	size_t size = (total_bits + 7) / 8;
+	if (size + 8 > out_capacity) return 0; // the decoder needs 8 safety bytes after the end
+	return size;
+}
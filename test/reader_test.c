@@ -0,0 +1,789 @@
+// Tests for the tile reader and the read functions of the public API, on synthetic slides (see synthetic_slide.h).
+// The expected pixels come from plain full-tile reads (libisyntax_tile_read()) of an identical slide, through a cache
+// with the default settings. Every other read path must produce exactly the same pixels.
+// Usage: reader_test [test name]. Without a test name, all tests are run.
+
+#include "common.h"
+#include "platform.h"
+#include "work_queue.h"
+#include "intrinsics.h"
+#include "libisyntax.h"
+#include "isyntax.h"
+#include "synthetic_slide.h"
+
+#include <stdio.h>
+
+#define TEST_SLIDE_SEED 0x9E3779B97F4A7C15ULL
+#define TILE_SIZE SYNTHETIC_SLIDE_TILE_SIZE
+#define BLOCK_SIZE SYNTHETIC_SLIDE_BLOCK_SIZE
+#define LEVEL_COUNT SYNTHETIC_SLIDE_LEVEL_COUNT
+#define BASE_WIDTH_IN_TILES (1 << (LEVEL_COUNT - 1))
+
+static i32 width_in_tiles(i32 level) {
+	return BASE_WIDTH_IN_TILES >> level;
+}
+
+// The padding that libisyntax_read_region() adds to the coordinates (PER_LEVEL_PADDING in libisyntax.c).
+static i32 region_offset(i32 level) {
+	return ((3 << LEVEL_COUNT) - 3) >> level;
+}
+
+static i32 floor_div(i64 a, i32 b) {
+	return (i32)((a >= 0) ? a / b : -((-a + b - 1) / b));
+}
+
+// The reference: all tiles read in full, as RGBA and as GRAY8.
+static u8* reference_rgba[LEVEL_COUNT][BASE_WIDTH_IN_TILES * BASE_WIDTH_IN_TILES];
+static u8* reference_gray[LEVEL_COUNT][BASE_WIDTH_IN_TILES * BASE_WIDTH_IN_TILES];
+
+static bool load_reference(void) {
+	synthetic_slide_t slide;
+	if (!synthetic_slide_create(&slide, "reader_test_reference.bin", TEST_SLIDE_SEED, 2000)) {
+		return false;
+	}
+	bool ok = true;
+	for (i32 level = LEVEL_COUNT - 1; level >= 0; --level) {
+		for (i32 tile_index = 0; tile_index < width_in_tiles(level) * width_in_tiles(level); ++tile_index) {
+			i32 tile_x = tile_index % width_in_tiles(level);
+			i32 tile_y = tile_index / width_in_tiles(level);
+			reference_rgba[level][tile_index] = (u8*)malloc(TILE_SIZE * TILE_SIZE * 4);
+			reference_gray[level][tile_index] = (u8*)malloc(TILE_SIZE * TILE_SIZE);
+			ok &= libisyntax_tile_read(slide.isyntax, slide.cache, level, tile_x, tile_y,
+			                           (u32*)reference_rgba[level][tile_index], LIBISYNTAX_PIXEL_FORMAT_RGBA) == LIBISYNTAX_OK;
+			ok &= libisyntax_tile_read(slide.isyntax, slide.cache, level, tile_x, tile_y,
+			                           (u32*)reference_gray[level][tile_index], LIBISYNTAX_PIXEL_FORMAT_GRAY8) == LIBISYNTAX_OK;
+		}
+	}
+	synthetic_slide_destroy(&slide);
+	remove("reader_test_reference.bin");
+	return ok;
+}
+
+// The expected pixel at (x, y) in pixels of the level (without the padding), white outside of the slide.
+static void expected_pixel(i32 level, i64 x, i64 y, u8* rgba, u8* gray) {
+	i32 tile_x = floor_div(x, TILE_SIZE);
+	i32 tile_y = floor_div(y, TILE_SIZE);
+	if (tile_x < 0 || tile_y < 0 || tile_x >= width_in_tiles(level) || tile_y >= width_in_tiles(level)) {
+		memset(rgba, 0xFF, 4);
+		*gray = 0xFF;
+		return;
+	}
+	i32 tile_index = tile_y * width_in_tiles(level) + tile_x;
+	i64 pixel_index = (y - (i64)tile_y * TILE_SIZE) * TILE_SIZE + (x - (i64)tile_x * TILE_SIZE);
+	memcpy(rgba, reference_rgba[level][tile_index] + pixel_index * 4, 4);
+	*gray = reference_gray[level][tile_index][pixel_index];
+}
+
+// Writes the expected pixels of the region (in the coordinates of libisyntax_read_region()) in any 8-bit or 16-bit
+// RGB pixel format. Only the pixels are written, not the padding at the end of the rows.
+static void expected_region(i32 level, i64 x, i64 y, i32 width, i32 height, i32 pixel_format, u8* out, i32 stride) {
+	size_t plane_stride = (size_t)stride * height;
+	for (i32 row = 0; row < height; ++row) {
+		u8* dest = out + (size_t)row * stride;
+		for (i32 col = 0; col < width; ++col) {
+			u8 rgba[4];
+			u8 gray;
+			expected_pixel(level, x + col + region_offset(level), y + row + region_offset(level), rgba, &gray);
+			switch (pixel_format) {
+				case LIBISYNTAX_PIXEL_FORMAT_RGBA: {
+					memcpy(dest + col * 4, rgba, 4);
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_BGRA: {
+					u8 bgra[4] = {rgba[2], rgba[1], rgba[0], rgba[3]};
+					memcpy(dest + col * 4, bgra, 4);
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_RGB: {
+					memcpy(dest + col * 3, rgba, 3);
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_BGR: {
+					u8 bgr[3] = {rgba[2], rgba[1], rgba[0]};
+					memcpy(dest + col * 3, bgr, 3);
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_GRAY8: {
+					dest[col] = gray;
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR: {
+					for (i32 c = 0; c < 3; ++c) {
+						dest[c * plane_stride + col] = rgba[c];
+					}
+				} break;
+				case LIBISYNTAX_PIXEL_FORMAT_RGB48: {
+					u16 rgb48[3] = {rgba[0] * 257, rgba[1] * 257, rgba[2] * 257};
+					memcpy(dest + col * 6, rgb48, 6);
+				} break;
+				default: {
+					ASSERT(!"unsupported pixel format");
+				} break;
+			}
+		}
+	}
+}
+
+static const i32 pixel_formats[] = {
+	LIBISYNTAX_PIXEL_FORMAT_RGBA, LIBISYNTAX_PIXEL_FORMAT_BGRA, LIBISYNTAX_PIXEL_FORMAT_RGB,
+	LIBISYNTAX_PIXEL_FORMAT_BGR, LIBISYNTAX_PIXEL_FORMAT_GRAY8, LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR,
+	LIBISYNTAX_PIXEL_FORMAT_RGB48,
+};
+
+static i32 plane_count(i32 pixel_format) {
+	return (pixel_format == LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR) ? 3 : 1;
+}
+
+// The size of one row of pixels (within one plane, for the planar formats).
+static i32 row_size(i32 pixel_format, i32 width) {
+	i32 bytes_per_pixel = libisyntax_pixel_format_get_bytes_per_pixel(pixel_format) / plane_count(pixel_format);
+	return bytes_per_pixel * width;
+}
+
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+
+// Reads a region (or the tile at (x, y) in tiles, if is_tile) into a buffer with the given stride (0 for packed), and
+// checks the pixels, the padding between the rows and the bytes after the buffer.
+static bool check_read(synthetic_slide_t* slide, i32 level, i64 x, i64 y, i32 width, i32 height, i32 pixel_format,
+                       i32 stride, bool is_tile) {
+	i32 packed_stride = row_size(pixel_format, width);
+	i32 actual_stride = stride ? stride : packed_stride;
+	size_t size = (size_t)actual_stride * height * plane_count(pixel_format);
+	u8* actual = (u8*)malloc(size + GUARD_SIZE);
+	u8* expected = (u8*)malloc(size);
+	memset(actual, GUARD_BYTE, size + GUARD_SIZE);
+	memset(expected, GUARD_BYTE, size);
+	isyntax_error_t error;
+	if (is_tile) {
+		error = stride ? libisyntax_tile_read_with_stride(slide->isyntax, slide->cache, level, x, y, (u32*)actual,
+		                                                  stride, pixel_format)
+		               : libisyntax_tile_read(slide->isyntax, slide->cache, level, x, y, (u32*)actual, pixel_format);
+		x = x * TILE_SIZE - region_offset(level);
+		y = y * TILE_SIZE - region_offset(level);
+	} else {
+		error = stride ? libisyntax_read_region_with_stride(slide->isyntax, slide->cache, level, x, y, width, height,
+		                                                    (u32*)actual, stride, pixel_format)
+		               : libisyntax_read_region(slide->isyntax, slide->cache, level, x, y, width, height, (u32*)actual,
+		                                        pixel_format);
+	}
+	expected_region(level, x, y, width, height, pixel_format, expected, actual_stride);
+	bool ok = (error == LIBISYNTAX_OK) && memcmp(actual, expected, size) == 0;
+	for (i32 i = 0; i < GUARD_SIZE; ++i) {
+		ok &= actual[size + i] == GUARD_BYTE;
+	}
+	if (!ok) {
+		printf("FAILED %s read: level=%d x=%lld y=%lld size=%dx%d pixel_format=%d stride=%d error=%d\n",
+		       is_tile ? "tile" : "region", level, (long long)x, (long long)y, width, height, pixel_format, stride,
+		       error);
+	}
+	free(actual);
+	free(expected);
+	return ok;
+}
+
+static bool check_tile(synthetic_slide_t* slide, i32 level, i32 tile_x, i32 tile_y, i32 pixel_format) {
+	return check_read(slide, level, tile_x, tile_y, TILE_SIZE, TILE_SIZE, pixel_format, 0, true);
+}
+
+static bool check_region(synthetic_slide_t* slide, i32 level, i64 x, i64 y, i32 width, i32 height, i32 pixel_format) {
+	return check_read(slide, level, x, y, width, height, pixel_format, 0, false);
+}
+
+// A random region of at most max_size pixels, that may stick out of the level on each side.
+static void random_region(test_rng_t* rng, i32 level, i32 max_size, i64* x, i64* y, i32* width, i32* height) {
+	i32 level_size = width_in_tiles(level) * TILE_SIZE;
+	*width = 1 + (i32)test_rng_range(rng, max_size);
+	*height = 1 + (i32)test_rng_range(rng, max_size);
+	*x = (i64)test_rng_range(rng, level_size + 2 * max_size) - 2 * max_size;
+	*y = (i64)test_rng_range(rng, level_size + 2 * max_size) - 2 * max_size;
+}
+
+// Tiles read in random order and pixel formats through small and large caches, with both LL cache policies. The
+// GRAY8 reads only decode Y, so later color reads of the same tiles need to load the missing colors. Reads at a reduced
+// decode quality are mixed in: these must not leave approximate coefficients behind for the full quality reads.
+static bool test_cache(synthetic_slide_t* test_slide) {
+	(void)test_slide; // every cache configuration gets a fresh slide instead
+	static const i32 cache_sizes[] = {2000, 40, 12};
+	static const i32 ll_policies[] = {LIBISYNTAX_LL_CACHE_POLICY_KEEP_ALL, LIBISYNTAX_LL_CACHE_POLICY_REQUIRED_ONLY};
+	test_rng_t rng = {1};
+	i32 failures = 0;
+	u8* pixels = (u8*)malloc(TILE_SIZE * TILE_SIZE * 4);
+	for (i32 size_index = 0; size_index < (i32)COUNT(cache_sizes); ++size_index) {
+		for (i32 policy_index = 0; policy_index < (i32)COUNT(ll_policies); ++policy_index) {
+			synthetic_slide_t slide;
+			if (!synthetic_slide_create(&slide, "reader_test_cache_sizes.bin", TEST_SLIDE_SEED, cache_sizes[size_index])) {
+				return false;
+			}
+			libisyntax_cache_set_ll_policy(slide.cache, ll_policies[policy_index]);
+			for (i32 i = 0; i < 200; ++i) {
+				i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+				i32 tile_x = (i32)test_rng_range(&rng, width_in_tiles(level));
+				i32 tile_y = (i32)test_rng_range(&rng, width_in_tiles(level));
+				i32 pixel_format = test_rng_range(&rng, 2) ? LIBISYNTAX_PIXEL_FORMAT_GRAY8 : LIBISYNTAX_PIXEL_FORMAT_RGBA;
+				if (test_rng_range(&rng, 4) == 0) {
+					libisyntax_cache_set_decode_quality(slide.cache, 1 + (i32)test_rng_range(&rng, 4));
+					libisyntax_tile_read(slide.isyntax, slide.cache, level, tile_x, tile_y, (u32*)pixels, pixel_format);
+					libisyntax_cache_set_decode_quality(slide.cache, LIBISYNTAX_DECODE_QUALITY_FULL);
+				} else if (!check_tile(&slide, level, tile_x, tile_y, pixel_format)) {
+					++failures;
+				}
+			}
+			synthetic_slide_destroy(&slide);
+			remove("reader_test_cache_sizes.bin");
+		}
+	}
+	free(pixels);
+	return failures == 0;
+}
+
+// All pixel formats, for tiles and regions, packed and with padding at the end of the rows. Tiles and regions outside
+// of the slide are white.
+static bool test_pixel_formats(synthetic_slide_t* slide) {
+	test_rng_t rng = {2};
+	i32 failures = 0;
+	for (i32 i = 0; i < 150; ++i) {
+		i32 pixel_format = pixel_formats[test_rng_range(&rng, COUNT(pixel_formats))];
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		i32 stride = test_rng_range(&rng, 2) ? 0 : row_size(pixel_format, TILE_SIZE) + (i32)test_rng_range(&rng, 40);
+		i32 tile_x = (i32)test_rng_range(&rng, width_in_tiles(level) + 2) - 1;
+		i32 tile_y = (i32)test_rng_range(&rng, width_in_tiles(level) + 2) - 1;
+		if (!check_read(slide, level, tile_x, tile_y, TILE_SIZE, TILE_SIZE, pixel_format, stride, true)) {
+			++failures;
+		}
+
+		i64 x, y;
+		i32 width, height;
+		random_region(&rng, level, 600, &x, &y, &width, &height);
+		stride = test_rng_range(&rng, 2) ? 0 : row_size(pixel_format, width) + (i32)test_rng_range(&rng, 40);
+		if (!check_read(slide, level, x, y, width, height, pixel_format, stride, false)) {
+			++failures;
+		}
+	}
+
+	// Empty regions are rejected, without touching the buffer.
+	u32 pixel = 0x12345678;
+	if (libisyntax_read_region(slide->isyntax, slide->cache, 0, 0, 0, 0, 1, &pixel,
+	                           LIBISYNTAX_PIXEL_FORMAT_RGBA) != LIBISYNTAX_INVALID_ARGUMENT ||
+	    libisyntax_read_region(slide->isyntax, slide->cache, 0, 0, 0, 1, -1, &pixel,
+	                           LIBISYNTAX_PIXEL_FORMAT_RGBA) != LIBISYNTAX_INVALID_ARGUMENT ||
+	    libisyntax_read_region_with_stride(slide->isyntax, slide->cache, 0, 0, 0, -5, 1, &pixel, 4,
+	                                       LIBISYNTAX_PIXEL_FORMAT_RGBA) != LIBISYNTAX_INVALID_ARGUMENT ||
+	    pixel != 0x12345678) {
+		printf("FAILED: empty regions are not rejected\n");
+		++failures;
+	}
+	return failures == 0;
+}
+
+// Regions within one tile only run the part of the last IDWT that they need; they must match the same pixels of the
+// full tile, at any size and position (including single pixels and the tile edges).
+static bool test_windowed(synthetic_slide_t* slide) {
+	test_rng_t rng = {3};
+	i32 failures = 0;
+	for (i32 i = 0; i < 600; ++i) {
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		i32 tile_x = (i32)test_rng_range(&rng, width_in_tiles(level));
+		i32 tile_y = (i32)test_rng_range(&rng, width_in_tiles(level));
+		i32 max_size = test_rng_range(&rng, 2) ? 8 : TILE_SIZE;
+		i32 width = 1 + (i32)test_rng_range(&rng, max_size);
+		i32 height = 1 + (i32)test_rng_range(&rng, max_size);
+		i64 x = (i64)tile_x * TILE_SIZE + test_rng_range(&rng, TILE_SIZE + 1 - width) - region_offset(level);
+		i64 y = (i64)tile_y * TILE_SIZE + test_rng_range(&rng, TILE_SIZE + 1 - height) - region_offset(level);
+		i32 pixel_format = test_rng_range(&rng, 4) ? LIBISYNTAX_PIXEL_FORMAT_RGBA : LIBISYNTAX_PIXEL_FORMAT_GRAY8;
+		if (test_rng_range(&rng, 8) == 0) {
+			libisyntax_cache_flush(slide->cache, NULL);
+		}
+		if (!check_region(slide, level, x, y, width, height, pixel_format)) {
+			++failures;
+		}
+	}
+	return failures == 0;
+}
+
+static thread_pool_t test_thread_pool;
+static bool is_test_thread_pool_initialized;
+
+static thread_pool_t* get_test_thread_pool(void) {
+	// Use a few worker threads, even if the machine has only one core.
+	if (!is_test_thread_pool_initialized) {
+		global_system_info.suggested_total_thread_count = 5;
+		init_thread_pool(&test_thread_pool, 1024, false, false, NULL);
+		is_test_thread_pool_initialized = true;
+	}
+	return &test_thread_pool;
+}
+
+typedef struct concurrent_read_task_t {
+	synthetic_slide_t* slide;
+	i32 index;
+	i32 volatile* failure_count;
+	i32 volatile* completed_count;
+} concurrent_read_task_t;
+
+static void concurrent_read_task_func(int logical_thread_index, void* userdata) {
+	(void)logical_thread_index;
+	concurrent_read_task_t* task = (concurrent_read_task_t*)userdata;
+	test_rng_t rng = {100 + task->index};
+	for (i32 i = 0; i < 10; ++i) {
+		i64 x, y;
+		i32 width, height;
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		random_region(&rng, level, 400, &x, &y, &width, &height);
+		// Mix color and grayscale reads, which load different channels of the same tiles.
+		i32 pixel_format = pixel_formats[(task->index + i) % (i32)COUNT(pixel_formats)];
+		if (!check_region(task->slide, level, x, y, width, height, pixel_format)) {
+			atomic_increment(task->failure_count);
+		}
+	}
+	atomic_increment(task->completed_count);
+}
+
+// Region reads spread across the worker threads. Also with reads that themselves run on the worker threads, on the
+// same (small) cache: reads that need the same tiles wait for each other, and a read must not wait for work that is
+// waiting for its tiles.
+static bool test_parallel(synthetic_slide_t* slide) {
+	thread_pool_t* pool = get_test_thread_pool();
+	isyntax_set_thread_pool(slide->isyntax, pool);
+	libisyntax_cache_set_parallel_region_reads(slide->cache, true);
+	test_rng_t rng = {4};
+	i32 failures = 0;
+	for (i32 i = 0; i < 60; ++i) {
+		i64 x, y;
+		i32 width, height;
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		random_region(&rng, level, 900, &x, &y, &width, &height);
+		i32 pixel_format = pixel_formats[test_rng_range(&rng, COUNT(pixel_formats))];
+		if (test_rng_range(&rng, 4) == 0) {
+			libisyntax_cache_flush(slide->cache, NULL);
+		}
+		if (!check_region(slide, level, x, y, width, height, pixel_format)) {
+			++failures;
+		}
+	}
+
+	libisyntax_cache_set_parallel_region_reads(slide->cache, false);
+	isyntax_set_thread_pool(slide->isyntax, NULL);
+
+	synthetic_slide_t small_slide;
+	if (!synthetic_slide_create(&small_slide, "reader_test_small_cache.bin", TEST_SLIDE_SEED, 40)) {
+		return false;
+	}
+	isyntax_set_thread_pool(small_slide.isyntax, pool);
+	libisyntax_cache_set_parallel_region_reads(small_slide.cache, true);
+	i32 volatile failure_count = 0;
+	i32 volatile completed_count = 0;
+	i32 task_count = 16;
+	for (i32 i = 0; i < task_count; ++i) {
+		concurrent_read_task_t task = {&small_slide, i, &failure_count, &completed_count};
+		while (!thread_pool_submit_task(pool, concurrent_read_task_func, &task, sizeof(task))) {
+			platform_sleep_ns(1000000);
+		}
+	}
+	for (i32 i = 0; i < 60000 && completed_count < task_count; ++i) {
+		platform_sleep_ns(1000000);
+	}
+	if (completed_count < task_count) {
+		printf("FAILED: concurrent reads did not finish (%d/%d)\n", completed_count, task_count);
+		exit(1); // the worker threads are stuck
+	}
+	failures += failure_count;
+	synthetic_slide_destroy(&small_slide);
+	remove("reader_test_small_cache.bin");
+	return failures == 0;
+}
+
+// Scaled reads: at power of two scale factors they are plain region reads at the matching level. At other scale
+// factors, the SIMD resampling kernels must give the same result as the scalar ones.
+static bool test_scaled(synthetic_slide_t* slide) {
+	static const i32 formats[] = {
+		LIBISYNTAX_PIXEL_FORMAT_RGBA, LIBISYNTAX_PIXEL_FORMAT_BGRA, LIBISYNTAX_PIXEL_FORMAT_RGB,
+		LIBISYNTAX_PIXEL_FORMAT_BGR, LIBISYNTAX_PIXEL_FORMAT_GRAY8, LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR,
+	};
+	static const i32 filters[] = {
+		LIBISYNTAX_RESAMPLE_FILTER_BOX, LIBISYNTAX_RESAMPLE_FILTER_BILINEAR, LIBISYNTAX_RESAMPLE_FILTER_LANCZOS,
+	};
+	i32 failures = 0;
+	for (i32 format_index = 0; format_index < (i32)COUNT(formats); ++format_index) {
+		i32 pixel_format = formats[format_index];
+		i32 width = 300;
+		i32 height = 200;
+		size_t size = (size_t)row_size(pixel_format, width) * height * plane_count(pixel_format);
+		u8* actual = (u8*)malloc(size);
+		u8* expected = (u8*)malloc(size);
+		for (i32 level = 0; level < LEVEL_COUNT; ++level) {
+			for (i32 filter_index = 0; filter_index < (i32)COUNT(filters); ++filter_index) {
+				i64 x = 100;
+				i64 y = 37;
+				expected_region(level, x, y, width, height, pixel_format, expected, row_size(pixel_format, width));
+				isyntax_error_t error = libisyntax_read_region_scaled(slide->isyntax, slide->cache, x << level,
+				                                                      y << level, width << level, height << level,
+				                                                      width, height, (u32*)actual, pixel_format,
+				                                                      filters[filter_index]);
+				if (error != LIBISYNTAX_OK || memcmp(actual, expected, size) != 0) {
+					printf("FAILED scaled read at level %d: pixel_format=%d filter=%d\n", level, pixel_format,
+					       filters[filter_index]);
+					++failures;
+				}
+			}
+		}
+		free(actual);
+		free(expected);
+	}
+
+	i32 default_simd_level = libisyntax_get_simd_level();
+	for (i32 simd_level = LIBISYNTAX_SIMD_LEVEL_SSE2; simd_level <= LIBISYNTAX_SIMD_LEVEL_NEON; ++simd_level) {
+		if (libisyntax_set_simd_level(simd_level) != LIBISYNTAX_OK) continue;
+		test_rng_t rng = {5};
+		for (i32 i = 0; i < 60; ++i) {
+			i32 pixel_format = formats[test_rng_range(&rng, COUNT(formats))];
+			i32 filter = filters[test_rng_range(&rng, COUNT(filters))];
+			double x = (double)test_rng_range(&rng, 2400) - 200 + test_rng_range(&rng, 1000) / 1000.0;
+			double y = (double)test_rng_range(&rng, 2400) - 200 + test_rng_range(&rng, 1000) / 1000.0;
+			double width = 5 + test_rng_range(&rng, 1500) + test_rng_range(&rng, 100) / 100.0;
+			double height = 5 + test_rng_range(&rng, 1500);
+			i32 out_width = 1 + (i32)test_rng_range(&rng, 300);
+			i32 out_height = 1 + (i32)test_rng_range(&rng, 300);
+			size_t size = (size_t)row_size(pixel_format, out_width) * out_height * plane_count(pixel_format);
+			u8* actual = (u8*)malloc(size);
+			u8* expected = (u8*)malloc(size);
+			libisyntax_set_simd_level(LIBISYNTAX_SIMD_LEVEL_SCALAR);
+			isyntax_error_t error = libisyntax_read_region_scaled(slide->isyntax, slide->cache, x, y, width, height,
+			                                                      out_width, out_height, (u32*)expected,
+			                                                      pixel_format, filter);
+			libisyntax_set_simd_level(simd_level);
+			error |= libisyntax_read_region_scaled(slide->isyntax, slide->cache, x, y, width, height, out_width,
+			                                       out_height, (u32*)actual, pixel_format, filter);
+			if (error != LIBISYNTAX_OK || memcmp(actual, expected, size) != 0) {
+				printf("FAILED scaled read at SIMD level %d: x=%g y=%g size=%gx%g out=%dx%d pixel_format=%d filter=%d\n",
+				       simd_level, x, y, width, height, out_width, out_height, pixel_format, filter);
+				++failures;
+			}
+			free(actual);
+			free(expected);
+		}
+	}
+	libisyntax_set_simd_level(default_simd_level);
+	return failures == 0;
+}
+
+// Multiscale patches must match separate region reads at each level, and batches of patches must match separate
+// region reads of each patch (in every layout, with and without the worker threads).
+static bool test_patches(synthetic_slide_t* slide) {
+	test_rng_t rng = {6};
+	i32 failures = 0;
+	for (i32 i = 0; i < 60; ++i) {
+		i32 pixel_format = pixel_formats[test_rng_range(&rng, COUNT(pixel_formats))];
+		i32 patch_width = 1 + (i32)test_rng_range(&rng, 300);
+		i32 patch_height = 1 + (i32)test_rng_range(&rng, 300);
+		i64 x = (i64)test_rng_range(&rng, 2300) - 100;
+		i64 y = (i64)test_rng_range(&rng, 2300) - 100;
+		i32 levels[LEVEL_COUNT];
+		for (i32 level = 0; level < LEVEL_COUNT; ++level) {
+			levels[level] = level;
+		}
+		for (i32 j = LEVEL_COUNT - 1; j > 0; --j) {
+			i32 k = (i32)test_rng_range(&rng, j + 1);
+			i32 temp = levels[j];
+			levels[j] = levels[k];
+			levels[k] = temp;
+		}
+		i32 patch_count = 1 + (i32)test_rng_range(&rng, LEVEL_COUNT);
+		if (test_rng_range(&rng, 3) == 0) {
+			libisyntax_cache_flush(slide->cache, NULL);
+		}
+		i32 stride = row_size(pixel_format, patch_width);
+		size_t size = (size_t)stride * patch_height * plane_count(pixel_format);
+		u8* buffers[LEVEL_COUNT];
+		for (i32 j = 0; j < patch_count; ++j) {
+			buffers[j] = (u8*)malloc(size);
+		}
+		u8* expected = (u8*)malloc(size);
+		isyntax_error_t error = libisyntax_read_multiscale_patches(slide->isyntax, slide->cache, x, y, patch_width,
+		                                                           patch_height, levels, patch_count,
+		                                                           (u32**)buffers, pixel_format);
+		for (i32 j = 0; j < patch_count; ++j) {
+			i32 level = levels[j];
+			expected_region(level, floor_div(x, 1 << level) - patch_width / 2, floor_div(y, 1 << level) - patch_height / 2,
+			                patch_width, patch_height, pixel_format, expected, stride);
+			if (error != LIBISYNTAX_OK || memcmp(buffers[j], expected, size) != 0) {
+				printf("FAILED multiscale patch: x=%lld y=%lld size=%dx%d level=%d pixel_format=%d\n",
+				       (long long)x, (long long)y, patch_width, patch_height, level, pixel_format);
+				++failures;
+			}
+			free(buffers[j]);
+		}
+		free(expected);
+	}
+
+	static const float mean[3] = {0.485f, 0.456f, 0.406f};
+	static const float std[3] = {0.229f, 0.224f, 0.225f};
+	i32 default_simd_level = libisyntax_get_simd_level();
+	for (i32 i = 0; i < 40; ++i) {
+		// Go through the SIMD levels of the conversion to float (those that the CPU doesn't support are skipped).
+		libisyntax_set_simd_level(i % (LIBISYNTAX_SIMD_LEVEL_NEON + 1));
+		bool parallel = test_rng_range(&rng, 2);
+		if (parallel) {
+			isyntax_set_thread_pool(slide->isyntax, get_test_thread_pool());
+		}
+		libisyntax_cache_set_parallel_region_reads(slide->cache, parallel);
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		i32 layout = (i32)test_rng_range(&rng, 4);
+		bool is_planar = (layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_U8 || layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_F32);
+		bool is_float = (layout == LIBISYNTAX_PATCH_LAYOUT_NHWC_F32 || layout == LIBISYNTAX_PATCH_LAYOUT_NCHW_F32);
+		bool normalize = is_float && test_rng_range(&rng, 2);
+		i32 patch_width = 1 + (i32)test_rng_range(&rng, 200);
+		i32 patch_height = 1 + (i32)test_rng_range(&rng, 200);
+		i32 patch_count = 1 + (i32)test_rng_range(&rng, 100);
+		i32 level_size = width_in_tiles(level) * TILE_SIZE;
+		int64_t* coords = (int64_t*)malloc(patch_count * 2 * sizeof(int64_t));
+		for (i32 j = 0; j < patch_count; ++j) {
+			if (j > 0 && test_rng_range(&rng, 4) == 0) {
+				// The same patch more than once.
+				coords[2 * j] = coords[2 * (j - 1)];
+				coords[2 * j + 1] = coords[2 * (j - 1) + 1];
+			} else {
+				coords[2 * j] = (i64)test_rng_range(&rng, level_size + 200) - 150;
+				coords[2 * j + 1] = (i64)test_rng_range(&rng, level_size + 200) - 150;
+			}
+		}
+		size_t values_per_patch = (size_t)patch_width * patch_height * 3;
+		size_t value_size = is_float ? sizeof(float) : 1;
+		u8* out = (u8*)malloc(values_per_patch * patch_count * value_size);
+		isyntax_error_t error = libisyntax_read_patches(slide->isyntax, slide->cache, level, coords, patch_count,
+		                                                patch_width, patch_height, out, layout,
+		                                                normalize ? mean : NULL, normalize ? std : NULL);
+		i32 pixel_format = is_planar ? LIBISYNTAX_PIXEL_FORMAT_RGB_PLANAR : LIBISYNTAX_PIXEL_FORMAT_RGB;
+		u8* expected = (u8*)malloc(values_per_patch);
+		for (i32 j = 0; j < patch_count && error == LIBISYNTAX_OK; ++j) {
+			expected_region(level, coords[2 * j], coords[2 * j + 1], patch_width, patch_height, pixel_format, expected,
+			                patch_width * (is_planar ? 1 : 3));
+			bool ok;
+			if (is_float) {
+				float* values = (float*)out + values_per_patch * j;
+				ok = true;
+				for (size_t k = 0; k < values_per_patch; ++k) {
+					i32 c = is_planar ? (i32)(k / ((size_t)patch_width * patch_height)) : (i32)(k % 3);
+					float value = expected[k] / 255.0f;
+					if (normalize) value = (value - mean[c]) / std[c];
+					ok &= fabsf(values[k] - value) < 1e-5f;
+				}
+			} else {
+				ok = memcmp(out + values_per_patch * j, expected, values_per_patch) == 0;
+			}
+			if (!ok) {
+				printf("FAILED patch %d of %d: level=%d size=%dx%d layout=%d\n", j, patch_count, level, patch_width,
+				       patch_height, layout);
+				++failures;
+			}
+		}
+		if (error != LIBISYNTAX_OK) {
+			printf("FAILED read_patches(): error=%d\n", error);
+			++failures;
+		}
+		free(expected);
+		free(out);
+		free(coords);
+	}
+	libisyntax_set_simd_level(default_simd_level);
+	libisyntax_cache_set_parallel_region_reads(slide->cache, false);
+	isyntax_set_thread_pool(slide->isyntax, NULL);
+	return failures == 0;
+}
+
+// The luminance as used by the RGB formats (see ycocg_to_rgb() in isyntax.c).
+static i16 ycocg_luminance(i16 Y) {
+	return (Y < 0) ? (i16)((0x8000 - (u16)Y) & 0x7FFF) : Y;
+}
+
+// YCoCg16 output converts to exactly the RGB and GRAY8 output, and regions within a tile are cut from the same
+// planes. Outside of the slide, the output is white (Y = 255, Co = Cg = 0).
+static bool test_ycocg16(synthetic_slide_t* slide) {
+	test_rng_t rng = {7};
+	i32 failures = 0;
+	i32 plane_size = TILE_SIZE * TILE_SIZE;
+	i16* tile = (i16*)malloc(3 * plane_size * sizeof(i16));
+	i16* region = (i16*)malloc(3 * plane_size * sizeof(i16));
+	for (i32 i = 0; i < 16; ++i) {
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT);
+		i32 tile_x = (i32)test_rng_range(&rng, width_in_tiles(level));
+		i32 tile_y = (i32)test_rng_range(&rng, width_in_tiles(level));
+		i32 tile_index = tile_y * width_in_tiles(level) + tile_x;
+		if (libisyntax_tile_read(slide->isyntax, slide->cache, level, tile_x, tile_y, (u32*)tile,
+		                         LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR) != LIBISYNTAX_OK) {
+			++failures;
+			continue;
+		}
+		i32 mismatch_count = 0;
+		for (i32 j = 0; j < plane_size; ++j) {
+			i16 Y = ycocg_luminance(tile[j]);
+			i16 Co = tile[plane_size + j];
+			i16 Cg = tile[2 * plane_size + j];
+			i16 temp = Y - (Cg >> 1);
+			i16 G = temp + Cg;
+			i16 B = temp - (Co >> 1);
+			i16 R = B + Co;
+			u8* rgba = reference_rgba[level][tile_index] + j * 4;
+			mismatch_count += CLAMP(R, 0, 255) != rgba[0] || CLAMP(G, 0, 255) != rgba[1] || CLAMP(B, 0, 255) != rgba[2];
+			mismatch_count += CLAMP(Y, 0, 255) != reference_gray[level][tile_index][j];
+		}
+		if (mismatch_count) {
+			printf("FAILED YCoCg16 tile %d,%d at level %d: %d pixels differ\n", tile_x, tile_y, level, mismatch_count);
+			++failures;
+		}
+		for (i32 j = 0; j < 20; ++j) {
+			i32 width = 1 + (i32)test_rng_range(&rng, TILE_SIZE);
+			i32 height = 1 + (i32)test_rng_range(&rng, TILE_SIZE);
+			i32 x = (i32)test_rng_range(&rng, TILE_SIZE + 1 - width);
+			i32 y = (i32)test_rng_range(&rng, TILE_SIZE + 1 - height);
+			isyntax_error_t error = libisyntax_read_region(slide->isyntax, slide->cache, level,
+			                                               tile_x * TILE_SIZE + x - region_offset(level),
+			                                               tile_y * TILE_SIZE + y - region_offset(level),
+			                                               width, height, (u32*)region,
+			                                               LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR);
+			bool ok = (error == LIBISYNTAX_OK);
+			for (i32 c = 0; c < 3; ++c) {
+				for (i32 row = 0; row < height; ++row) {
+					ok &= memcmp(region + (c * height + row) * width, tile + c * plane_size + (y + row) * TILE_SIZE + x,
+					             width * sizeof(i16)) == 0;
+				}
+			}
+			if (!ok) {
+				printf("FAILED YCoCg16 region: level=%d tile=%d,%d x=%d y=%d size=%dx%d\n", level, tile_x, tile_y, x, y,
+				       width, height);
+				++failures;
+			}
+		}
+	}
+	libisyntax_read_region(slide->isyntax, slide->cache, 0, -2000, -2000, 16, 16, (u32*)region,
+	                       LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR);
+	for (i32 j = 0; j < 3 * 256; ++j) {
+		if (region[j] != ((j < 256) ? 255 : 0)) {
+			printf("FAILED YCoCg16 outside of the slide\n");
+			++failures;
+			break;
+		}
+	}
+	free(tile);
+	free(region);
+	return failures == 0;
+}
+
+// The coefficients of the top level tile are the ones that were encoded, and the LL coefficients of the tiles below
+// are the quadrants of their parent tile after the IDWT. At a reduced decode quality, the H coefficients only keep some
+// of their bits.
+static bool test_coefficients(synthetic_slide_t* slide) {
+	test_rng_t rng = {8};
+	i32 failures = 0;
+	i32 block_area = BLOCK_SIZE * BLOCK_SIZE;
+	i16* ll = (i16*)malloc(3 * block_area * sizeof(i16));
+	i16* h = (i16*)malloc(9 * block_area * sizeof(i16));
+	i16* ll_only = (i16*)malloc(3 * block_area * sizeof(i16));
+	i16* h_only = (i16*)malloc(9 * block_area * sizeof(i16));
+	i16* parent = (i16*)malloc(3 * TILE_SIZE * TILE_SIZE * sizeof(i16));
+
+	bool ok = libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, LEVEL_COUNT - 1, 0, 0, ll, h) == LIBISYNTAX_OK;
+	for (i32 c = 0; c < 3; ++c) {
+		i16* encoded = slide->top_tile_coefficients + c * 4 * block_area;
+		ok &= memcmp(ll + c * block_area, encoded, block_area * sizeof(i16)) == 0;
+		ok &= memcmp(h + c * 3 * block_area, encoded + block_area, 3 * block_area * sizeof(i16)) == 0;
+	}
+	if (!ok) {
+		printf("FAILED coefficients of the top level tile\n");
+		++failures;
+	}
+
+	for (i32 i = 0; i < 20; ++i) {
+		i32 level = (i32)test_rng_range(&rng, LEVEL_COUNT - 1);
+		i32 tile_x = (i32)test_rng_range(&rng, width_in_tiles(level));
+		i32 tile_y = (i32)test_rng_range(&rng, width_in_tiles(level));
+		if (test_rng_range(&rng, 3) == 0) {
+			libisyntax_cache_flush(slide->cache, NULL);
+		}
+		ok = libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, level, tile_x, tile_y, ll, h) == LIBISYNTAX_OK;
+		ok &= libisyntax_tile_read(slide->isyntax, slide->cache, level + 1, tile_x / 2, tile_y / 2, (u32*)parent,
+		                           LIBISYNTAX_PIXEL_FORMAT_YCOCG16_PLANAR) == LIBISYNTAX_OK;
+		for (i32 c = 0; c < 3; ++c) {
+			for (i32 y = 0; y < BLOCK_SIZE; ++y) {
+				i16* quadrant_row = parent + (c * TILE_SIZE + (tile_y % 2) * BLOCK_SIZE + y) * TILE_SIZE + (tile_x % 2) * BLOCK_SIZE;
+				ok &= memcmp(ll + (c * BLOCK_SIZE + y) * BLOCK_SIZE, quadrant_row, BLOCK_SIZE * sizeof(i16)) == 0;
+			}
+		}
+		// Reading only the LL or only the H coefficients gives the same values.
+		ok &= libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, level, tile_x, tile_y, ll_only, NULL) == LIBISYNTAX_OK;
+		ok &= libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, level, tile_x, tile_y, NULL, h_only) == LIBISYNTAX_OK;
+		ok &= memcmp(ll, ll_only, 3 * block_area * sizeof(i16)) == 0;
+		ok &= memcmp(h, h_only, 9 * block_area * sizeof(i16)) == 0;
+
+		libisyntax_cache_set_decode_quality(slide->cache, 1 + (i32)test_rng_range(&rng, 4));
+		ok &= libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, level, tile_x, tile_y, NULL, h_only) == LIBISYNTAX_OK;
+		libisyntax_cache_set_decode_quality(slide->cache, LIBISYNTAX_DECODE_QUALITY_FULL);
+		for (i32 j = 0; j < 9 * block_area; ++j) {
+			i32 magnitude = ABS(h[j]);
+			i32 truncated_magnitude = ABS(h_only[j]);
+			ok &= (truncated_magnitude & ~magnitude) == 0 && (h_only[j] == 0 || (h_only[j] < 0) == (h[j] < 0));
+		}
+		if (!ok) {
+			printf("FAILED coefficients of tile %d,%d at level %d\n", tile_x, tile_y, level);
+			++failures;
+		}
+	}
+
+	if (libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, 0, BASE_WIDTH_IN_TILES, 0, ll, h) != LIBISYNTAX_INVALID_ARGUMENT ||
+	    libisyntax_tile_read_coefficients(slide->isyntax, slide->cache, LEVEL_COUNT, 0, 0, ll, h) != LIBISYNTAX_INVALID_ARGUMENT) {
+		printf("FAILED coefficients of a tile outside of the slide\n");
+		++failures;
+	}
+	free(ll);
+	free(h);
+	free(ll_only);
+	free(h_only);
+	free(parent);
+	return failures == 0;
+}
+
+typedef struct test_t {
+	const char* name;
+	bool (*func)(synthetic_slide_t* slide);
+} test_t;
+
+static const test_t tests[] = {
+	{"cache", test_cache},
+	{"pixel_formats", test_pixel_formats},
+	{"windowed", test_windowed},
+	{"parallel", test_parallel},
+	{"scaled", test_scaled},
+	{"patches", test_patches},
+	{"ycocg16", test_ycocg16},
+	{"coefficients", test_coefficients},
+};
+
+int main(int argc, char** argv) {
+	if (libisyntax_init() != LIBISYNTAX_OK) {
+		printf("libisyntax_init() failed\n");
+		return 1;
+	}
+	const char* test_name = (argc > 1) ? argv[1] : NULL;
+	bool found = false;
+	for (i32 i = 0; i < (i32)COUNT(tests); ++i) {
+		found |= (test_name == NULL || strcmp(tests[i].name, test_name) == 0);
+	}
+	if (!found) {
+		printf("Unknown test: %s\n", test_name);
+		return 1;
+	}
+	if (!load_reference()) {
+		printf("Could not read the reference tiles\n");
+		return 1;
+	}
+
+	i32 failures = 0;
+	for (i32 i = 0; i < (i32)COUNT(tests); ++i) {
+		if (test_name != NULL && strcmp(tests[i].name, test_name) != 0) continue;
+		// Every test starts out with a fresh slide and cache.
+		char path[64];
+		snprintf(path, sizeof(path), "reader_test_%s.bin", tests[i].name);
+		synthetic_slide_t slide;
+		bool ok = synthetic_slide_create(&slide, path, TEST_SLIDE_SEED, 2000) && tests[i].func(&slide);
+		synthetic_slide_destroy(&slide);
+		remove(path);
+		printf("%s: %s\n", tests[i].name, ok ? "passed" : "FAILED");
+		failures += !ok;
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+// Synthetic slides for testing the tile reader without needing a real slide. The codeblocks are random wavelet
+// coefficients, encoded with the test encoder (compressor v2) and written to a file; the slide structure (levels,
+// tiles, codeblock offsets) is filled in directly, as if the header had been parsed.
+// The slide has SYNTHETIC_SLIDE_LEVEL_COUNT levels of 256x256 tiles (codeblocks of 128x128), with 8x8 tiles at level 0
+// down to a single tile at the top level. The same seed always produces the same slide.
+
+#include "common.h"
+#include "platform.h"
+#include "libisyntax.h"
+#include "isyntax.h"
+#include "hulsken_test_encoder.h"
+
+#include <stdio.h>
+
+#define SYNTHETIC_SLIDE_LEVEL_COUNT 4
+#define SYNTHETIC_SLIDE_TILE_SIZE 256
+#define SYNTHETIC_SLIDE_BLOCK_SIZE 128
+
+typedef struct synthetic_slide_t {
+	isyntax_t* isyntax;
+	isyntax_cache_t* cache;
+	// The coefficients of the top level tile, as encoded: [color][LL, HL, LH, HH][block_height][block_width].
+	i16* top_tile_coefficients;
+} synthetic_slide_t;
+
+// Writes the slide to path (overwriting it) and opens it with a cache of its own.
+static bool synthetic_slide_create(synthetic_slide_t* slide, const char* path, u64 seed, i32 cache_size) {
+	memset(slide, 0, sizeof(*slide));
+	i32 level_count = SYNTHETIC_SLIDE_LEVEL_COUNT;
+	i32 block_width = SYNTHETIC_SLIDE_BLOCK_SIZE;
+	i32 block_area = block_width * block_width;
+	i32 base_width_in_tiles = 1 << (level_count - 1);
+
+	isyntax_t* isyntax = (isyntax_t*)calloc(1, sizeof(isyntax_t));
+	isyntax->block_width = block_width;
+	isyntax->block_height = block_width;
+	isyntax->tile_width = SYNTHETIC_SLIDE_TILE_SIZE;
+	isyntax->tile_height = SYNTHETIC_SLIDE_TILE_SIZE;
+	isyntax->black_dummy_coeff = (icoeff_t*)calloc(block_area, sizeof(icoeff_t));
+	isyntax->white_dummy_coeff = (icoeff_t*)malloc(block_area * sizeof(icoeff_t));
+	for (i32 i = 0; i < block_area; ++i) {
+		isyntax->white_dummy_coeff[i] = 255;
+	}
+
+	isyntax_image_t* wsi = &isyntax->images[0];
+	wsi->image_type = ISYNTAX_IMAGE_TYPE_WSI;
+	wsi->max_scale = level_count - 1;
+	wsi->level_count = level_count;
+	wsi->compressor_version = 2;
+	wsi->first_load_complete = true;
+	i32 total_tile_count = 0;
+	for (i32 scale = 0; scale < level_count; ++scale) {
+		i32 width_in_tiles = base_width_in_tiles >> scale;
+		total_tile_count += width_in_tiles * width_in_tiles;
+	}
+	wsi->codeblocks = (isyntax_codeblock_t*)calloc(total_tile_count * 6, sizeof(isyntax_codeblock_t));
+	wsi->data_chunks = (isyntax_data_chunk_t*)calloc(total_tile_count, sizeof(isyntax_data_chunk_t));
+	slide->top_tile_coefficients = (i16*)malloc(3 * 4 * block_area * sizeof(i16));
+
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		printf("synthetic_slide_create(): could not write %s\n", path);
+		return false;
+	}
+	test_rng_t rng = {seed};
+	test_encoder_options_t options = {0};
+	options.zero_counter_size = 8;
+	options.min_zero_run = 2;
+	options.v2_valid_seektable = true;
+	i16* coeffs = (i16*)malloc(3 * block_area * sizeof(i16));
+	size_t capacity = 3 * block_area * 4 + 4096;
+	u8* compressed = (u8*)malloc(capacity);
+	u64 offset = 0;
+	i32 codeblock_index = 0;
+	i32 data_chunk_index = 0;
+	for (i32 scale = level_count - 1; scale >= 0; --scale) {
+		i32 width_in_tiles = base_width_in_tiles >> scale;
+		isyntax_level_t* level = wsi->levels + scale;
+		level->scale = scale;
+		level->width_in_tiles = width_in_tiles;
+		level->height_in_tiles = width_in_tiles;
+		level->tile_count = width_in_tiles * width_in_tiles;
+		level->tiles = (isyntax_tile_t*)calloc(level->tile_count, sizeof(isyntax_tile_t));
+		for (i32 tile_index = 0; tile_index < (i32)level->tile_count; ++tile_index) {
+			isyntax_tile_t* tile = level->tiles + tile_index;
+			tile->exists = true;
+			tile->tile_scale = scale;
+			tile->tile_x = tile_index % width_in_tiles;
+			tile->tile_y = tile_index / width_in_tiles;
+			tile->data_chunk_index = data_chunk_index;
+			wsi->data_chunks[data_chunk_index].scale = scale;
+			wsi->data_chunks[data_chunk_index].codeblock_count_per_color = 1;
+			++data_chunk_index;
+			// Only the top level has LL codeblocks, the LL coefficients of the levels below come from the IDWT.
+			for (i32 coefficient = (scale == wsi->max_scale) ? 0 : 1; coefficient <= 1; ++coefficient) {
+				i32 coeff_count = (coefficient == 1) ? 3 : 1;
+				if (coefficient == 0) {
+					tile->codeblock_index = codeblock_index;
+				} else {
+					tile->codeblock_chunk_index = codeblock_index;
+				}
+				for (i32 color = 0; color < 3; ++color) {
+					if (coefficient == 0) {
+						// Y around mid-gray, so that the pixels don't clip too often; Co and Cg around 0.
+						for (i32 i = 0; i < block_area; ++i) {
+							coeffs[i] = (color == 0) ? (i16)(60 + test_rng_range(&rng, 190))
+							                         : (i16)((i32)test_rng_range(&rng, 80) - 40);
+						}
+					} else {
+						test_generate_coefficients(&rng, coeffs, coeff_count * block_area, 70, 6);
+						coeffs[0] = 1; // empty v2 blocks are stored as dummy blocks instead
+					}
+					if (scale == wsi->max_scale) {
+						i16* dest = slide->top_tile_coefficients + (color * 4 + coefficient) * block_area;
+						memcpy(dest, coeffs, coeff_count * block_area * sizeof(i16));
+					}
+					size_t compressed_size = test_hulsken_encode(&rng, coeffs, block_width, block_width, coeff_count,
+					                                             2, options, compressed, capacity);
+					if (compressed_size == 0 || fwrite(compressed, 1, compressed_size, fp) != compressed_size) {
+						printf("synthetic_slide_create(): encoding failed\n");
+						fclose(fp);
+						return false;
+					}
+					isyntax_codeblock_t* codeblock = wsi->codeblocks + codeblock_index++;
+					codeblock->color_component = color;
+					codeblock->scale = scale;
+					codeblock->coefficient = coefficient;
+					codeblock->block_data_offset = offset;
+					codeblock->block_size = compressed_size;
+					offset += compressed_size;
+				}
+			}
+		}
+	}
+	fclose(fp);
+	free(coeffs);
+	free(compressed);
+
+	isyntax->file_handle = open_file_handle_for_simultaneous_access(path);
+	if (!isyntax->file_handle) {
+		printf("synthetic_slide_create(): could not open %s\n", path);
+		return false;
+	}
+	if (libisyntax_cache_create("synthetic slide cache", cache_size, &slide->cache) != LIBISYNTAX_OK ||
+	    libisyntax_cache_inject(slide->cache, isyntax) != LIBISYNTAX_OK) {
+		printf("synthetic_slide_create(): could not create the cache\n");
+		return false;
+	}
+	slide->isyntax = isyntax;
+	return true;
+}
+
+static void synthetic_slide_destroy(synthetic_slide_t* slide) {
+	isyntax_t* isyntax = slide->isyntax;
+	if (isyntax) {
+		isyntax_image_t* wsi = &isyntax->images[0];
+		for (i32 scale = 0; scale < wsi->level_count; ++scale) {
+			free(wsi->levels[scale].tiles);
+		}
+		free(wsi->codeblocks);
+		free(wsi->data_chunks);
+		free(isyntax->black_dummy_coeff);
+		free(isyntax->white_dummy_coeff);
+		file_handle_close(isyntax->file_handle);
+		free(isyntax);
+	}
+	if (slide->cache) {
+		libisyntax_cache_destroy(slide->cache);
+	}
+	free(slide->top_tile_coefficients);
+	memset(slide, 0, sizeof(*slide));
+}